@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace drak {
+
+    // Thrown for a command line argument that is missing, extra or not a count
+    class BadArgument : public std::invalid_argument {
+    public:
+        using std::invalid_argument::invalid_argument;
+    };
+
+    // The arguments following a --name mode on the command line. usage lists them, like
+    // "<directory> [frames]": <required> ones first, then [optional] ones.
+    class Arguments {
+        int _argc;
+        char ** _argv;
+
+    public:
+        Arguments(int argc, char * argv[], char const* usage)
+            : _argc{argc}, _argv{argv} {
+            auto end = usage + std::strlen(usage);
+            auto required = std::count(usage, end, '<');
+            auto most = required + std::count(usage, end, '[');
+            if(argc - 2 < required || argc - 2 > most) {
+                throw BadArgument("wrong number of arguments");
+            }
+        }
+
+        // The index-th argument after the name
+        std::string Text(int index) const {
+            if(index + 2 >= _argc) {
+                throw BadArgument("missing argument");
+            }
+            return _argv[index + 2];
+        }
+
+        // The index-th argument as a count from 1, or fallback when it's not given
+        int Count(int index, int fallback) const {
+            if(index + 2 >= _argc) {
+                return fallback;
+            }
+            std::string text = _argv[index + 2];
+            std::size_t end = 0;
+            long long value = 0;
+            try {
+                value = std::stoll(text, &end);
+            } catch(std::logic_error const&) {
+                throw BadArgument(text);
+            }
+            if(end != text.size() || value < 1 || value > std::numeric_limits<int>::max()) {
+                throw BadArgument(text);
+            }
+            return static_cast<int>(value);
+        }
+    };
+
+    // Runs run(arguments) for the mode in argv[1], or prints its usage and returns 2 when the
+    // arguments don't fit it
+    template <typename Run>
+    int RunMode(int argc, char * argv[], char const* usage, Run && run) {
+        try {
+            return run(Arguments(argc, argv, usage));
+        } catch(BadArgument const&) {
+            nowide::cerr << "usage: drak0 " << argv[1] << " " << usage << "\n"
+                << "  counts are whole numbers from 1\n";
+            return 2;
+        }
+    }
+
+}
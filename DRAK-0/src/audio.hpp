@@ -0,0 +1,622 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DRAK_AUDIO_SSE2
+#endif
+
+#include "music.hpp"
+
+namespace drak {
+
+    // Bounded single-producer/single-consumer ring, neither side ever blocks or allocates
+    template <typename T, std::size_t Capacity>
+    class SpscQueue {
+        static_assert((Capacity & (Capacity - 1)) == 0, "ERROR: SpscQueue capacity must be a power of two");
+
+        std::array<T, Capacity> _items;
+        alignas(64) std::atomic<std::size_t> _head{0};
+        alignas(64) std::atomic<std::size_t> _tail{0};
+
+    public:
+        // Producer side, returns false (dropping item) when full
+        bool Push(T const& item) {
+            auto tail = _tail.load(std::memory_order_relaxed);
+            if(tail - _head.load(std::memory_order_acquire) == Capacity) {
+                return false;
+            }
+            _items[tail & (Capacity - 1)] = item;
+            _tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side, returns false when empty
+        bool Pop(T & item) {
+            auto head = _head.load(std::memory_order_relaxed);
+            if(head == _tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+            item = _items[head & (Capacity - 1)];
+            _head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool Empty() const {
+            return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+        }
+    };
+
+    enum class Waveform : unsigned char {
+        Square,
+        Triangle,
+        Saw,
+        Sine,
+        Noise,
+    };
+
+    // Times in seconds, sustain is a level between 0 and 1
+    struct Envelope {
+        float attack = 0.005f;
+        float decay = 0.05f;
+        float sustain = 0.7f;
+        float release = 0.1f;
+    };
+
+    struct AudioCommand {
+        enum class Type : unsigned char {
+            Note,       // start wave on channel for duration samples (-1 until stopped)
+            Stop,       // release channel
+            Envelope,   // envelope for the following notes of channel
+            Frame,      // one console frame has passed
+            Music,      // play track of music from frame and row, a negative track stops
+        };
+
+        Type type = Type::Frame;
+        unsigned char channel = 0;
+        Waveform wave = Waveform::Square;
+        float frequency = 0.0f;
+        float volume = 0.0f;
+        int duration = -1;
+        drak::Envelope envelope;
+        music::Data const* music = nullptr;
+        int track = -1;
+        int frame = 0;
+        int row = 0;
+        bool loop = true;
+    };
+
+    // Commands from the script thread to the synth, plus what flows back. Commands are only
+    // queued while a consumer is attached, so without one nothing piles up to be dropped or
+    // played back late.
+    class AudioQueue : public SpscQueue<AudioCommand, 1024> {
+        std::atomic<bool> _attached{false};
+        std::mutex _mutex;
+        std::condition_variable _wake;
+
+    public:
+        // Music data the synth is done with, to be freed by its owner off the audio thread
+        SpscQueue<music::Data const*, 64> retired;
+        // Music position last played, see music::PackPosition
+        std::atomic<std::int32_t> position{-1};
+
+        // Producer side, returns false when the command was not queued
+        bool Send(AudioCommand const& command) {
+            if(!_attached.load(std::memory_order_acquire) || !Push(command)) {
+                return false;
+            }
+            // Consumers waiting for work only need to run once a frame is complete
+            if(command.type == AudioCommand::Type::Frame) {
+                Wake();
+            }
+            return true;
+        }
+
+        // Consumer side, before it starts popping. Whatever a previous consumer left is dropped.
+        void Attach() {
+            AudioCommand stale;
+            while(Pop(stale)) {
+                if(stale.type == AudioCommand::Type::Music && stale.music) {
+                    retired.Push(stale.music);
+                }
+            }
+            position.store(-1, std::memory_order_relaxed);
+            _attached.store(true, std::memory_order_release);
+        }
+
+        // Consumer side, once it has stopped popping
+        void Detach() {
+            _attached.store(false, std::memory_order_release);
+        }
+
+        bool Attached() const {
+            return _attached.load(std::memory_order_acquire);
+        }
+
+        // Consumer side, blocks until there is something to pop or stop is set and Wake called
+        void Wait(std::atomic<bool> const& stop) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            // Whoever is in Flush can go on once the queue has run dry
+            _wake.notify_all();
+            _wake.wait(lock, [&]() { return stop || !Empty(); });
+        }
+
+        void Wake() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _wake.notify_all();
+        }
+
+        // Producer side, blocks until the consumer has popped everything queued. Only for
+        // consumers that wait on the queue, like WavRenderer; AudioDevice pops on its own time.
+        void Flush() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [&]() { return !Attached() || Empty(); });
+        }
+    };
+
+    // A few waveform channels with ADSR envelopes, mixed to mono 16-bit. Oscillators and
+    // envelopes run per block; mixing and conversion are SIMD over whole blocks. Music gets its
+    // own channels after the sfx ones and is sequenced once per frame worth of samples.
+    class Synth {
+    public:
+        static constexpr unsigned int SampleRate = 44100;
+        static constexpr unsigned int FrameRate = 60;
+        static constexpr unsigned int SamplesPerFrame = SampleRate / FrameRate;
+        static constexpr unsigned int Channels = 4;
+        static constexpr unsigned int Voices = Channels + music::Channels;
+
+    private:
+        static constexpr std::size_t BlockSize = 64;
+        static constexpr std::uint32_t Forever = std::numeric_limits<std::uint32_t>::max();
+
+        enum class Stage : unsigned char { Off, Attack, Decay, Sustain, Release };
+
+        struct Channel {
+            Waveform wave = Waveform::Square;
+            Envelope envelope;
+            Stage stage = Stage::Off;
+            double phase = 0.0;
+            double increment = 0.0;
+            float volume = 0.0f;
+            float instrumentVolume = 1.0f; // Music only, the instrument's share of volume
+            float level = 0.0f;
+            std::uint32_t stageLeft = 0;
+            std::uint32_t noteLeft = Forever;
+            std::uint16_t noise = 1;
+            float noiseValue = 1.0f;
+        };
+
+        // Turns sequencer events into changes of the music channels
+        struct MusicSink {
+            Synth & synth;
+
+            Channel & At(unsigned int channel) {
+                return synth._channels[Channels + channel];
+            }
+
+            void Trigger(unsigned int channel, music::Instrument const& instrument, float frequency, float volume) {
+                auto & ch = At(channel);
+                ch.wave = static_cast<Waveform>(instrument.wave);
+                ch.envelope = Envelope{instrument.attack, instrument.decay, instrument.sustain, instrument.release};
+                ch.increment = frequency / double(SampleRate);
+                ch.instrumentVolume = instrument.volume;
+                ch.volume = instrument.volume * volume;
+                ch.noteLeft = Forever;
+                Enter(ch, Stage::Attack);
+            }
+
+            void Pitch(unsigned int channel, float frequency) {
+                At(channel).increment = frequency / double(SampleRate);
+            }
+
+            void Volume(unsigned int channel, float volume) {
+                auto & ch = At(channel);
+                ch.volume = ch.instrumentVolume * volume;
+            }
+
+            void Release(unsigned int channel) {
+                auto & ch = At(channel);
+                if(ch.stage != Stage::Off) {
+                    Enter(ch, Stage::Release);
+                }
+            }
+
+            void Cut(unsigned int channel) {
+                auto & ch = At(channel);
+                ch.level = 0.0f;
+                Enter(ch, Stage::Off);
+            }
+        };
+
+        AudioQueue * _queue;
+        std::array<Channel, Voices> _channels;
+        music::Sequencer _sequencer;
+        std::uint32_t _tickLeft = 0;
+        alignas(16) std::array<float, BlockSize> _wave;
+        alignas(16) std::array<float, BlockSize> _mix;
+
+    public:
+        // queue receives retired music data and the playback position, if given
+        explicit Synth(AudioQueue * queue = nullptr)
+            : _queue{queue} { }
+
+        void Apply(AudioCommand const& command) {
+            if(command.type == AudioCommand::Type::Music) {
+                PlayMusic(command);
+                return;
+            }
+            if(command.channel >= Channels) {
+                return;
+            }
+            auto & ch = _channels[command.channel];
+
+            switch(command.type) {
+            case AudioCommand::Type::Note:
+                ch.wave = command.wave;
+                ch.increment = command.frequency / double(SampleRate);
+                ch.volume = std::min(std::max(command.volume, 0.0f), 1.0f);
+                ch.noteLeft = command.duration < 0 ? Forever : std::uint32_t(command.duration);
+                Enter(ch, Stage::Attack);
+                break;
+            case AudioCommand::Type::Stop:
+                if(ch.stage != Stage::Off) {
+                    Enter(ch, Stage::Release);
+                }
+                break;
+            case AudioCommand::Type::Envelope:
+                ch.envelope = command.envelope;
+                break;
+            case AudioCommand::Type::Frame:
+            case AudioCommand::Type::Music:
+                break;
+            }
+        }
+
+        void Render(std::int16_t * out, std::size_t samples) {
+            while(samples > 0) {
+                auto n = std::min(samples, BlockSize);
+                if(_sequencer.Playing()) {
+                    if(_tickLeft == 0) {
+                        TickMusic();
+                    }
+                    n = std::min<std::size_t>(n, _tickLeft);
+                    _tickLeft -= static_cast<std::uint32_t>(n);
+                }
+                std::fill(_mix.begin(), _mix.end(), 0.0f);
+
+                for(auto & ch : _channels) {
+                    if(ch.stage == Stage::Off) {
+                        continue;
+                    }
+                    auto start = ch.level;
+                    Advance(ch, static_cast<std::uint32_t>(n));
+                    Oscillate(ch, n);
+                    MixRamp(_mix.data(), _wave.data(), n, start * ch.volume / Voices, ch.level * ch.volume / Voices);
+                }
+
+                Convert(out, _mix.data(), n);
+                out += n;
+                samples -= n;
+            }
+        }
+
+    private:
+        void PlayMusic(AudioCommand const& command) {
+            MusicSink sink{*this};
+            auto previous = _sequencer.Music();
+            _sequencer.Play(sink, command.music, command.track, command.frame, command.row, command.loop);
+            if(previous) {
+                Retire(previous);
+            }
+            // A command for an invalid track still hands its data back
+            if(command.music && !_sequencer.Playing()) {
+                Retire(command.music);
+            }
+            _tickLeft = 0;
+            Publish(_sequencer.Position());
+        }
+
+        void TickMusic() {
+            MusicSink sink{*this};
+            auto position = _sequencer.Position();
+            auto music = _sequencer.Music();
+            _sequencer.Tick(sink);
+            _tickLeft = SamplesPerFrame;
+            if(!_sequencer.Playing()) {
+                Retire(music);
+                position = -1;
+            }
+            Publish(position);
+        }
+
+        void Retire(music::Data const* music) {
+            // If the owner falls behind the data is just held on to until it's destroyed
+            if(_queue) {
+                _queue->retired.Push(music);
+            }
+        }
+
+        void Publish(std::int32_t position) {
+            if(_queue) {
+                _queue->position.store(position, std::memory_order_relaxed);
+            }
+        }
+
+        static std::uint32_t Samples(float seconds) {
+            return static_cast<std::uint32_t>(std::max(seconds, 0.0f) * SampleRate);
+        }
+
+        static void Enter(Channel & ch, Stage stage) {
+            ch.stage = stage;
+            switch(stage) {
+            case Stage::Attack: ch.stageLeft = Samples(ch.envelope.attack); break;
+            case Stage::Decay: ch.stageLeft = Samples(ch.envelope.decay); break;
+            case Stage::Release: ch.stageLeft = Samples(ch.envelope.release); break;
+            default: ch.stageLeft = 0; break;
+            }
+        }
+
+        // Moves the envelope n samples forward, through as many stages as needed
+        static void Advance(Channel & ch, std::uint32_t n) {
+            for(;;) {
+                if(ch.stage == Stage::Off) {
+                    ch.level = 0.0f;
+                    return;
+                }
+
+                if(ch.noteLeft == 0 && ch.stage != Stage::Release) {
+                    Enter(ch, Stage::Release);
+                    continue;
+                }
+                if(ch.stage != Stage::Sustain && ch.stageLeft == 0) {
+                    switch(ch.stage) {
+                    case Stage::Attack: ch.level = 1.0f; Enter(ch, Stage::Decay); break;
+                    case Stage::Decay: ch.level = ch.envelope.sustain; Enter(ch, Stage::Sustain); break;
+                    default: ch.level = 0.0f; Enter(ch, Stage::Off); break;
+                    }
+                    continue;
+                }
+                if(n == 0) {
+                    return;
+                }
+
+                auto step = n;
+                if(ch.stage != Stage::Sustain) {
+                    step = std::min(step, ch.stageLeft);
+                }
+                if(ch.stage != Stage::Release && ch.noteLeft != Forever) {
+                    step = std::min(step, ch.noteLeft);
+                }
+
+                auto target = ch.stage == Stage::Attack ? 1.0f : ch.stage == Stage::Release ? 0.0f : ch.envelope.sustain;
+                if(ch.stage != Stage::Sustain) {
+                    ch.level += (target - ch.level) * float(step) / float(ch.stageLeft);
+                    ch.stageLeft -= step;
+                }
+                if(ch.noteLeft != Forever && ch.stage != Stage::Release) {
+                    ch.noteLeft -= step;
+                }
+                n -= step;
+            }
+        }
+
+        void Oscillate(Channel & ch, std::size_t n) {
+            auto phase = static_cast<float>(ch.phase);
+            auto increment = static_cast<float>(ch.increment);
+            auto wave = _wave.data();
+
+            // Phase is recomputed from the block start so the loops stay free of carried state
+            switch(ch.wave) {
+            case Waveform::Square:
+                for(std::size_t i = 0; i < n; i++) {
+                    auto p = phase + increment * i;
+                    p -= static_cast<float>(static_cast<int>(p));
+                    wave[i] = p < 0.5f ? 1.0f : -1.0f;
+                }
+                break;
+            case Waveform::Triangle:
+                for(std::size_t i = 0; i < n; i++) {
+                    auto p = phase + increment * i;
+                    p -= static_cast<float>(static_cast<int>(p));
+                    wave[i] = 1.0f - 4.0f * std::abs(p - 0.5f);
+                }
+                break;
+            case Waveform::Saw:
+                for(std::size_t i = 0; i < n; i++) {
+                    auto p = phase + increment * i;
+                    p -= static_cast<float>(static_cast<int>(p));
+                    wave[i] = 2.0f * p - 1.0f;
+                }
+                break;
+            case Waveform::Sine:
+                for(std::size_t i = 0; i < n; i++) {
+                    wave[i] = std::sin(6.28318531f * (phase + increment * i));
+                }
+                break;
+            case Waveform::Noise: {
+                // 15-bit LFSR clocked once per period
+                auto p = ch.phase;
+                for(std::size_t i = 0; i < n; i++) {
+                    p += ch.increment;
+                    if(p >= 1.0) {
+                        p -= std::floor(p);
+                        auto bit = ((ch.noise >> 0) ^ (ch.noise >> 1)) & 1;
+                        ch.noise = static_cast<std::uint16_t>((ch.noise >> 1) | (bit << 14));
+                        ch.noiseValue = (ch.noise & 1) ? 1.0f : -1.0f;
+                    }
+                    wave[i] = ch.noiseValue;
+                }
+                ch.phase = p;
+                return;
+            }
+            }
+
+            ch.phase += ch.increment * n;
+            ch.phase -= std::floor(ch.phase);
+        }
+
+        // mix[i] += wave[i] * gain, gain going linearly from start to end over the block
+        static void MixRamp(float * mix, float const* wave, std::size_t n, float start, float end) {
+            auto slope = (end - start) / float(n);
+            std::size_t i = 0;
+#ifdef DRAK_AUDIO_SSE2
+            auto gain = _mm_setr_ps(start, start + slope, start + 2 * slope, start + 3 * slope);
+            auto step = _mm_set1_ps(4 * slope);
+            for(; i + 4 <= n; i += 4) {
+                auto sum = _mm_add_ps(_mm_load_ps(mix + i), _mm_mul_ps(_mm_load_ps(wave + i), gain));
+                _mm_store_ps(mix + i, sum);
+                gain = _mm_add_ps(gain, step);
+            }
+#endif
+            for(; i < n; i++) {
+                mix[i] += wave[i] * (start + slope * i);
+            }
+        }
+
+        static void Convert(std::int16_t * out, float const* mix, std::size_t n) {
+            std::size_t i = 0;
+#ifdef DRAK_AUDIO_SSE2
+            auto scale = _mm_set1_ps(32767.0f);
+            for(; i + 8 <= n; i += 8) {
+                // packs saturates to the int16 range
+                auto lo = _mm_cvtps_epi32(_mm_mul_ps(_mm_load_ps(mix + i), scale));
+                auto hi = _mm_cvtps_epi32(_mm_mul_ps(_mm_load_ps(mix + i + 4), scale));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packs_epi32(lo, hi));
+            }
+#endif
+            for(; i < n; i++) {
+                auto v = std::min(std::max(mix[i], -1.0f), 1.0f);
+                out[i] = static_cast<std::int16_t>(std::lround(v * 32767.0f));
+            }
+        }
+    };
+
+    // 16-bit mono PCM .wav file, sizes patched in when closed
+    class WavWriter {
+        nowide::ofstream _out;
+        std::uint32_t _samples = 0;
+        std::vector<char> _buffer;
+
+        void Put16(std::uint16_t v) {
+            char b[2] = { char(v & 0xFF), char(v >> 8) };
+            _out.write(b, 2);
+        }
+
+        void Put32(std::uint32_t v) {
+            char b[4] = { char(v & 0xFF), char((v >> 8) & 0xFF), char((v >> 16) & 0xFF), char(v >> 24) };
+            _out.write(b, 4);
+        }
+
+        void Header() {
+            _out.seekp(0);
+            _out.write("RIFF", 4);
+            Put32(36 + _samples * 2);
+            _out.write("WAVEfmt ", 8);
+            Put32(16);
+            Put16(1);
+            Put16(1);
+            Put32(Synth::SampleRate);
+            Put32(Synth::SampleRate * 2);
+            Put16(2);
+            Put16(16);
+            _out.write("data", 4);
+            Put32(_samples * 2);
+        }
+
+    public:
+        explicit WavWriter(std::string const& path)
+            : _out(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc) {
+            Header();
+        }
+
+        ~WavWriter() {
+            Close();
+        }
+
+        bool IsOpen() const {
+            return _out.is_open();
+        }
+
+        void Write(std::int16_t const* samples, std::size_t count) {
+            _buffer.resize(count * 2);
+            for(std::size_t i = 0; i < count; i++) {
+                auto v = static_cast<std::uint16_t>(samples[i]);
+                _buffer[i * 2] = char(v & 0xFF);
+                _buffer[i * 2 + 1] = char(v >> 8);
+            }
+            _out.write(_buffer.data(), _buffer.size());
+            _samples += static_cast<std::uint32_t>(count);
+        }
+
+        void Close() {
+            if(_out.is_open()) {
+                Header();
+                _out.close();
+            }
+        }
+    };
+
+    // Headless audio output: a thread that drains the queue and renders one frame of samples
+    // into a .wav file per Frame command, so the file follows console time, not wall time
+    class WavRenderer {
+        AudioQueue & _queue;
+        WavWriter _wav;
+        Synth _synth;
+        std::atomic<bool> _stop{false};
+        std::thread _thread;
+
+    public:
+        WavRenderer(AudioQueue & queue, std::string const& path)
+            : _queue{queue}, _wav{path}, _synth{&queue} {
+            _queue.Attach();
+            _thread = std::thread([this]() { Run(); });
+        }
+
+        bool IsOpen() const {
+            return _wav.IsOpen();
+        }
+
+        WavRenderer(WavRenderer const&) = delete;
+        WavRenderer & operator=(WavRenderer const&) = delete;
+
+        // Renders whatever is still queued, then finishes the file
+        ~WavRenderer() {
+            _stop = true;
+            _queue.Wake();
+            _thread.join();
+            _queue.Detach();
+            _wav.Close();
+        }
+
+    private:
+        void Run() {
+            std::array<std::int16_t, Synth::SamplesPerFrame> frame;
+            AudioCommand command;
+            for(;;) {
+                if(_queue.Pop(command)) {
+                    _synth.Apply(command);
+                    if(command.type == AudioCommand::Type::Frame) {
+                        _synth.Render(frame.data(), frame.size());
+                        _wav.Write(frame.data(), frame.size());
+                    }
+                } else if(_stop) {
+                    return;
+                } else {
+                    _queue.Wait(_stop);
+                }
+            }
+        }
+    };
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "audio.hpp"
+
+namespace drak {
+
+    // Real-time audio output. SFML pulls samples from its own streaming thread, which drains the
+    // command queue and runs the synth, so the script thread only ever pushes commands.
+    class AudioDevice : public sf::SoundStream {
+        AudioQueue & _queue;
+        Synth _synth;
+        std::vector<std::int16_t> _buffer;
+
+    public:
+        explicit AudioDevice(AudioQueue & queue, std::size_t buffer_samples = 1024)
+            : _queue{queue}, _synth{&queue}, _buffer(buffer_samples) {
+            _queue.Attach();
+            initialize(1, Synth::SampleRate);
+        }
+
+        ~AudioDevice() {
+            stop();
+            _queue.Detach();
+        }
+
+    protected:
+        bool onGetData(Chunk & data) override {
+            AudioCommand command;
+            while(_queue.Pop(command)) {
+                _synth.Apply(command);
+            }
+
+            _synth.Render(_buffer.data(), _buffer.size());
+            data.samples = _buffer.data();
+            data.sampleCount = _buffer.size();
+            return true;
+        }
+
+        void onSeek(sf::Time) override {
+        }
+    };
+
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "system.hpp"
+
+namespace drak {
+
+    // Peak resident memory of the whole process so far, in bytes
+    inline std::size_t PeakMemoryBytes() {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters{};
+        if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+            return counters.PeakWorkingSetSize;
+        }
+        return 0;
+#else
+        rusage usage{};
+        if(getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+            return static_cast<std::size_t>(usage.ru_maxrss);
+#else
+            return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#endif
+        }
+        return 0;
+#endif
+    }
+
+    struct CartResult {
+        std::filesystem::path cart;
+        unsigned int frames = 0;
+        double seconds = 0.0;
+        bool failed = false;
+        std::string error;
+
+        double Fps() const {
+            return seconds > 0.0 ? frames / seconds : 0.0;
+        }
+    };
+
+    struct BatchReport {
+        std::vector<CartResult> carts;
+        unsigned int threads = 0;
+        double seconds = 0.0;
+        std::size_t peakMemory = 0;
+
+        unsigned int Failures() const {
+            return static_cast<unsigned int>(std::count_if(carts.begin(), carts.end(), [](CartResult const& r) { return r.failed; }));
+        }
+
+        unsigned long long Frames() const {
+            unsigned long long frames = 0;
+            for(auto const& r : carts) {
+                frames += r.frames;
+            }
+            return frames;
+        }
+
+        void Print(std::ostream & out) const {
+            out << std::fixed << std::setprecision(1);
+            for(auto const& r : carts) {
+                out << (r.failed ? "FAIL " : "ok   ") << r.cart.filename().string()
+                    << "  " << r.frames << " frames, " << r.Fps() << " fps\n";
+                if(r.failed) {
+                    out << "     " << r.error << "\n";
+                }
+            }
+            out << "\n"
+                << carts.size() << " carts, " << Failures() << " failed, " << threads << " threads\n"
+                << Frames() << " frames in " << seconds << " s, " << (seconds > 0.0 ? Frames() / seconds : 0.0) << " fps aggregate\n"
+                << "peak memory " << (peakMemory / (1024.0 * 1024.0)) << " MiB\n";
+        }
+    };
+
+    // Runs every cartridge of a directory headlessly for a fixed number of frames, spreading the
+    // carts over a pool of worker threads. Each worker owns one System at a time, so carts never
+    // share script state.
+    class BatchRunner {
+        unsigned int _threads;
+        unsigned int _frames;
+
+    public:
+        BatchRunner(unsigned int frames = 600, unsigned int threads = std::thread::hardware_concurrency())
+            : _threads{std::max(threads, 1u)}, _frames{frames} { }
+
+        BatchReport Run(std::filesystem::path const& directory) const {
+            std::vector<std::filesystem::path> carts;
+            for(auto const& entry : std::filesystem::directory_iterator(directory)) {
+                if(std::filesystem::is_regular_file(entry.status()) && entry.path().extension() == ".chai") {
+                    carts.push_back(entry.path());
+                }
+            }
+            std::sort(carts.begin(), carts.end());
+            return Run(carts);
+        }
+
+        BatchReport Run(std::vector<std::filesystem::path> const& carts) const {
+            BatchReport report;
+            report.carts.resize(carts.size());
+            report.threads = std::min<unsigned int>(_threads, static_cast<unsigned int>(std::max<std::size_t>(carts.size(), 1)));
+
+            std::atomic<std::size_t> next{0};
+            auto worker = [&]() {
+                for(auto i = next++; i < carts.size(); i = next++) {
+                    report.carts[i] = RunCart(carts[i]);
+                }
+            };
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> pool;
+            for(unsigned int t = 1; t < report.threads; t++) {
+                pool.emplace_back(worker);
+            }
+            worker();
+            for(auto & thread : pool) {
+                thread.join();
+            }
+            report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            report.peakMemory = PeakMemoryBytes();
+            return report;
+        }
+
+    private:
+        CartResult RunCart(std::filesystem::path const& cart) const {
+            CartResult result;
+            result.cart = cart;
+
+            try {
+                std::string source;
+                {
+                    nowide::ifstream in(cart.string().c_str(), std::ios::in | std::ios::binary);
+                    if(!in) {
+                        throw std::runtime_error("cannot open cartridge");
+                    }
+                    source.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+                }
+
+                System sys;
+                sys.SetLog(nullptr);
+                sys.LoadScript(source);
+
+                auto start = std::chrono::steady_clock::now();
+                while(result.frames < _frames && !sys.MustQuit()) {
+                    if(!sys.Update()) {
+                        throw std::runtime_error("cartridge has no update function");
+                    }
+                    result.frames++;
+                }
+                result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            } catch(chaiscript::exception::eval_error const& e) {
+                result.failed = true;
+                result.error = e.pretty_print();
+            } catch(std::exception const& e) {
+                result.failed = true;
+                result.error = e.what();
+            } catch(...) {
+                result.failed = true;
+                result.error = "unknown error";
+            }
+
+            return result;
+        }
+    };
+
+}
@@ -0,0 +1,1526 @@
+#include "pch.h"
+
+#include "arguments.hpp"
+#include "bench.hpp"
+#include "system.hpp"
+
+namespace {
+
+// Wall time of f() in seconds
+template <typename F>
+double timeSeconds(F && f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Loads source as a cart into sys and times frames updates (and presents) of it, in seconds
+double timeCart(drak::System & sys, std::string const& source, unsigned int frames, bool present) {
+    std::vector<std::uint32_t> frame(drak::display::Width * drak::display::Height);
+    sys.SetLog(nullptr);
+    sys.LoadScript(source);
+    return timeSeconds([&]() {
+        for(unsigned int i = 0; i < frames; i++) {
+            sys.Update();
+            if(present) {
+                sys.Present(frame.data());
+            }
+        }
+    });
+}
+
+// Renders music on all music channels plus a held note on every sfx channel, as fast as possible
+int benchAudio(drak::Arguments const& args) {
+    unsigned int seconds = args.Count(0, 60);
+
+    // Four instruments and one pattern per channel, each with its own effect
+    std::array<unsigned char, drak::music::Size> bank{};
+    for(unsigned int i = 0; i < drak::music::Channels; i++) {
+        unsigned char instrument[] = { static_cast<unsigned char>(i), 12, 1, 10, 8, 5 };
+        std::copy(std::begin(instrument), std::end(instrument), bank.begin() + drak::music::InstrumentOffset + i * drak::music::InstrumentSize);
+
+        unsigned char effects[] = { 0x14, 0x42, 0x21, 0x31 };
+        for(unsigned int row = 0; row < drak::music::Rows; row++) {
+            auto out = bank.begin() + drak::music::PatternOffset + i * drak::music::PatternSize + row * drak::music::RowSize;
+            out[0] = static_cast<unsigned char>(row % 4 == 3 ? drak::music::NoteOff : 25 + i * 12 + (row * 5) % 24);
+            out[1] = static_cast<unsigned char>(i);
+            out[3] = effects[i];
+        }
+    }
+    auto track = bank.begin() + drak::music::TrackOffset;
+    track[0] = 3;
+    for(unsigned int frame = 0; frame < drak::music::Frames; frame++) {
+        for(unsigned int channel = 0; channel < drak::music::Channels; channel++) {
+            track[4 + frame * drak::music::Channels + channel] = static_cast<unsigned char>(channel + 1);
+        }
+    }
+    auto data = drak::music::Data::Decode(bank.data());
+
+    drak::Synth synth;
+    for(unsigned int channel = 0; channel < drak::Synth::Channels; channel++) {
+        drak::AudioCommand note;
+        note.type = drak::AudioCommand::Type::Note;
+        note.channel = static_cast<unsigned char>(channel);
+        note.wave = static_cast<drak::Waveform>(channel);
+        note.frequency = 110.0f * (channel + 1);
+        note.volume = 1.0f;
+        synth.Apply(note);
+    }
+    drak::AudioCommand play;
+    play.type = drak::AudioCommand::Type::Music;
+    play.music = data.get();
+    play.track = 0;
+    synth.Apply(play);
+
+    std::vector<std::int16_t> buffer(1024);
+    std::size_t samples = std::size_t(seconds) * drak::Synth::SampleRate;
+    auto elapsed = timeSeconds([&]() {
+        for(std::size_t done = 0; done < samples; done += buffer.size()) {
+            synth.Render(buffer.data(), std::min(buffer.size(), samples - done));
+        }
+    });
+
+    nowide::cout << seconds << " s of audio, " << drak::Synth::Voices << " voices at " << drak::Synth::SampleRate << " Hz\n"
+        << (elapsed * 1000.0 / seconds) << " ms of CPU per second of audio ("
+        << (seconds / elapsed) << "x real time)\n";
+    return 0;
+}
+
+// Draws primitives of every kind at random into a clipped screen, primitives per frame at a time
+int benchRaster(drak::Arguments const& args) {
+    unsigned int frames = args.Count(0, 600);
+    unsigned int primitives = args.Count(1, 5000);
+
+    std::vector<unsigned char> screen(drak::Rasterizer::Bytes);
+    drak::Rasterizer raster(screen.data());
+    raster.Clip(8, 8, drak::Rasterizer::Width - 16, drak::Rasterizer::Height - 16);
+
+    std::mt19937 random(1);
+    auto coord = [&](int size) { return static_cast<int>(random() % (size + 64)) - 32; };
+    auto size = [&]() { return static_cast<int>(random() % 48); };
+
+    std::vector<std::array<int, 6>> shapes(primitives);
+    for(auto & shape : shapes) {
+        shape = { static_cast<int>(random() % 5), coord(drak::Rasterizer::Width), coord(drak::Rasterizer::Height), size(), size(), static_cast<int>(random() % 64) };
+    }
+
+    auto elapsed = timeSeconds([&]() {
+        for(unsigned int frame = 0; frame < frames; frame++) {
+            raster.Clear(frame % 64);
+            for(auto const& s : shapes) {
+                switch(s[0]) {
+                case 0: raster.Line(s[1], s[2], s[1] + s[3] - 24, s[2] + s[4] - 24, s[5]); break;
+                case 1: raster.Rect(s[1], s[2], s[3], s[4], s[5]); break;
+                case 2: raster.RectB(s[1], s[2], s[3], s[4], s[5]); break;
+                case 3: raster.Circ(s[1], s[2], s[3] / 2, s[5]); break;
+                default: raster.CircB(s[1], s[2], s[3] / 2, s[5]); break;
+                }
+            }
+        }
+    });
+
+    nowide::cout << frames << " frames of " << primitives << " primitives\n"
+        << (elapsed * 1000.0 / frames) << " ms per frame, "
+        << (frames * double(primitives) / elapsed / 1e6) << " million primitives per second\n";
+    return 0;
+}
+
+// A coordinate or size for the reference tests: mostly low..high, now and then anything an int holds
+int testValue(std::mt19937 & random, int low, int high) {
+    switch(random() % 16) {
+    case 0: return static_cast<int>(static_cast<std::int32_t>(random()));
+    case 1: return random() % 2 ? std::numeric_limits<int>::max() : std::numeric_limits<int>::min();
+    default: return low + static_cast<int>(random() % static_cast<unsigned int>(high - low + 1));
+    }
+}
+
+// Whether pixel x, y belongs to shape (a kind like benchRaster's, the arguments it's drawn with,
+// then the color), worked out directly from the definitions in raster.hpp
+bool shapeReference(std::array<int, 6> const& s, std::int64_t x, std::int64_t y) {
+    // Whether x, y is in the disc of radius r around s[1], s[2]
+    auto disc = [&](std::int64_t r) {
+        auto dx = static_cast<std::uint64_t>(std::abs(x - s[1]));
+        auto dy = static_cast<std::uint64_t>(std::abs(y - s[2]));
+        return r >= 0 && dx * dx + dy * dy <= static_cast<std::uint64_t>(r * r + r);
+    };
+    auto left = std::int64_t(s[1]);
+    auto top = std::int64_t(s[2]);
+    auto right = left + s[3] - 1;
+    auto bottom = top + s[4] - 1;
+    auto rect = x >= left && x <= right && y >= top && y <= bottom;
+
+    switch(s[0]) {
+    case 0: {
+        // Bresenham: the pixel at i along the major axis is round(i * minor / major) along the
+        // minor one, halfway rounded away from the start
+        auto dx = std::abs(std::int64_t(s[3]) - s[1]);
+        auto dy = std::abs(std::int64_t(s[4]) - s[2]);
+        auto along_x = (x - s[1]) * (s[3] < s[1] ? -1 : 1);
+        auto along_y = (y - s[2]) * (s[4] < s[2] ? -1 : 1);
+        auto major = std::max(dx, dy);
+        auto minor = std::min(dx, dy);
+        auto i = dx >= dy ? along_x : along_y;
+        auto offset = dx >= dy ? along_y : along_x;
+        if(i < 0 || i > major) {
+            return false;
+        }
+        if(major == 0) {
+            return offset == 0;
+        }
+        auto expected = (static_cast<std::uint64_t>(i) * static_cast<std::uint64_t>(minor) + static_cast<std::uint64_t>(major / 2)) / static_cast<std::uint64_t>(major);
+        return offset == static_cast<std::int64_t>(expected);
+    }
+    case 1: return rect;
+    case 2: return rect && (x == left || x == right || y == top || y == bottom);
+    case 3: return disc(s[3]);
+    default: return disc(s[3]) && !disc(std::int64_t(s[3]) - 1);
+    }
+}
+
+// Draws random lines, rects and circles, from tiny to reaching past the int range, under random
+// clip rectangles and compares every pixel with shapeReference; returns 1 if any pixel differs
+int testRaster(drak::Arguments const& args) {
+    unsigned int scenes = args.Count(0, 10000);
+
+    std::vector<unsigned char> screen(drak::Rasterizer::Bytes);
+    drak::Rasterizer raster(screen.data());
+    std::mt19937 random(1);
+    unsigned long long mismatches = 0;
+    unsigned int failed = 0;
+    for(unsigned int i = 0; i < scenes; i++) {
+        auto kind = static_cast<int>(random() % 5);
+        std::array<int, 6> s = {
+            kind, testValue(random, -40, 360), testValue(random, -40, 280),
+            kind == 0 ? testValue(random, -40, 360) : testValue(random, -4, kind < 3 ? 400 : 200),
+            kind == 0 ? testValue(random, -40, 280) : testValue(random, -4, 300),
+            static_cast<int>(random() % 63)
+        };
+        std::array<int, 4> clip = { testValue(random, -20, 340), testValue(random, -20, 260), testValue(random, -20, 400), testValue(random, -20, 300) };
+
+        raster.Unclip();
+        raster.Clear(64 - 1);
+        raster.Clip(clip[0], clip[1], clip[2], clip[3]);
+        switch(kind) {
+        case 0: raster.Line(s[1], s[2], s[3], s[4], s[5]); break;
+        case 1: raster.Rect(s[1], s[2], s[3], s[4], s[5]); break;
+        case 2: raster.RectB(s[1], s[2], s[3], s[4], s[5]); break;
+        case 3: raster.Circ(s[1], s[2], s[3], s[5]); break;
+        default: raster.CircB(s[1], s[2], s[3], s[5]); break;
+        }
+
+        // The clip rectangle, clamped to the screen
+        auto left = std::min<std::int64_t>(std::max(clip[0], 0), drak::Rasterizer::Width);
+        auto top = std::min<std::int64_t>(std::max(clip[1], 0), drak::Rasterizer::Height);
+        auto right = std::min<std::int64_t>(std::int64_t(clip[0]) + std::max(clip[2], 0), drak::Rasterizer::Width);
+        auto bottom = std::min<std::int64_t>(std::int64_t(clip[1]) + std::max(clip[3], 0), drak::Rasterizer::Height);
+
+        auto before = mismatches;
+        for(int y = 0; y < drak::Rasterizer::Height; y++) {
+            for(int x = 0; x < drak::Rasterizer::Width; x++) {
+                auto inside = x >= left && x < right && y >= top && y < bottom;
+                auto expected = inside && shapeReference(s, x, y) ? s[5] : 64 - 1;
+                mismatches += raster.Get(x, y) != expected;
+            }
+        }
+        failed += mismatches != before;
+    }
+
+    nowide::cout << scenes << " clipped primitives, " << failed << " with differences, " << mismatches << " pixels differ\n";
+    return failed == 0 ? 0 : 1;
+}
+
+// Runs the same random drawing, direct writes to the packed surface and reads through two
+// rasterizers, one repacking only when asked and one that flushes and reloads after every
+// operation, and compares what they see and leave in the packed surface; returns 1 if they differ
+int testShadow(drak::Arguments const& args) {
+    unsigned int operations = args.Count(0, 20000);
+
+    std::vector<unsigned char> lazy_surface(drak::Rasterizer::Bytes);
+    std::vector<unsigned char> eager_surface(drak::Rasterizer::Bytes);
+    drak::Rasterizer lazy(lazy_surface.data());
+    drak::Rasterizer eager(eager_surface.data());
+    std::mt19937 random(1);
+    auto coord = [&](int size) { return static_cast<int>(random() % (size + 64)) - 32; };
+
+    // Pixel x, y of a packed surface: 4 pixels to each 24-bit little endian group, the first in
+    // the low bits
+    auto unpack = [](std::vector<unsigned char> const& surface, int x, int y) {
+        auto i = y * drak::Rasterizer::Width + x;
+        auto group = surface.data() + i / 4 * 3;
+        auto bits = std::uint32_t(group[0]) | (std::uint32_t(group[1]) << 8) | (std::uint32_t(group[2]) << 16);
+        return static_cast<int>((bits >> (i % 4 * 6)) & 63);
+    };
+
+    unsigned int checks = 0;
+    unsigned int failed = 0;
+    for(unsigned int i = 0; i < operations; i++) {
+        std::array<int, 6> s = { coord(drak::Rasterizer::Width), coord(drak::Rasterizer::Height), coord(drak::Rasterizer::Width), coord(drak::Rasterizer::Height), static_cast<int>(random() % 48), static_cast<int>(random() % 64) };
+        auto operation = random() % 13;
+        if(operation == 0) {
+            // Something else writes the packed surface, like a poke or a memcpy
+            lazy.Flush();
+            eager.Flush();
+            auto first = random() % drak::Rasterizer::Bytes;
+            auto count = std::min<std::size_t>(random() % 2000, drak::Rasterizer::Bytes - first);
+            for(std::size_t b = first; b < first + count; b++) {
+                lazy_surface[b] = eager_surface[b] = static_cast<unsigned char>(random());
+            }
+            lazy.Invalidate();
+            eager.Invalidate();
+        }
+        for(auto raster : { &lazy, &eager }) {
+            switch(operation) {
+            case 1: raster->Line(s[0], s[1], s[2], s[3], s[5]); break;
+            case 2: raster->Rect(s[0], s[1], s[4], s[4], s[5]); break;
+            case 3: raster->RectB(s[0], s[1], s[4], s[4], s[5]); break;
+            case 4: raster->Circ(s[0], s[1], s[4] / 2, s[5]); break;
+            case 5: raster->CircB(s[0], s[1], s[4] / 2, s[5]); break;
+            case 6: raster->Pixel(s[0], s[1], s[5]); break;
+            case 7: raster->Tri({{ { double(s[0]), double(s[1]), 0, 0, 1 }, { double(s[2]), double(s[3]), 0, 0, 1 }, { double(s[0]), double(s[3]), 0, 0, 1 } }}, s[5]); break;
+            case 8: raster->Copy(*raster, s[0], s[1], s[4] * 2, s[4], s[2], s[3], s[5] % 2 ? s[5] : -1); break;
+            case 9: raster->Clip(s[0], s[1], s[4] * 4, s[4] * 4); break;
+            case 10: raster->Unclip(); break;
+            case 11: raster->Clear(s[5]); break;
+            default: break;
+            }
+        }
+        eager.Flush();
+        eager.Invalidate();
+
+        // Now and then, read a pixel through both, and less often compare everything
+        if(operation == 12) {
+            failed += lazy.Get(s[0], s[1]) != eager.Get(s[0], s[1]);
+            checks++;
+        }
+        if(random() % 16 == 0) {
+            auto pixels = lazy.Pixels();
+            auto differs = false;
+            for(int y = 0; y < drak::Rasterizer::Height; y++) {
+                for(int x = 0; x < drak::Rasterizer::Width; x++) {
+                    differs |= pixels[y * drak::Rasterizer::Width + x] != unpack(eager_surface, x, y);
+                }
+            }
+            lazy.Flush();
+            differs |= lazy_surface != eager_surface;
+            failed += differs;
+            checks++;
+        }
+    }
+
+    nowide::cout << operations << " operations, " << checks << " checks, " << failed << " failed\n";
+    return failed == 0 ? 0 : 1;
+}
+
+// A grid of quads over the whole screen (2 triangles each, a little overdraw) drawn flat,
+// textured and perspective textured, like a simple 3D scene
+int benchTriangles(drak::Arguments const& args) {
+    unsigned int frames = args.Count(0, 600);
+    unsigned int triangles = args.Count(1, 3000);
+
+    std::vector<unsigned char> screen(drak::Rasterizer::Bytes);
+    std::vector<unsigned char> texture(drak::Rasterizer::TextureSize * drak::Rasterizer::TextureSize * drak::Rasterizer::PixelBits / 8);
+    std::mt19937 random(1);
+    for(auto & byte : texture) {
+        byte = static_cast<unsigned char>(random());
+    }
+    drak::Rasterizer raster(screen.data());
+
+    // Quads of the grid overlap their neighbours by a quarter
+    auto columns = std::max(1, static_cast<int>(std::sqrt(triangles / 2.0 * 4.0 / 3.0)));
+    auto rows = std::max(1, static_cast<int>(triangles / 2 / columns));
+    auto w = drak::Rasterizer::Width / double(columns);
+    auto h = drak::Rasterizer::Height / double(rows);
+
+    std::vector<std::array<drak::Rasterizer::Vertex, 3>> mesh;
+    for(int row = 0; row < rows; row++) {
+        for(int column = 0; column < columns; column++) {
+            auto x = column * w;
+            auto y = row * h;
+            auto z = 1.0 + (row + column) % 7;
+            drak::Rasterizer::Vertex a{ x, y, 0.0, 0.0, z };
+            drak::Rasterizer::Vertex b{ x + w * 1.25, y, 32.0, 0.0, z + 1.0 };
+            drak::Rasterizer::Vertex c{ x, y + h * 1.25, 0.0, 32.0, z + 1.0 };
+            drak::Rasterizer::Vertex d{ x + w * 1.25, y + h * 1.25, 32.0, 32.0, z + 2.0 };
+            mesh.push_back({{ a, b, c }});
+            mesh.push_back({{ b, d, c }});
+        }
+    }
+
+    nowide::cout << frames << " frames of " << mesh.size() << " triangles\n";
+    char const* modes[] = { "flat", "textured", "perspective" };
+    for(int mode = 0; mode < 3; mode++) {
+        auto elapsed = timeSeconds([&]() {
+            for(unsigned int frame = 0; frame < frames; frame++) {
+                for(std::size_t i = 0; i < mesh.size(); i++) {
+                    if(mode == 0) {
+                        raster.Tri(mesh[i], static_cast<int>(i % 64));
+                    } else {
+                        raster.TexTri(mesh[i], texture.data(), 0, mode == 2);
+                    }
+                }
+            }
+        });
+        nowide::cout << modes[mode] << ": " << (elapsed * 1000.0 / frames) << " ms per frame\n";
+    }
+    return 0;
+}
+
+// The screen pixels whose centers the triangle covers, worked out directly: corners snapped to
+// 1/16 pixel, inside all three edges, or exactly on a top or left one
+std::vector<bool> triangleReference(std::array<drak::Rasterizer::Vertex, 3> const& vertices) {
+    std::vector<bool> covered(drak::Rasterizer::Width * drak::Rasterizer::Height);
+    std::int64_t vx[3];
+    std::int64_t vy[3];
+    for(int i = 0; i < 3; i++) {
+        vx[i] = std::llround(std::min(std::max(vertices[i].x, -32768.0), 32767.0) * 16);
+        vy[i] = std::llround(std::min(std::max(vertices[i].y, -32768.0), 32767.0) * 16);
+    }
+    auto area = (vx[1] - vx[0]) * (vy[2] - vy[0]) - (vy[1] - vy[0]) * (vx[2] - vx[0]);
+    if(area == 0) {
+        return covered;
+    }
+    // Clockwise on screen, y pointing down
+    int order[3] = { 0, area > 0 ? 1 : 2, area > 0 ? 2 : 1 };
+    for(int y = 0; y < drak::Rasterizer::Height; y++) {
+        for(int x = 0; x < drak::Rasterizer::Width; x++) {
+            auto inside = true;
+            for(int i = 0; i < 3; i++) {
+                auto a = order[i];
+                auto b = order[(i + 1) % 3];
+                auto dx = vx[b] - vx[a];
+                auto dy = vy[b] - vy[a];
+                auto side = dx * (y * 16 + 8 - vy[a]) - dy * (x * 16 + 8 - vx[a]);
+                // A top edge runs right, a left edge up
+                auto top_left = dy < 0 || (dy == 0 && dx > 0);
+                inside &= side > 0 || (side == 0 && top_left);
+            }
+            covered[y * drak::Rasterizer::Width + x] = inside;
+        }
+    }
+    return covered;
+}
+
+// Compares the pixels covered by random triangles (flat, textured and perspective textured)
+// with triangleReference, and checks that the triangles of random fans never cover a pixel
+// twice; returns 1 if any pixel differs
+int testTriangles(drak::Arguments const& args) {
+    unsigned int triangles = args.Count(0, 5000);
+
+    // A texture without the background color, so every covered pixel shows
+    std::vector<unsigned char> texture(drak::Rasterizer::TextureSize * drak::Rasterizer::TextureSize * drak::Rasterizer::PixelBits / 8);
+    drak::Rasterizer page(texture.data(), drak::Rasterizer::TextureSize, drak::Rasterizer::TextureSize);
+    std::mt19937 random(1);
+    for(int y = 0; y < drak::Rasterizer::TextureSize; y++) {
+        for(int x = 0; x < drak::Rasterizer::TextureSize; x++) {
+            page.Pixel(x, y, static_cast<int>(random() % 63));
+        }
+    }
+    page.Flush();
+
+    // Corners on the 1/16 grid (so that pixel centers land on edges), anywhere, or far off
+    auto coord = [&](int size) {
+        switch(random() % 8) {
+        case 0: return (static_cast<int>(random() % 1000000) - 500000) / 7.0;
+        case 1: return (static_cast<int>(random() % ((size + 80) * 1000)) - 40000) / 1000.0;
+        default: return (static_cast<int>(random() % ((size + 80) * 2)) - 80) / 2.0 + (random() % 2) / 16.0;
+        }
+    };
+    auto vertex = [&](double x, double y) {
+        return drak::Rasterizer::Vertex{ x, y, coord(256), coord(256), 0.5 + (random() % 64) / 16.0 };
+    };
+    auto corner = [&]() {
+        auto x = coord(drak::Rasterizer::Width);
+        auto y = coord(drak::Rasterizer::Height);
+        return vertex(x, y);
+    };
+
+    std::vector<unsigned char> screen(drak::Rasterizer::Bytes);
+    drak::Rasterizer raster(screen.data());
+    std::vector<int> covered(drak::Rasterizer::Width * drak::Rasterizer::Height);
+    unsigned long long mismatches = 0;
+    unsigned int failed = 0;
+    unsigned int overlaps = 0;
+    for(unsigned int i = 0; i < triangles; i++) {
+        // Every 16th case is a fan around a center, the rest single triangles
+        std::vector<std::array<drak::Rasterizer::Vertex, 3>> shapes;
+        if(i % 16 == 0) {
+            auto cx = coord(drak::Rasterizer::Width);
+            auto cy = coord(drak::Rasterizer::Height);
+            auto n = 3 + static_cast<int>(random() % 8);
+            // Corners in order around the center, less than half a turn apart
+            std::vector<drak::Rasterizer::Vertex> rim;
+            for(int j = 0; j < n; j++) {
+                auto angle = (j + (random() % 1024) / 2048.0) * (2 * 3.14159265358979 / n);
+                auto radius = 1.0 + random() % 200;
+                rim.push_back(vertex(std::round((cx + std::cos(angle) * radius) * 16) / 16, std::round((cy + std::sin(angle) * radius) * 16) / 16));
+            }
+            for(int j = 0; j < n; j++) {
+                shapes.push_back({{ vertex(cx, cy), rim[j], rim[(j + 1) % n] }});
+            }
+        } else {
+            // Often with a horizontal or vertical edge, where the top-left rule decides
+            std::array<drak::Rasterizer::Vertex, 3> shape = {{ corner(), corner(), corner() }};
+            switch(random() % 4) {
+            case 0: shape[1].y = shape[0].y; break;
+            case 1: shape[2].x = shape[0].x; break;
+            default: break;
+            }
+            shapes.push_back(shape);
+        }
+        auto x = static_cast<int>(random() % 40);
+        auto y = static_cast<int>(random() % 40);
+        auto mode = random() % 3;
+
+        std::fill(covered.begin(), covered.end(), 0);
+        auto before = mismatches;
+        for(auto const& shape : shapes) {
+            raster.Unclip();
+            raster.Clear(64 - 1);
+            raster.Clip(x, y, drak::Rasterizer::Width - 2 * x, drak::Rasterizer::Height - y);
+            if(mode == 0) {
+                raster.Tri(shape, 0);
+            } else {
+                raster.TexTri(shape, texture.data(), -1, mode == 2);
+            }
+            auto reference = triangleReference(shape);
+            for(int py = 0; py < drak::Rasterizer::Height; py++) {
+                for(int px = 0; px < drak::Rasterizer::Width; px++) {
+                    auto inside = px >= x && px < drak::Rasterizer::Width - x && py >= y;
+                    auto drawn = raster.Get(px, py) != 64 - 1;
+                    mismatches += drawn != (inside && reference[py * drak::Rasterizer::Width + px]);
+                    covered[py * drak::Rasterizer::Width + px] += drawn;
+                }
+            }
+        }
+        failed += mismatches != before;
+        overlaps += std::count_if(covered.begin(), covered.end(), [](int count) { return count > 1; }) != 0;
+    }
+
+    nowide::cout << triangles << " triangles and fans, " << failed << " with differences, " << mismatches << " pixels differ, "
+        << overlaps << " fans overlap\n";
+    return failed == 0 && overlaps == 0 ? 0 : 1;
+}
+
+// The same wavy (sawtooth), two-palette screen made by a scanline() callback, by filling the line
+// tables once per frame and by tables set up once, next to a cart without raster effects
+int benchScanline(drak::Arguments const& args) {
+    unsigned int frames = args.Count(0, 600);
+
+    char const* carts[][2] = {
+        { "plain", R"(
+global t = 0
+def update() { cls(1); rect(40, 40, 240, 160, 12); t += 1 }
+)" },
+        { "callback", R"(
+global t = 0
+def update() { cls(1); rect(40, 40, 240, 160, 12); t += 1 }
+def scanline(row) {
+  lineoffset(row, (row + t) % 16 - 8)
+  linepal(row, row < 120 ? 0 : 1)
+}
+)" },
+        { "tables", R"(
+global t = 0
+global offsets = []
+for(var row = 0; row < 240; ++row) { offsets.push_back(0) }
+linepal(120, 120, 1)
+def update() {
+  cls(1); rect(40, 40, 240, 160, 12)
+  for(var row = 0; row < 240; ++row) { offsets[row] = (row + t) % 16 - 8 }
+  lineoffset(0, offsets)
+  t += 1
+}
+)" },
+        { "static tables", R"(
+for(var row = 0; row < 240; ++row) { lineoffset(row, row % 16 - 8) }
+linepal(120, 120, 1)
+def update() { cls(1); rect(40, 40, 240, 160, 12) }
+)" },
+    };
+
+    nowide::cout << frames << " frames each, update and present\n";
+    for(auto const& cart : carts) {
+        drak::System sys;
+        auto elapsed = timeCart(sys, cart[1], frames, true);
+        nowide::cout << cart[0] << ": " << (elapsed * 1000.0 / frames) << " ms per frame\n";
+    }
+    return 0;
+}
+
+// A map page filling the screen under a rotating and zooming matrix, and under a per-row
+// perspective table rebuilt every frame, next to a cart that only clears the screen
+int benchMode7(drak::Arguments const& args) {
+    unsigned int frames = args.Count(0, 600);
+
+    auto setup = R"(
+target(0)
+for(var i = 0; i < 64; ++i) { rect((i % 32) * 8, (i / 32) * 8, 8, 8, i); circ((i % 32) * 8 + 4, (i / 32) * 8 + 4, 2, 63 - i) }
+target()
+for(var y = 0; y < 30; ++y) { for(var x = 0; x < 40; ++x) { mset(x, y, (x * 7 + y * 3) % 64) } }
+global t = 0
+)";
+    std::string carts[][2] = {
+        { "cls", R"(
+def update() { cls(0); t += 1 }
+)" },
+        { "matrix", R"(
+def update() {
+  // Rational rotation: s sweeps, cos = (1 - s^2) / (1 + s^2), sin = 2s / (1 + s^2)
+  var s = ((t % 200) - 100) / 100.0
+  var z = 0.5 + (t % 120) / 120.0
+  var c = z * (1.0 - s * s) / (1.0 + s * s)
+  var n = z * 2.0 * s / (1.0 + s * s)
+  mode7(0, c, -n, n, c, 160.0 - 160.0 * c + 120.0 * n, 120.0 - 160.0 * n - 120.0 * c)
+  t += 1
+}
+)" },
+        { "table", R"(
+global rows = []
+for(var i = 0; i < 960; ++i) { rows.push_back(0.0) }
+def update() {
+  for(var y = 0; y < 240; ++y) {
+    var scale = 32.0 / (y + 8)
+    rows[y * 4] = t - 160.0 * scale
+    rows[y * 4 + 1] = 4096.0 * scale + t
+    rows[y * 4 + 2] = scale
+    rows[y * 4 + 3] = 0.0
+  }
+  mode7(0, rows)
+  t += 1
+}
+)" },
+    };
+
+    nowide::cout << frames << " frames each, update and present\n";
+    for(auto const& cart : carts) {
+        drak::System sys;
+        auto elapsed = timeCart(sys, setup + cart[1], frames, true);
+        nowide::cout << cart[0] << ": " << (elapsed * 1000.0 / frames) << " ms per frame\n";
+    }
+    return 0;
+}
+
+// Compares random affine map draws (rotated, scaled, mirrored, far off the map, wrapping or
+// clamping, with skipped rows, a color key and clipping) pixel by pixel with the map pixel under
+// u + du * x, v + dv * x looked up from the cells; returns 1 if any pixel differs. The mappings
+// are multiples of 1/256, which the 16.16 stepping holds exactly.
+int testMode7(drak::Arguments const& args) {
+    unsigned int cases = args.Count(0, 2000);
+
+    namespace map = drak::map;
+    std::mt19937 random(1);
+    std::vector<std::vector<unsigned char>> pages(map::Pages, std::vector<unsigned char>(drak::Rasterizer::TextureSize * drak::Rasterizer::TextureSize));
+    std::array<unsigned char const*, map::Pages> sprites;
+    for(int i = 0; i < map::Pages; i++) {
+        for(auto & pixel : pages[i]) {
+            pixel = static_cast<unsigned char>(random() % 64);
+        }
+        sprites[i] = pages[i].data();
+    }
+    std::vector<unsigned char> cells(map::PageSize);
+    for(int y = 0; y < map::Height; y++) {
+        for(int x = 0; x < map::Width; x++) {
+            map::SetCell(cells.data(), x, y, static_cast<int>(random() % map::Sprites));
+        }
+    }
+
+    auto fraction = [&](int range) { return (static_cast<int>(random() % (2 * range * 256 + 1)) - range * 256) / 256.0; };
+
+    std::vector<unsigned char> screen(drak::Rasterizer::Bytes);
+    drak::Rasterizer raster(screen.data());
+    map::Affine affine;
+    std::array<map::AffineRow, drak::Rasterizer::Height> rows;
+    std::array<bool, drak::Rasterizer::Height> drawn;
+    unsigned long long mismatches = 0;
+    unsigned int failed = 0;
+    for(unsigned int i = 0; i < cases; i++) {
+        for(int change = 0; change < 8; change++) {
+            auto x = static_cast<int>(random() % map::Width);
+            auto y = static_cast<int>(random() % map::Height);
+            map::SetCell(cells.data(), x, y, static_cast<int>(random() % map::Sprites));
+        }
+        affine.Compose(cells.data(), sprites);
+
+        auto range = i % 8 == 0 ? 100000 : 1000;
+        for(int y = 0; y < drak::Rasterizer::Height; y++) {
+            rows[y].u = fraction(range);
+            rows[y].v = fraction(range);
+            rows[y].du = fraction(i % 4 == 0 ? 400 : 4);
+            rows[y].dv = fraction(i % 4 == 0 ? 400 : 4);
+            drawn[y] = random() % 8 != 0;
+        }
+        auto wrap = random() % 2 != 0;
+        auto key = random() % 2 ? static_cast<int>(random() % 64) : -1;
+        std::array<int, 4> clip = { static_cast<int>(random() % 60) - 20, static_cast<int>(random() % 60) - 20, static_cast<int>(random() % 400), static_cast<int>(random() % 300) };
+
+        raster.Unclip();
+        raster.Clear(64 - 1);
+        raster.Clip(clip[0], clip[1], clip[2], clip[3]);
+        affine.Draw(raster, [&](int y, map::AffineRow & mapping) {
+            mapping = rows[y];
+            return drawn[y];
+        }, wrap, key);
+
+        auto before = mismatches;
+        for(int y = 0; y < drak::Rasterizer::Height; y++) {
+            for(int x = 0; x < drak::Rasterizer::Width; x++) {
+                auto expected = 64 - 1;
+                if(drawn[y] && x >= clip[0] && y >= clip[1] && x < clip[0] + clip[2] && y < clip[1] + clip[3]) {
+                    auto mx = static_cast<std::int64_t>(std::floor(rows[y].u + rows[y].du * x));
+                    auto my = static_cast<std::int64_t>(std::floor(rows[y].v + rows[y].dv * x));
+                    if(wrap) {
+                        mx = (mx % map::PixelWidth + map::PixelWidth) % map::PixelWidth;
+                        my = (my % map::PixelHeight + map::PixelHeight) % map::PixelHeight;
+                    } else {
+                        mx = std::min<std::int64_t>(std::max<std::int64_t>(mx, 0), map::PixelWidth - 1);
+                        my = std::min<std::int64_t>(std::max<std::int64_t>(my, 0), map::PixelHeight - 1);
+                    }
+                    auto sprite = map::GetCell(cells.data(), static_cast<int>(mx / map::TileSize), static_cast<int>(my / map::TileSize));
+                    auto color = map::TileRow(sprites, sprite, static_cast<int>(my % map::TileSize))[mx % map::TileSize];
+                    expected = color == key ? 64 - 1 : color;
+                }
+                mismatches += raster.Get(x, y) != expected;
+            }
+        }
+        failed += mismatches != before;
+    }
+
+    nowide::cout << cases << " affine map draws, " << failed << " with differences, " << mismatches << " pixels differ\n";
+    return failed == 0 ? 0 : 1;
+}
+
+// 1 to 4 scrolling map layers (the front ones mostly transparent, the back one opaque) resolved in
+// one front to back pass, next to drawing them back to front in one pass per layer, with the
+// bytes each reads and writes per frame
+int benchParallax(drak::Arguments const& args) {
+    unsigned int frames = args.Count(0, 600);
+    constexpr int Layers = drak::map::Layers::MaxLayers;
+
+    // Sprite page l holds the tiles of layer l: transparent (0) except for a band that gets
+    // wider towards the back, where every pixel is opaque
+    std::vector<std::vector<unsigned char>> pages(drak::map::Pages, std::vector<unsigned char>(drak::Rasterizer::TextureSize * drak::Rasterizer::TextureSize));
+    std::array<unsigned char const*, drak::map::Pages> sprites;
+    std::mt19937 random(1);
+    for(int l = 0; l < drak::map::Pages; l++) {
+        for(int y = 0; y < drak::Rasterizer::TextureSize; y++) {
+            for(int x = 0; x < drak::Rasterizer::TextureSize; x++) {
+                auto opaque = l >= Layers - 1 || (y % drak::map::TileSize) < 2 * (l + 1);
+                pages[l][y * drak::Rasterizer::TextureSize + x] = static_cast<unsigned char>(opaque ? 1 + random() % 63 : 0);
+            }
+        }
+        sprites[l] = pages[l].data();
+    }
+    std::vector<std::vector<unsigned char>> cells(Layers, std::vector<unsigned char>(drak::map::PageSize));
+    for(int l = 0; l < Layers; l++) {
+        for(int y = 0; y < drak::map::Height; y++) {
+            for(int x = 0; x < drak::map::Width; x++) {
+                auto tiles = drak::map::PageTiles * drak::map::PageTiles;
+                drak::map::SetCell(cells[l].data(), x, y, l * tiles + static_cast<int>(random() % tiles));
+            }
+        }
+    }
+
+    std::vector<unsigned char> screen(drak::Rasterizer::Bytes);
+    drak::Rasterizer raster(screen.data());
+    drak::map::Layers layered;
+    drak::map::Affine affine;
+    auto pixels = double(drak::Rasterizer::Width * drak::Rasterizer::Height);
+
+    nowide::cout << frames << " frames each\n";
+    for(int count = 1; count <= Layers; count++) {
+        std::vector<drak::map::Layer> stack;
+        long long reads = 0;
+        auto elapsed = timeSeconds([&]() {
+            for(unsigned int frame = 0; frame < frames; frame++) {
+                stack.clear();
+                for(int l = 0; l < count; l++) {
+                    stack.push_back(drak::map::Layer{ cells[l].data(), static_cast<int>(frame) * (l + 1), static_cast<int>(frame) / (l + 1) });
+                }
+                raster.Clear(0);
+                reads += layered.Draw(raster, sprites, stack.begin(), stack.end(), 0);
+            }
+        });
+
+        auto passes = timeSeconds([&]() {
+            for(unsigned int frame = 0; frame < frames; frame++) {
+                raster.Clear(0);
+                for(int l = count - 1; l >= 0; l--) {
+                    affine.Compose(cells[l].data(), sprites);
+                    affine.Draw(raster, [&](int y, drak::map::AffineRow & row) {
+                        row = drak::map::AffineRow{ double(frame * (l + 1)), double(y + frame / (l + 1)), 1.0, 0.0 };
+                        return true;
+                    }, true, 0);
+                }
+            }
+        });
+
+        // One pass reads each layer's pixels until they're covered plus each layer's cells once,
+        // and writes the screen once; separate passes compose the page (reading its sprites and
+        // writing an image), then read the image and read and write the screen, per layer
+        auto cell_bytes = count * drak::map::Height * drak::map::Width * 2.0;
+        auto one_pass = reads / double(frames) + cell_bytes + pixels;
+        auto per_layer = count * (pixels * 2.0 + drak::map::PageSize + pixels * 2.0);
+        nowide::cout << count << " layers: one pass " << (elapsed * 1000.0 / frames) << " ms, "
+            << (one_pass / 1024.0) << " KiB per frame (" << (reads / double(frames) / pixels) << " layer reads per pixel); "
+            << "separate passes " << (passes * 1000.0 / frames) << " ms, " << (per_layer / 1024.0) << " KiB per frame\n";
+    }
+    return 0;
+}
+
+// Pixel at x, y of a stretched blit, worked out directly: the source pixel under the center of
+// the destination pixel (wrapping around the page), or -1 where nothing is drawn
+static int stretchReference(drak::Rasterizer & page, std::array<int, 12> const& c, int x, int y) {
+    int sx = c[0], sy = c[1], sw = c[2], sh = c[3], dx = c[4], dy = c[5], dw = c[6], dh = c[7];
+    if(x < dx || y < dy || x >= std::int64_t(dx) + dw || y >= std::int64_t(dy) + dh || x < c[10] || y < c[11]) {
+        return -1;
+    }
+    auto u = static_cast<int>((2 * (std::int64_t(x) - dx) + 1) * sw / (2 * std::int64_t(dw)));
+    auto v = static_cast<int>((2 * (std::int64_t(y) - dy) + 1) * sh / (2 * std::int64_t(dh)));
+    u = c[8] ? sw - 1 - u : u;
+    v = c[9] ? sh - 1 - v : v;
+    auto size = drak::Rasterizer::TextureSize;
+    return page.Get(static_cast<int>(((std::int64_t(sx) + u) % size + size) % size), static_cast<int>(((std::int64_t(sy) + v) % size + size) % size));
+}
+
+// Compares random stretched blits (any scale, exact 2x/3x/4x, flips, clipping, wrapping, a color
+// key, corners and sizes near the int limits) pixel by pixel with stretchReference; returns 1 if
+// any pixel differs
+int testStretch(drak::Arguments const& args) {
+    unsigned int cases = args.Count(0, 20000);
+
+    std::vector<unsigned char> texture(drak::Rasterizer::TextureSize * drak::Rasterizer::TextureSize * drak::Rasterizer::PixelBits / 8);
+    drak::Rasterizer page(texture.data(), drak::Rasterizer::TextureSize, drak::Rasterizer::TextureSize);
+    std::mt19937 random(1);
+    for(int y = 0; y < drak::Rasterizer::TextureSize; y++) {
+        for(int x = 0; x < drak::Rasterizer::TextureSize; x++) {
+            page.Pixel(x, y, static_cast<int>(random() % 64));
+        }
+    }
+
+    std::vector<unsigned char> screen(drak::Rasterizer::Bytes);
+    drak::Rasterizer raster(screen.data());
+    unsigned long long mismatches = 0;
+    unsigned int failed = 0;
+    for(unsigned int i = 0; i < cases; i++) {
+        auto sw = 1 + static_cast<int>(random() % (i % 4 == 0 ? 256 : 24));
+        auto sh = 1 + static_cast<int>(random() % (i % 4 == 0 ? 256 : 24));
+        auto scale = static_cast<int>(random() % 5);
+        auto dw = scale >= 2 ? sw * scale : 1 + static_cast<int>(random() % (i % 8 == 0 ? 2000 : 400));
+        auto dh = scale >= 2 ? sh * scale : 1 + static_cast<int>(random() % (i % 8 == 0 ? 2000 : 300));
+        std::array<int, 12> c = {
+            static_cast<int>(random() % 600) - 300, static_cast<int>(random() % 600) - 300, sw, sh,
+            static_cast<int>(random() % 400) - 40 - dw / 2, static_cast<int>(random() % 300) - 30 - dh / 2, dw, dh,
+            static_cast<int>(random() % 2), static_cast<int>(random() % 2),
+            static_cast<int>(random() % 40), static_cast<int>(random() % 40)
+        };
+        // Now and then, a destination reaching past the int range or a source far from the page
+        if(i % 16 == 1) {
+            c[6] = std::numeric_limits<int>::max() - static_cast<int>(random() % 1000);
+            c[4] = static_cast<int>(random() % 400) - 40;
+        }
+        if(i % 16 == 2) {
+            c[7] = std::numeric_limits<int>::max() - static_cast<int>(random() % 1000);
+            c[5] = static_cast<int>(random() % 300) - 30;
+        }
+        if(i % 16 == 3) {
+            c[0] = random() % 2 ? std::numeric_limits<int>::max() - static_cast<int>(random() % 300) : std::numeric_limits<int>::min() + static_cast<int>(random() % 300);
+            c[1] = random() % 2 ? std::numeric_limits<int>::max() - static_cast<int>(random() % 300) : std::numeric_limits<int>::min() + static_cast<int>(random() % 300);
+        }
+        auto key = random() % 2 ? static_cast<int>(random() % 64) : -1;
+
+        raster.Unclip();
+        raster.Clear(64 - 1);
+        raster.Clip(c[10], c[11], drak::Rasterizer::Width, drak::Rasterizer::Height);
+        raster.Stretch(page, c[0], c[1], sw, sh, c[4], c[5], c[6], c[7], c[8] != 0, c[9] != 0, key);
+
+        auto before = mismatches;
+        for(int y = 0; y < drak::Rasterizer::Height; y++) {
+            for(int x = 0; x < drak::Rasterizer::Width; x++) {
+                auto expected = stretchReference(page, c, x, y);
+                if(expected < 0 || expected == key) {
+                    expected = 64 - 1;
+                }
+                mismatches += raster.Get(x, y) != expected;
+            }
+        }
+        failed += mismatches != before;
+    }
+
+    nowide::cout << cases << " stretched blits, " << failed << " with differences, " << mismatches << " pixels differ\n";
+    return failed == 0 ? 0 : 1;
+}
+
+// Compares random copies from a page (clipped by the page and the clip rectangle, with a color
+// key, corners and sizes anywhere an int reaches) pixel by pixel with the page pixel at the same
+// offset from the corners; returns 1 if any pixel differs
+int testCopy(drak::Arguments const& args) {
+    unsigned int cases = args.Count(0, 10000);
+
+    std::vector<unsigned char> texture(drak::Rasterizer::TextureSize * drak::Rasterizer::TextureSize * drak::Rasterizer::PixelBits / 8);
+    drak::Rasterizer page(texture.data(), drak::Rasterizer::TextureSize, drak::Rasterizer::TextureSize);
+    std::mt19937 random(1);
+    for(int y = 0; y < drak::Rasterizer::TextureSize; y++) {
+        for(int x = 0; x < drak::Rasterizer::TextureSize; x++) {
+            page.Pixel(x, y, static_cast<int>(random() % 64));
+        }
+    }
+
+    std::vector<unsigned char> screen(drak::Rasterizer::Bytes);
+    drak::Rasterizer raster(screen.data());
+    unsigned long long mismatches = 0;
+    unsigned int failed = 0;
+    for(unsigned int i = 0; i < cases; i++) {
+        std::array<int, 6> c = {
+            testValue(random, -100, 300), testValue(random, -100, 300), testValue(random, -10, 400), testValue(random, -10, 300),
+            testValue(random, -100, 360), testValue(random, -100, 280)
+        };
+        std::array<int, 4> clip = { testValue(random, -20, 340), testValue(random, -20, 260), testValue(random, -20, 400), testValue(random, -20, 300) };
+        auto key = random() % 2 ? static_cast<int>(random() % 64) : -1;
+
+        raster.Unclip();
+        raster.Clear(64 - 1);
+        raster.Clip(clip[0], clip[1], clip[2], clip[3]);
+        raster.Copy(page, c[0], c[1], c[2], c[3], c[4], c[5], key);
+
+        auto left = std::min<std::int64_t>(std::max(clip[0], 0), drak::Rasterizer::Width);
+        auto top = std::min<std::int64_t>(std::max(clip[1], 0), drak::Rasterizer::Height);
+        auto right = std::min<std::int64_t>(std::int64_t(clip[0]) + std::max(clip[2], 0), drak::Rasterizer::Width);
+        auto bottom = std::min<std::int64_t>(std::int64_t(clip[1]) + std::max(clip[3], 0), drak::Rasterizer::Height);
+
+        auto before = mismatches;
+        for(int y = 0; y < drak::Rasterizer::Height; y++) {
+            for(int x = 0; x < drak::Rasterizer::Width; x++) {
+                auto u = std::int64_t(x) - c[4];
+                auto v = std::int64_t(y) - c[5];
+                auto px = c[0] + u;
+                auto py = c[1] + v;
+                auto expected = 64 - 1;
+                if(x >= left && x < right && y >= top && y < bottom && u >= 0 && v >= 0 && u < c[2] && v < c[3]
+                    && px >= 0 && py >= 0 && px < drak::Rasterizer::TextureSize && py < drak::Rasterizer::TextureSize) {
+                    auto color = page.Get(static_cast<int>(px), static_cast<int>(py));
+                    expected = color == key ? 64 - 1 : color;
+                }
+                mismatches += raster.Get(x, y) != expected;
+            }
+        }
+        failed += mismatches != before;
+    }
+
+    nowide::cout << cases << " copies, " << failed << " with differences, " << mismatches << " pixels differ\n";
+    return failed == 0 ? 0 : 1;
+}
+
+// Stretches 16x16 sprites at random places, at exactly 2x and 3x (repeated pixels) next to one
+// pixel less (column lookups), at 1.5x, and at 1x as a plain copy
+int benchStretch(drak::Arguments const& args) {
+    unsigned int frames = args.Count(0, 600);
+    unsigned int sprites = args.Count(1, 1000);
+
+    std::vector<unsigned char> texture(drak::Rasterizer::TextureSize * drak::Rasterizer::TextureSize * drak::Rasterizer::PixelBits / 8);
+    drak::Rasterizer page(texture.data(), drak::Rasterizer::TextureSize, drak::Rasterizer::TextureSize);
+    std::mt19937 random(1);
+    for(int y = 0; y < drak::Rasterizer::TextureSize; y++) {
+        for(int x = 0; x < drak::Rasterizer::TextureSize; x++) {
+            page.Pixel(x, y, static_cast<int>(random() % 64));
+        }
+    }
+    std::vector<std::array<int, 4>> places(sprites);
+    for(auto & place : places) {
+        place = { static_cast<int>(random() % 16) * 16, static_cast<int>(random() % 16) * 16, static_cast<int>(random() % 360) - 40, static_cast<int>(random() % 280) - 40 };
+    }
+
+    std::vector<unsigned char> screen(drak::Rasterizer::Bytes);
+    drak::Rasterizer raster(screen.data());
+    int sizes[] = { 32, 31, 48, 47, 24, 16 };
+    nowide::cout << frames << " frames of " << sprites << " sprites\n";
+    for(auto size : sizes) {
+        auto elapsed = timeSeconds([&]() {
+            for(unsigned int frame = 0; frame < frames; frame++) {
+                raster.Clear(0);
+                for(auto const& p : places) {
+                    raster.Stretch(page, p[0], p[1], 16, 16, p[2], p[3], size, size, (frame & 1) != 0, false, 0);
+                }
+            }
+        });
+        nowide::cout << "16x16 to " << size << "x" << size << ": " << (elapsed * 1000.0 / frames) << " ms per frame, "
+            << (frames * double(sprites) * size * size / elapsed / 1e6) << " million pixels per second\n";
+    }
+    return 0;
+}
+
+// 64 bouncing boxes swept against a walled map with scattered blocks, and 64 rays cast across it,
+// with sweep and raycast next to the same algorithms written in script over mget and fget. The
+// checksum of the results should match.
+int benchCollision(drak::Arguments const& args) {
+    unsigned int frames = args.Count(0, 300);
+
+    auto setup = R"(
+fset(1, 0, true)
+global seed = 12345
+def rnd(n) { seed = (seed * 1103515245 + 12345) % 2147483648; return (seed / 65536) % n }
+for(var y = 0; y < 30; ++y) { for(var x = 0; x < 40; ++x) {
+  mset(x, y, x == 0 || y == 0 || x == 39 || y == 29 || rnd(8) == 0 ? 1 : 0)
+} }
+global bodies = []
+for(var i = 0; i < 64; ++i) {
+  var x = 8.0 + rnd(300); var y = 8.0 + rnd(220)
+  while(sweep(x, y, 6.0, 6.0, 0.0, 0.0)[2] != 0 || fget(mget(int(x / 8), int(y / 8))) != 0 || fget(mget(int((x + 5) / 8), int((y + 5) / 8))) != 0) { x = 8.0 + rnd(300); y = 8.0 + rnd(220) }
+  bodies.push_back([x, y, rnd(7) - 3.0 + 0.5, rnd(7) - 3.0 + 0.25])
+}
+global checksum = 0.0
+global t = 0
+def solid(cx, cy) { return cx >= 0 && cy >= 0 && cx < 40 && cy < 30 && (fget(mget(cx, cy)) & 1) != 0 }
+def move(p, q, size, other, d, lines, horizontal) {
+  var top = int(other / 8); var bottom = int((other + 6.0 + 7.99999) / 8) - 1
+  if(d > 0) {
+    var first = int((p + size + 7.99999) / 8); var last = int((p + size + d + 7.99999) / 8) - 1
+    for(var c = first; c <= last; ++c) { for(var r = top; r <= bottom; ++r) {
+      if(horizontal ? solid(c, r) : solid(r, c)) { return [c * 8.0 - size, 1] }
+    } }
+  } else if(d < 0) {
+    var first = int(p / 8) - 1; var last = int((p + d) / 8)
+    for(var c = first; c >= last; --c) { for(var r = top; r <= bottom; ++r) {
+      if(horizontal ? solid(c, r) : solid(r, c)) { return [(c + 1) * 8.0, 1] }
+    } }
+  }
+  return [p + d, 0]
+}
+def script_sweep(x, y, dx, dy) {
+  var mx = move(x, y, 6.0, y, dx, 40, true)
+  var my = move(y, mx[0], 6.0, mx[0], dy, 30, false)
+  return [mx[0], my[0], (mx[1] == 1 ? (dx > 0 ? 2 : 1) : 0) + (my[1] == 1 ? (dy > 0 ? 8 : 4) : 0)]
+}
+def script_raycast(x0, y0, x1, y1) {
+  var dx = x1 - x0; var dy = y1 - y0
+  var cx = int(x0 / 8); var cy = int(y0 / 8)
+  var sx = dx > 0 ? 1 : -1; var sy = dy > 0 ? 1 : -1
+  var nx = 1e30; var ny = 1e30; var ddx = 1e30; var ddy = 1e30
+  if(dx > 0) { nx = ((cx + 1) * 8 - x0) / dx; ddx = 8.0 / dx }
+  if(dx < 0) { nx = (cx * 8 - x0) / dx; ddx = -8.0 / dx }
+  if(dy > 0) { ny = ((cy + 1) * 8 - y0) / dy; ddy = 8.0 / dy }
+  if(dy < 0) { ny = (cy * 8 - y0) / dy; ddy = -8.0 / dy }
+  var t = 0.0
+  while(true) {
+    if(solid(cx, cy)) { return [x0 + dx * t, y0 + dy * t, cx, cy] }
+    if(nx < ny) { if(nx > 1.0) { return [] }; t = nx; cx += sx; nx += ddx }
+    else { if(ny > 1.0) { return [] }; t = ny; cy += sy; ny += ddy }
+  }
+}
+)";
+    std::string carts[][2] = {
+        { "native", R"(
+def update() {
+  for(var i = 0; i < 64; ++i) {
+    var b = bodies[i]
+    var r = sweep(b[0], b[1], 6.0, 6.0, b[2], b[3])
+    if((r[2] & 3) != 0) { b[2] = -b[2] }
+    if((r[2] & 12) != 0) { b[3] = -b[3] }
+    b[0] = r[0]; b[1] = r[1]
+    checksum += r[0] + r[1]
+    var hit = raycast(160.0, 120.0, 160.0 + (i - 32) * 10.0 + t % 7, 120.0 + (i % 8 - 4) * 40.0)
+    if(hit.size() > 0) { checksum += hit[0] + hit[1] }
+  }
+  t += 1
+}
+)" },
+        { "script", R"(
+def update() {
+  for(var i = 0; i < 64; ++i) {
+    var b = bodies[i]
+    var r = script_sweep(b[0], b[1], b[2], b[3])
+    if((r[2] & 3) != 0) { b[2] = -b[2] }
+    if((r[2] & 12) != 0) { b[3] = -b[3] }
+    b[0] = r[0]; b[1] = r[1]
+    checksum += r[0] + r[1]
+    var hit = script_raycast(160.0, 120.0, 160.0 + (i - 32) * 10.0 + t % 7, 120.0 + (i % 8 - 4) * 40.0)
+    if(hit.size() > 0) { checksum += hit[0] + hit[1] }
+  }
+  t += 1
+}
+)" },
+    };
+
+    nowide::cout << frames << " frames each, 64 sweeps and 64 raycasts per frame\n";
+    for(auto const& cart : carts) {
+        drak::System sys;
+        auto elapsed = timeCart(sys, setup + cart[1], frames, false);
+        nowide::cout << cart[0] << ": " << (elapsed * 1000.0 / frames) << " ms per frame, checksum "
+            << std::fixed << sys.ScriptEngine().eval<double>("checksum") << std::defaultfloat << "\n";
+    }
+    return 0;
+}
+
+// Paths between random open cells of a 40x30 map with a quarter of its cells blocked: searched
+// through path(), directly, on the worker threads pathasync uses (one and all of them), and a few
+// with A* written in script over mget and fget, the way carts did it. Also times flow fields.
+int benchPath(drak::Arguments const& args) {
+    int paths = args.Count(0, 2000);
+    int scripted = std::min(paths, 50);
+
+    std::mt19937 random(7);
+    drak::path::Blocked blocked;
+    std::string setup = "fset(1, 0, true)\n";
+    for(int y = 0; y < drak::map::Height; y++) {
+        for(int x = 0; x < drak::map::Width; x++) {
+            blocked[y * drak::map::Width + x] = random() % 4 == 0;
+            setup += "mset(" + std::to_string(x) + ", " + std::to_string(y) + ", " + std::to_string(blocked[y * drak::map::Width + x]) + ")\n";
+        }
+    }
+    std::vector<int> open;
+    for(int cell = 0; cell < drak::path::Cells; cell++) {
+        if(!blocked[cell]) {
+            open.push_back(cell);
+        }
+    }
+    std::vector<int> pairs;
+    setup += "global pairs = [";
+    for(int i = 0; i < paths * 2; i++) {
+        pairs.push_back(open[random() % open.size()]);
+        setup += (i ? ", " : "") + std::to_string(pairs.back() % drak::map::Width) + ", " + std::to_string(pairs.back() / drak::map::Width);
+    }
+    setup += R"(]
+def iabs(v) { return v < 0 ? -v : v }
+def relax(n, nx, ny, cost, g, closed, open) {
+  if(nx >= 0 && ny >= 0 && nx < 40 && ny < 30 && !closed[n] && (fget(mget(nx, ny)) & 1) == 0 && cost < g[n]) {
+    g[n] = cost
+    open.push_back(n)
+  }
+}
+def astar(x0, y0, x1, y1) {
+  var g = []
+  var closed = []
+  for(var i = 0; i < 1200; ++i) { g.push_back(100000); closed.push_back(false) }
+  var open = [y0 * 40 + x0]
+  g[y0 * 40 + x0] = 0
+  while(open.size() > 0) {
+    var best = 0
+    var best_f = 1000000
+    for(var i = 0; i < open.size(); ++i) {
+      var f = g[open[i]] + iabs(open[i] % 40 - x1) + iabs(open[i] / 40 - y1)
+      if(f < best_f) { best_f = f; best = i }
+    }
+    var c = open[best]
+    open.erase_at(best)
+    if(c == y1 * 40 + x1) { return g[c] }
+    if(!closed[c]) {
+      closed[c] = true
+      var x = c % 40
+      var y = c / 40
+      relax(c - 1, x - 1, y, g[c] + 1, g, closed, open)
+      relax(c + 1, x + 1, y, g[c] + 1, g, closed, open)
+      relax(c - 40, x, y - 1, g[c] + 1, g, closed, open)
+      relax(c + 40, x, y + 1, g[c] + 1, g, closed, open)
+    }
+  }
+  return -1
+}
+def native(n) {
+  var steps = 0
+  for(var i = 0; i < n; ++i) { steps += path(pairs[i * 4], pairs[i * 4 + 1], pairs[i * 4 + 2], pairs[i * 4 + 3]).size() / 2 - 1 }
+  return steps
+}
+def scripted(n) {
+  var steps = 0
+  for(var i = 0; i < n; ++i) { steps += astar(pairs[i * 4], pairs[i * 4 + 1], pairs[i * 4 + 2], pairs[i * 4 + 3]) }
+  return steps
+}
+)";
+
+    drak::System sys;
+    sys.SetLog(nullptr);
+    auto & chai = sys.ScriptEngine();
+    chai.eval(setup);
+
+    auto report = [](char const* name, int count, double seconds) {
+        nowide::cout << name << ": " << (count / seconds) << " paths/s (" << (seconds * 1e6 / count) << " us each)\n";
+    };
+
+    nowide::cout << paths << " paths, " << open.size() << " open cells of " << drak::path::Cells << "\n";
+
+    report("path()", paths, timeSeconds([&]() { chai.eval("native(" + std::to_string(paths) + ")"); }));
+
+    drak::path::Finder finder;
+    std::vector<std::int16_t> cells;
+    report("Finder", paths, timeSeconds([&]() {
+        for(int i = 0; i < paths; i++) {
+            finder.Find(blocked, pairs[i * 2] % drak::map::Width, pairs[i * 2] / drak::map::Width, pairs[i * 2 + 1] % drak::map::Width, pairs[i * 2 + 1] / drak::map::Width, cells);
+        }
+    }));
+
+    auto shared = std::make_shared<drak::path::Blocked const>(blocked);
+    for(unsigned int workers : { 1u, std::thread::hardware_concurrency() }) {
+        drak::path::Queue queue(workers);
+        auto seconds = timeSeconds([&]() {
+            for(int i = 0; i < paths; i++) {
+                queue.Add(shared, pairs[i * 2] % drak::map::Width, pairs[i * 2] / drak::map::Width, pairs[i * 2 + 1] % drak::map::Width, pairs[i * 2 + 1] / drak::map::Width);
+            }
+            queue.Start();
+            queue.Collect();
+        });
+        auto name = "Queue, " + std::to_string(std::max(1u, std::min(workers, 4u))) + " workers";
+        report(name.c_str(), paths, seconds);
+    }
+
+    int script_steps = 0;
+    auto native_steps = chai.eval<int>("native(" + std::to_string(scripted) + ")");
+    // Unreachable pairs count as -1 steps both ways
+    report("script A*", scripted, timeSeconds([&]() { script_steps = chai.eval<int>("scripted(" + std::to_string(scripted) + ")"); }));
+    nowide::cout << "steps over the first " << scripted << " paths: " << native_steps << " native, " << script_steps << " script\n";
+
+    drak::path::FlowField field;
+    auto seconds = timeSeconds([&]() {
+        for(int i = 0; i < paths; i++) {
+            field.Build(blocked, pairs[i * 2] % drak::map::Width, pairs[i * 2] / drak::map::Width);
+        }
+    });
+    nowide::cout << "flow field: " << (seconds * 1e6 / paths) << " us each\n";
+    return 0;
+}
+
+// A cart keeping particles alive across 4 emitters under gravity and drag, clearing the screen and
+// drawing them every frame, next to the same effect written in script (with fewer particles)
+// keeping them in Vectors and drawing with pix.
+int benchParticles(drak::Arguments const& args) {
+    int count = args.Count(0, 50000);
+    unsigned int frames = args.Count(1, 120);
+    int scripted = std::min(count, 2000);
+
+    std::string native = R"(
+for(var e = 0; e < 4; ++e) {
+  pemit(e, 40.0 + e * 80.0, 120.0, 0.0)
+  pmotion(e, -1.5708, 3.0, 0.5, 2.5)
+  pforce(e, 0.0, 0.02, 0.995)
+  plife(e, 1000000.0, 1000000.0)
+  pramp(e, [7, 8, 9, 10])
+  pburst(e, COUNT / 4)
+}
+def update() {
+  cls(0)
+  pdraw()
+}
+)";
+    native.replace(native.find("COUNT"), 5, std::to_string(count));
+
+    std::string script = R"(
+global xs = []
+global ys = []
+global vxs = []
+global vys = []
+global seed = 12345
+def rnd() { seed = (seed * 1103515245 + 12345) % 2147483648; return (seed / 65536 % 1000) / 1000.0 }
+for(var i = 0; i < COUNT; ++i) {
+  xs.push_back(40.0 + (i % 4) * 80.0)
+  ys.push_back(120.0)
+  vxs.push_back(rnd() * 4.0 - 2.0)
+  vys.push_back(-rnd() * 2.5)
+}
+def update() {
+  cls(0)
+  for(var i = 0; i < COUNT; ++i) {
+    vxs[i] = vxs[i] * 0.995
+    vys[i] = vys[i] * 0.995 + 0.02
+    xs[i] += vxs[i]
+    ys[i] += vys[i]
+    pix(int(xs[i]), int(ys[i]), 8)
+  }
+}
+)";
+    while(script.find("COUNT") != std::string::npos) {
+        script.replace(script.find("COUNT"), 5, std::to_string(scripted));
+    }
+
+    std::pair<std::string, int> carts[] = { { native, count }, { script, scripted } };
+    char const* names[] = { "native", "script" };
+    for(int i = 0; i < 2; i++) {
+        drak::System sys;
+        auto elapsed = timeCart(sys, carts[i].first, frames, false);
+        auto ms = elapsed * 1000.0 / frames;
+        nowide::cout << names[i] << ": " << carts[i].second << " particles, " << ms << " ms per frame, "
+            << (ms * 1e6 / carts[i].second) << " ns per particle\n";
+    }
+    return 0;
+}
+
+// A star field moved and drawn every frame with the stars in Vectors and drawn with pix, in
+// buffers read and written with get and set, and in buffers drawn with one plot call; then only
+// the drawing, pix over Vectors against plot.
+int benchBuffer(drak::Arguments const& args) {
+    int stars = args.Count(0, 1000);
+    unsigned int frames = args.Count(1, 60);
+
+    auto setup = R"(
+global seed = 12345
+def rnd(n) { seed = (seed * 1103515245 + 12345) % 2147483648; return (seed / 65536) % n }
+global vx = []
+global vy = []
+global vs = []
+for(var i = 0; i < STARS; ++i) { vx.push_back(rnd(320)); vy.push_back(rnd(240)); vs.push_back(1 + rnd(3)) }
+global bx = buffer("int16", vx)
+global by = buffer("int16", vy)
+global bs = buffer("int8", vs)
+)";
+    std::pair<char const*, char const*> carts[] = {
+        { "Vector, pix", R"(
+def update() {
+  cls(0)
+  for(var i = 0; i < STARS; ++i) {
+    var x = vx[i] + vs[i]
+    if(x >= 320) { x -= 320 }
+    vx[i] = x
+    pix(x, vy[i], 7)
+  }
+}
+)" },
+        { "buffer, pix", R"(
+def update() {
+  cls(0)
+  for(var i = 0; i < STARS; ++i) {
+    var x = bx.get(i) + bs.get(i)
+    if(x >= 320) { x -= 320 }
+    bx.set(i, x)
+    pix(x, by.get(i), 7)
+  }
+}
+)" },
+        { "buffer, plot", R"(
+def update() {
+  cls(0)
+  for(var i = 0; i < STARS; ++i) {
+    var x = bx.get(i) + bs.get(i)
+    if(x >= 320) { x -= 320 }
+    bx.set(i, x)
+  }
+  plot(bx, by, 7)
+}
+)" },
+        { "draw only, pix", R"(
+def update() {
+  cls(0)
+  for(var i = 0; i < STARS; ++i) { pix(vx[i], vy[i], 7) }
+}
+)" },
+        { "draw only, plot", R"(
+def update() {
+  cls(0)
+  plot(bx, by, 7)
+}
+)" },
+    };
+
+    auto expand = [stars](std::string source) {
+        for(auto at = source.find("STARS"); at != std::string::npos; at = source.find("STARS")) {
+            source.replace(at, 5, std::to_string(stars));
+        }
+        return source;
+    };
+
+    nowide::cout << stars << " stars, " << frames << " frames each\n";
+    for(auto const& cart : carts) {
+        drak::System sys;
+        auto elapsed = timeCart(sys, expand(setup) + expand(cart.second), frames, false);
+        nowide::cout << cart.first << ": " << (elapsed * 1000.0 / frames) << " ms per frame\n";
+    }
+    return 0;
+}
+
+// Errors of the fixed point trig and square root against the C library over their whole input
+// ranges, a checksum of their results that should be the same on every machine, and timings
+// from script: fsin against a sine written in script, and turning points with vrot one at a
+// time against bufrot over buffers.
+int benchMath(drak::Arguments const& args) {
+    int points = args.Count(0, 1000);
+    namespace math = drak::math;
+
+    double sin_error = 0.0;
+    double atan_error = 0.0;
+    double sqrt_error = 0.0;
+    std::uint32_t checksum = 2166136261u;
+    auto mix = [&checksum](std::int32_t value) {
+        for(int i = 0; i < 4; i++) {
+            checksum = (checksum ^ ((static_cast<std::uint32_t>(value) >> (i * 8)) & 255)) * 16777619u;
+        }
+    };
+    auto const turn = 6.283185307179586;
+    for(int angle = 0; angle < 65536; angle++) {
+        sin_error = std::max(sin_error, std::abs(math::Sin(angle) / 65536.0 - std::sin(angle * turn / 65536)));
+        sin_error = std::max(sin_error, std::abs(math::Cos(angle) / 65536.0 - std::cos(angle * turn / 65536)));
+        mix(math::Sin(angle));
+        mix(math::Cos(angle));
+    }
+    for(int y = -300; y <= 300; y += 3) {
+        for(int x = -300; x <= 300; x += 3) {
+            auto angle = math::Atan2(y * 65536, x * 65536);
+            auto error = std::abs(angle * turn / 65536 - std::atan2(y, x));
+            atan_error = std::max(atan_error, std::min(error, turn - error));
+            mix(angle);
+            mix(math::Length(x * 65536, y * 65536));
+        }
+    }
+    for(std::int64_t a = 1; a < (std::int64_t(1) << 31); a = a * 5 / 4 + 1) {
+        auto root = math::Sqrt(static_cast<std::int32_t>(a));
+        sqrt_error = std::max(sqrt_error, std::abs(root / 65536.0 - std::sqrt(a / 65536.0)));
+        mix(root);
+    }
+    nowide::cout << "max error: sin/cos " << sin_error << ", atan2 " << atan_error << " rad, sqrt " << sqrt_error << "\n";
+    nowide::cout << "checksum " << std::hex << checksum << std::dec << "\n";
+
+    std::string setup = R"(
+def ssin(angle) {
+  var x = angle
+  while(x > 3.14159265) { x -= 6.28318531 }
+  while(x < -3.14159265) { x += 6.28318531 }
+  var x2 = x * x
+  return x * (1.0 - x2 / 6.0 * (1.0 - x2 / 20.0 * (1.0 - x2 / 42.0 * (1.0 - x2 / 72.0))))
+}
+def script_sin(n) { var s = 0.0; for(var i = 0; i < n; ++i) { s += ssin(i * 0.001) } }
+def native_sin(n) { var s = 0; for(var i = 0; i < n; ++i) { s += fsin(i * 10) } }
+global xs = buffer("fixed", POINTS)
+global ys = buffer("fixed", POINTS)
+for(var i = 0; i < POINTS; ++i) { xs.set(i, fmul(fix(100.0), fcos(i * 64))); ys.set(i, fmul(fix(100.0), fsin(i * 64))) }
+def one_by_one(n) {
+  for(var i = 0; i < n; ++i) {
+    var p = vrot(xs.get(i), ys.get(i), 100)
+    xs.set(i, p[0])
+    ys.set(i, p[1])
+  }
+}
+)";
+    setup.replace(setup.find("POINTS"), 6, std::to_string(points));
+    setup.replace(setup.find("POINTS"), 6, std::to_string(points));
+    setup.replace(setup.find("POINTS"), 6, std::to_string(points));
+
+    drak::System sys;
+    sys.SetLog(nullptr);
+    auto & chai = sys.ScriptEngine();
+    chai.eval(setup);
+
+    auto time = [&chai](std::string const& code, int repeat) {
+        return timeSeconds([&]() {
+            for(int i = 0; i < repeat; i++) {
+                chai.eval(code);
+            }
+        }) / repeat;
+    };
+    auto calls = 10000;
+    nowide::cout << "sine from script: " << (time("script_sin(" + std::to_string(calls) + ")", 5) * 1e9 / calls) << " ns per call in script, "
+        << (time("native_sin(" + std::to_string(calls) + ")", 5) * 1e9 / calls) << " ns per fsin\n";
+    nowide::cout << "turning " << points << " points: " << (time("one_by_one(" + std::to_string(points) + ")", 5) * 1e3) << " ms with vrot, "
+        << (time("bufrot(xs, ys, 100, 0, 0)", 100) * 1e3) << " ms with bufrot\n";
+    return 0;
+}
+
+// The same carts with ChaiScript's operator expressions run on the bytecode VM and on the tree
+// walker: a plasma backdrop worked out per pixel and drawn with pix, and rects bouncing off the
+// screen edges. Returns 1 if the two leave different pictures or script state.
+int benchBytecode(drak::Arguments const& args) {
+    unsigned int frames = args.Count(0, 60);
+
+    std::pair<char const*, char const*> carts[] = {
+        { "plasma", R"(
+global t = 0
+global sum = 0
+def update() {
+  for(var y = 0; y < 48; ++y) {
+    for(var x = 0; x < 64; ++x) {
+      var c = (x * x + y * y + t * 7) / 16 + (x ^ y) % 13 - (x & 7) * 3
+      var v = x * 0.25 + y * 0.5 - t * 1.5 + c * 0.125
+      if(c % 64 < 32 && v * 2.0 > x - y) { sum += c % 64 } else { sum -= (c >> 2) & 15 }
+      pix(x * 5, y * 5, (c + t) & 63)
+    }
+  }
+  t += 1
+}
+)" },
+        { "rects", R"(
+global xs = []
+global ys = []
+global dxs = []
+global dys = []
+for(var i = 0; i < 200; ++i) { xs.push_back((i * 37) % 300); ys.push_back((i * 91) % 220); dxs.push_back(1 + i % 3); dys.push_back(2 - i % 5) }
+global sum = 0
+def update() {
+  cls(0)
+  for(var i = 0; i < 200; ++i) {
+    var x = xs[i] + dxs[i]
+    var y = ys[i] + dys[i]
+    if(x < 0 || x > 320 - 8) { dxs[i] = -dxs[i]; x = xs[i] + dxs[i] }
+    if(y < 0 || y > 240 - 8) { dys[i] = -dys[i]; y = ys[i] + dys[i] }
+    xs[i] = x
+    ys[i] = y
+    sum += x * 3 + y
+    rect(x, y, 8, 8, 1 + i % 62)
+  }
+}
+)" },
+    };
+
+    nowide::cout << frames << " frames each\n";
+    auto failed = false;
+    for(auto const& cart : carts) {
+        std::vector<std::uint32_t> pictures[2];
+        std::string sums[2];
+        double elapsed[2];
+        for(int tier = 0; tier < 2; tier++) {
+            drak::System sys;
+            sys.ScriptEngine().set_bytecode_enabled(tier == 0);
+            elapsed[tier] = timeCart(sys, cart.second, frames, false);
+            pictures[tier].resize(drak::display::Width * drak::display::Height);
+            sys.Present(pictures[tier].data());
+            sums[tier] = sys.ScriptEngine().eval<std::string>("to_string(sum)");
+        }
+        auto same = pictures[0] == pictures[1] && sums[0] == sums[1];
+        failed |= !same;
+        nowide::cout << cart.first << ": bytecode " << (elapsed[0] * 1000.0 / frames) << " ms per frame, tree walker "
+            << (elapsed[1] * 1000.0 / frames) << " ms per frame" << (same ? "" : ", RESULTS DIFFER") << "\n";
+    }
+    return failed ? 1 : 0;
+}
+
+struct Tool {
+    char const* name;
+    char const* usage;
+    int (*run)(drak::Arguments const& args);
+};
+
+Tool const tools[] = {
+    { "--audio-bench", "[seconds]", benchAudio },
+    { "--raster-bench", "[frames] [primitives]", benchRaster },
+    { "--raster-test", "[scenes]", testRaster },
+    { "--shadow-test", "[operations]", testShadow },
+    { "--tri-bench", "[frames] [triangles]", benchTriangles },
+    { "--tri-test", "[triangles]", testTriangles },
+    { "--scanline-bench", "[frames]", benchScanline },
+    { "--mode7-bench", "[frames]", benchMode7 },
+    { "--mode7-test", "[cases]", testMode7 },
+    { "--parallax-bench", "[frames]", benchParallax },
+    { "--sspr-test", "[cases]", testStretch },
+    { "--copy-test", "[cases]", testCopy },
+    { "--sspr-bench", "[frames] [sprites]", benchStretch },
+    { "--collision-bench", "[frames]", benchCollision },
+    { "--path-bench", "[paths]", benchPath },
+    { "--particles-bench", "[particles] [frames]", benchParticles },
+    { "--buffer-bench", "[stars] [frames]", benchBuffer },
+    { "--math-bench", "[points]", benchMath },
+    { "--bytecode-bench", "[frames]", benchBytecode },
+};
+
+}
+
+namespace drak {
+namespace bench {
+
+    bool Run(int argc, char * argv[], int & status) {
+        if(argc < 2) {
+            return false;
+        }
+        for(auto const& tool : tools) {
+            if(std::string(argv[1]) == tool.name) {
+                status = drak::RunMode(argc, argv, tool.usage, tool.run);
+                return true;
+            }
+        }
+        return false;
+    }
+
+}
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+namespace drak {
+namespace bench {
+
+    // Runs the benchmark or reference test named by argv[1] (like --raster-bench) with the
+    // arguments after it, and sets status to its exit code. Returns false if there's none by
+    // that name.
+    bool Run(int argc, char * argv[], int & status);
+
+}
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <limits>
+#include <memory>
+
+namespace drak {
+
+    enum class BlendMode : unsigned char {
+        None,
+        Average,    // (source + dest) / 2
+        Add,        // source + dest, saturating
+        Multiply,   // source * dest
+        Subtract,   // dest - source, saturating
+    };
+
+    // For every blend mode and pair of palette indices, the palette index nearest to the blended
+    // color, so blending while drawing is one table lookup per pixel
+    struct BlendTables {
+        static constexpr int Colors = 64;
+        static constexpr int PaletteSize = Colors * 3;
+        static constexpr int Modes = 4;
+
+        using Table = std::array<unsigned char, Colors * Colors>;
+
+        std::array<unsigned char, PaletteSize> palette;
+        std::array<Table, Modes> tables;
+
+        // Entry source * Colors + dest, or nullptr for BlendMode::None
+        unsigned char const* Get(BlendMode mode) const {
+            return mode == BlendMode::None ? nullptr : tables[static_cast<int>(mode) - 1].data();
+        }
+
+        // palette is Colors r, g, b triples
+        static std::shared_ptr<BlendTables const> Build(unsigned char const* palette) {
+            auto result = std::make_shared<BlendTables>();
+            std::memcpy(result->palette.data(), palette, PaletteSize);
+
+            auto nearest = [palette](int r, int g, int b) {
+                int best = 0;
+                int best_distance = std::numeric_limits<int>::max();
+                for(int color = 0; color < Colors; color++) {
+                    auto dr = r - palette[color * 3];
+                    auto dg = g - palette[color * 3 + 1];
+                    auto db = b - palette[color * 3 + 2];
+                    auto distance = dr * dr + dg * dg + db * db;
+                    if(distance < best_distance) {
+                        best = color;
+                        best_distance = distance;
+                    }
+                }
+                return static_cast<unsigned char>(best);
+            };
+
+            for(int source = 0; source < Colors; source++) {
+                auto s = palette + source * 3;
+                for(int dest = 0; dest < Colors; dest++) {
+                    auto d = palette + dest * 3;
+                    auto entry = source * Colors + dest;
+                    result->tables[0][entry] = nearest((s[0] + d[0]) / 2, (s[1] + d[1]) / 2, (s[2] + d[2]) / 2);
+                    result->tables[1][entry] = nearest(std::min(s[0] + d[0], 255), std::min(s[1] + d[1], 255), std::min(s[2] + d[2], 255));
+                    result->tables[2][entry] = nearest(s[0] * d[0] / 255, s[1] * d[1] / 255, s[2] * d[2] / 255);
+                    result->tables[3][entry] = nearest(std::max(d[0] - s[0], 0), std::max(d[1] - s[1], 0), std::max(d[2] - s[2], 0));
+                }
+            }
+            return result;
+        }
+    };
+
+    // Keeps blend tables in step with a palette that may change. Rebuilding takes a while, so it
+    // runs on another thread and the old tables stay in use until the new ones are ready.
+    class BlendCache {
+        std::shared_ptr<BlendTables const> _current;
+        std::future<std::shared_ptr<BlendTables const>> _pending;
+        std::array<unsigned char, BlendTables::PaletteSize> _requested;
+
+    public:
+        explicit BlendCache(std::shared_ptr<BlendTables const> initial)
+            : _current{std::move(initial)}, _requested(_current->palette) { }
+
+        BlendTables const& Current() const {
+            return *_current;
+        }
+
+        // Call once per frame with the palette. Returns true when newer tables were adopted (tables
+        // from Current() are valid until then).
+        bool Update(unsigned char const* palette) {
+            auto adopted = false;
+            if(_pending.valid() && _pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                _current = _pending.get();
+                adopted = true;
+            }
+            if(!_pending.valid() && std::memcmp(_requested.data(), palette, BlendTables::PaletteSize) != 0) {
+                std::memcpy(_requested.data(), palette, BlendTables::PaletteSize);
+                _pending = std::async(std::launch::async, [colors = _requested]() { return BlendTables::Build(colors.data()); });
+            }
+            return adopted;
+        }
+    };
+
+}
@@ -0,0 +1,302 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace drak {
+
+    enum class ElementType : unsigned char {
+        Int8,
+        Int16,
+        Int32,
+        Fixed,  // 16.16 fixed point in 32 bits
+        Float,
+    };
+
+    // A typed array for scripts, holding its elements packed (little endian) instead of as one
+    // boxed value each. It either owns its elements or views a region of console memory.
+    //
+    // Scripts gain from buffers in the bulk and draw calls (fill, copy, plot, mode7, the buf*
+    // math), not element by element: get boxes a new value on every call, which makes a loop of
+    // get and set somewhat slower than the same loop indexing a Vector.
+    class Buffer {
+    public:
+        // For views: called with the address and size of the console memory about to be accessed
+        // (write false), and again with write true once it was written
+        using Access = std::function<void(unsigned int address, unsigned int size, bool write)>;
+
+    private:
+        ElementType _type;
+        int _size;
+        std::vector<unsigned char> _storage;
+        unsigned char * _data;
+        // Views only, what keeps the memory alive, where it is and who to tell about accesses
+        std::shared_ptr<void> _owner;
+        unsigned int _address = 0;
+        Access _access;
+
+        unsigned char * Element(int index) const {
+            if(index < 0 || index >= _size) {
+                throw std::out_of_range("buffer index out of range");
+            }
+            return _data + index * ElementSize(_type);
+        }
+
+        void CheckRange(int first, int count) const {
+            if(first < 0 || count < 0 || first > _size - count) {
+                throw std::out_of_range("buffer range out of range");
+            }
+        }
+
+        void Before(int first, int count) const {
+            if(_access) {
+                _access(_address + first * ElementSize(_type), count * ElementSize(_type), false);
+            }
+        }
+
+        void After(int first, int count) const {
+            if(_access) {
+                _access(_address + first * ElementSize(_type), count * ElementSize(_type), true);
+            }
+        }
+
+        template <typename T>
+        static T Load(unsigned char const* p) {
+            T value;
+            std::memcpy(&value, p, sizeof(T));
+            return value;
+        }
+
+        template <typename T>
+        static void Store(unsigned char * p, T value) {
+            std::memcpy(p, &value, sizeof(T));
+        }
+
+        // Rounds towards zero and wraps around like integer conversions in C
+        static std::int32_t Wrap(double value) {
+            if(!(std::abs(value) < 9.2e18)) {
+                return 0;
+            }
+            return static_cast<std::int32_t>(static_cast<std::uint32_t>(static_cast<std::int64_t>(value)));
+        }
+
+        double GetAt(unsigned char const* p) const {
+            switch(_type) {
+            case ElementType::Int8:
+                return Load<std::int8_t>(p);
+            case ElementType::Int16:
+                return Load<std::int16_t>(p);
+            case ElementType::Int32:
+                return Load<std::int32_t>(p);
+            case ElementType::Fixed:
+                return Load<std::int32_t>(p) / 65536.0;
+            default:
+                return Load<float>(p);
+            }
+        }
+
+        void SetAt(unsigned char * p, double value) const {
+            switch(_type) {
+            case ElementType::Int8:
+                Store(p, static_cast<std::int8_t>(Wrap(value)));
+                break;
+            case ElementType::Int16:
+                Store(p, static_cast<std::int16_t>(Wrap(value)));
+                break;
+            case ElementType::Int32:
+                Store(p, Wrap(value));
+                break;
+            case ElementType::Fixed:
+                Store(p, Wrap(std::round(value * 65536.0)));
+                break;
+            default:
+                Store(p, static_cast<float>(value));
+                break;
+            }
+        }
+
+    public:
+        static int ElementSize(ElementType type) {
+            switch(type) {
+            case ElementType::Int8:
+                return 1;
+            case ElementType::Int16:
+                return 2;
+            default:
+                return 4;
+            }
+        }
+
+        // "int8", "int16", "int32", "fixed" or "float"
+        static ElementType ParseType(std::string const& name) {
+            static char const* const names[] = { "int8", "int16", "int32", "fixed", "float" };
+            for(int i = 0; i < 5; i++) {
+                if(name == names[i]) {
+                    return static_cast<ElementType>(i);
+                }
+            }
+            throw std::out_of_range("unknown buffer type " + name);
+        }
+
+        // size zeroed elements
+        Buffer(ElementType type, int size)
+            : _type{type}, _size{std::max(size, 0)}, _storage(_size * ElementSize(type)), _data{_storage.data()} { }
+
+        // A view of size elements at data, which is address in console memory
+        Buffer(ElementType type, int size, unsigned char * data, std::shared_ptr<void> owner, unsigned int address, Access access)
+            : _type{type}, _size{size}, _data{data}, _owner{std::move(owner)}, _address{address}, _access{std::move(access)} { }
+
+        // Copies of buffers have elements of their own, copies of views view the same memory
+        Buffer(Buffer const& other)
+            : _type{other._type}, _size{other._size}, _storage(other._storage), _data{other._owner ? other._data : _storage.data()},
+              _owner{other._owner}, _address{other._address}, _access{other._access} { }
+
+        Buffer & operator=(Buffer const&) = delete;
+
+        ElementType Type() const {
+            return _type;
+        }
+
+        int Size() const {
+            return _size;
+        }
+
+        bool IsView() const {
+            return static_cast<bool>(_owner);
+        }
+
+        bool IsInteger() const {
+            return _type == ElementType::Int8 || _type == ElementType::Int16 || _type == ElementType::Int32;
+        }
+
+        // The elements as stored, without telling a view's access function (save states)
+        unsigned char const* Data() const {
+            return _data;
+        }
+
+        unsigned char * Data() {
+            return _data;
+        }
+
+        // Same type and elements; a view only equals a view of the same memory
+        bool Equals(Buffer const& other) const {
+            if(_type != other._type || _size != other._size || IsView() != other.IsView()) {
+                return false;
+            }
+            return IsView() ? _data == other._data : _storage == other._storage;
+        }
+
+        double Get(int index) const {
+            auto p = Element(index);
+            Before(index, 1);
+            return GetAt(p);
+        }
+
+        void Set(int index, double value) {
+            auto p = Element(index);
+            Before(index, 1);
+            SetAt(p, value);
+            After(index, 1);
+        }
+
+        // Sets count elements from first to value
+        void Fill(double value, int first, int count) {
+            CheckRange(first, count);
+            if(count == 0) {
+                return;
+            }
+            Before(first, count);
+            auto size = ElementSize(_type);
+            auto p = _data + first * size;
+            SetAt(p, value);
+            for(int i = 1; i < count; i++) {
+                std::memcpy(p + i * size, p, size);
+            }
+            After(first, count);
+        }
+
+        // Copies count elements from first of source to dest onwards, converting them if the types
+        // differ. The two may be the same buffer or overlap.
+        void Copy(int dest, Buffer const& source, int first, int count) {
+            CheckRange(dest, count);
+            source.CheckRange(first, count);
+            if(count == 0) {
+                return;
+            }
+            source.Before(first, count);
+            Before(dest, count);
+            if(source._type == _type) {
+                std::memmove(_data + dest * ElementSize(_type), source._data + first * ElementSize(_type), count * ElementSize(_type));
+            } else {
+                // Element sizes differ too, through a copy in case the two overlap
+                std::vector<double> values(count);
+                for(int i = 0; i < count; i++) {
+                    values[i] = source.GetAt(source._data + (first + i) * ElementSize(source._type));
+                }
+                for(int i = 0; i < count; i++) {
+                    SetAt(_data + (dest + i) * ElementSize(_type), values[i]);
+                }
+            }
+            After(dest, count);
+        }
+
+        // count elements from first rounded down to integers, for drawing
+        void Integers(int first, int count, int * out) const {
+            CheckRange(first, count);
+            Before(first, count);
+            auto size = ElementSize(_type);
+            auto p = _data + first * size;
+            for(int i = 0; i < count; i++, p += size) {
+                switch(_type) {
+                case ElementType::Int8:
+                    out[i] = Load<std::int8_t>(p);
+                    break;
+                case ElementType::Int16:
+                    out[i] = Load<std::int16_t>(p);
+                    break;
+                case ElementType::Int32:
+                    out[i] = Load<std::int32_t>(p);
+                    break;
+                case ElementType::Fixed:
+                    out[i] = Load<std::int32_t>(p) >> 16;
+                    break;
+                default:
+                    out[i] = Wrap(std::floor(Load<float>(p)));
+                    break;
+                }
+            }
+        }
+
+        // count elements from first of an int32 or fixed buffer as they are stored
+        void Load32(int first, int count, std::int32_t * out) const {
+            CheckRange(first, count);
+            Before(first, count);
+            std::memcpy(out, _data + first * 4, count * 4);
+        }
+
+        void Store32(int first, int count, std::int32_t const* in) {
+            CheckRange(first, count);
+            Before(first, count);
+            std::memcpy(_data + first * 4, in, count * 4);
+            After(first, count);
+        }
+
+        // count elements from first as doubles
+        void Values(int first, int count, double * out) const {
+            CheckRange(first, count);
+            Before(first, count);
+            auto size = ElementSize(_type);
+            for(int i = 0; i < count; i++) {
+                out[i] = GetAt(_data + (first + i) * size);
+            }
+        }
+    };
+
+}
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "map.hpp"
+
+namespace drak {
+
+    // Queries against the solid cells of a map page. A cell is solid when the flags of its sprite
+    // share a bit with the query's mask. Coordinates are in map pixels and everything outside the
+    // map is empty.
+    namespace collision {
+
+        class Grid {
+            std::uint16_t const* _cells;
+            unsigned char const* _flags;
+            unsigned char _mask;
+
+        public:
+            // cells is a decoded map page (see map::Shadow), flags one byte per sprite
+            Grid(std::uint16_t const* cells, unsigned char const* flags, int mask)
+                : _cells{cells}, _flags{flags}, _mask{static_cast<unsigned char>(mask)} { }
+
+            bool Solid(int x, int y) const {
+                return x >= 0 && y >= 0 && x < map::Width && y < map::Height && (_flags[_cells[y * map::Width + x]] & _mask) != 0;
+            }
+        };
+
+        // Cell holding coordinate v, kept in int range
+        inline int Cell(double v) {
+            return static_cast<int>(std::floor(std::min(std::max(v / map::TileSize, -1e6), 1e6)));
+        }
+
+        // Cell past the one holding the end of a span ending at v (exclusive)
+        inline int CellEnd(double v) {
+            return static_cast<int>(std::ceil(std::min(std::max(v / map::TileSize, -1e6), 1e6)));
+        }
+
+        // Moves the span position..position + size by delta along an axis of cells lines, stopping
+        // against the first line (a row or column of cells) solid(line) says it would enter
+        template <typename Solid>
+        double Move(double position, double size, double delta, int lines, Solid solid, bool & hit) {
+            hit = false;
+            if(delta > 0) {
+                auto first = std::max(CellEnd(position + size), 0);
+                auto last = std::min(CellEnd(position + size + delta) - 1, lines - 1);
+                for(int line = first; line <= last; line++) {
+                    if(solid(line)) {
+                        hit = true;
+                        return line * map::TileSize - size;
+                    }
+                }
+            } else if(delta < 0) {
+                auto first = std::min(Cell(position) - 1, lines - 1);
+                auto last = std::max(Cell(position + delta), 0);
+                for(int line = first; line >= last; line--) {
+                    if(solid(line)) {
+                        hit = true;
+                        return (line + 1) * map::TileSize;
+                    }
+                }
+            }
+            return position + delta;
+        }
+
+        enum Side {
+            Left = 1,
+            Right = 2,
+            Top = 4,
+            Bottom = 8,
+        };
+
+        struct Box {
+            double x;
+            double y;
+            double w;
+            double h;
+            // Sides (see Side) that were stopped by a solid cell
+            int hit;
+        };
+
+        // Moves box by dx and then by dy, stopping each move where the box would enter a solid
+        // cell, however far it goes. A box that already overlaps solid cells can move out of them.
+        inline Box Sweep(Grid const& grid, Box box, double dx, double dy) {
+            box.hit = 0;
+            bool hit;
+
+            auto top = std::max(Cell(box.y), 0);
+            auto bottom = std::min(CellEnd(box.y + box.h) - 1, map::Height - 1);
+            box.x = Move(box.x, box.w, dx, map::Width, [&](int column) {
+                for(int row = top; row <= bottom; row++) {
+                    if(grid.Solid(column, row)) {
+                        return true;
+                    }
+                }
+                return false;
+            }, hit);
+            box.hit |= hit ? (dx > 0 ? Right : Left) : 0;
+
+            auto left = std::max(Cell(box.x), 0);
+            auto right = std::min(CellEnd(box.x + box.w) - 1, map::Width - 1);
+            box.y = Move(box.y, box.h, dy, map::Height, [&](int row) {
+                for(int column = left; column <= right; column++) {
+                    if(grid.Solid(column, row)) {
+                        return true;
+                    }
+                }
+                return false;
+            }, hit);
+            box.hit |= hit ? (dy > 0 ? Bottom : Top) : 0;
+            return box;
+        }
+
+        struct Hit {
+            bool hit;
+            // Where the ray enters the cell, the cell, and the side of it the ray came through
+            // (-1, 0 or 1 along each axis; 0, 0 when the ray starts inside it)
+            double x;
+            double y;
+            int cellX;
+            int cellY;
+            int normalX;
+            int normalY;
+        };
+
+        // First solid cell on the segment from x0, y0 to x1, y1, visiting cells in order along it
+        inline Hit Raycast(Grid const& grid, double x0, double y0, double x1, double y1) {
+            Hit result{};
+            auto dx = x1 - x0;
+            auto dy = y1 - y0;
+
+            // Only the part of the segment over the map can hit anything
+            double enter = 0.0;
+            double leave = 1.0;
+            int enterX = 0;
+            int enterY = 0;
+            auto clip = [&](double p, double d, double size, bool horizontal) {
+                if(d == 0.0) {
+                    return p >= 0.0 && p < size;
+                }
+                auto a = (0.0 - p) / d;
+                auto b = (size - p) / d;
+                if(a > b) {
+                    std::swap(a, b);
+                }
+                if(a > enter) {
+                    enter = a;
+                    enterX = horizontal ? (d > 0 ? -1 : 1) : 0;
+                    enterY = horizontal ? 0 : (d > 0 ? -1 : 1);
+                }
+                leave = std::min(leave, b);
+                return enter <= leave;
+            };
+            if(!clip(x0, dx, map::PixelWidth, true) || !clip(y0, dy, map::PixelHeight, false)) {
+                return result;
+            }
+
+            auto cx = std::min(std::max(Cell(x0 + dx * enter), 0), map::Width - 1);
+            auto cy = std::min(std::max(Cell(y0 + dy * enter), 0), map::Height - 1);
+            auto stepX = dx > 0 ? 1 : (dx < 0 ? -1 : 0);
+            auto stepY = dy > 0 ? 1 : (dy < 0 ? -1 : 0);
+            auto infinity = std::numeric_limits<double>::infinity();
+            // Segment position of the next column and row boundary, and between boundaries
+            auto nextX = stepX == 0 ? infinity : ((cx + (stepX > 0 ? 1 : 0)) * map::TileSize - x0) / dx;
+            auto nextY = stepY == 0 ? infinity : ((cy + (stepY > 0 ? 1 : 0)) * map::TileSize - y0) / dy;
+            auto deltaX = stepX == 0 ? infinity : map::TileSize / std::abs(dx);
+            auto deltaY = stepY == 0 ? infinity : map::TileSize / std::abs(dy);
+
+            auto t = enter;
+            auto normalX = enterX;
+            auto normalY = enterY;
+            while(cx >= 0 && cy >= 0 && cx < map::Width && cy < map::Height) {
+                if(grid.Solid(cx, cy)) {
+                    result = Hit{ true, x0 + dx * t, y0 + dy * t, cx, cy, normalX, normalY };
+                    return result;
+                }
+                if(nextX < nextY) {
+                    if(nextX > leave) {
+                        break;
+                    }
+                    t = nextX;
+                    cx += stepX;
+                    nextX += deltaX;
+                    normalX = -stepX;
+                    normalY = 0;
+                } else {
+                    if(nextY > leave) {
+                        break;
+                    }
+                    t = nextY;
+                    cy += stepY;
+                    nextY += deltaY;
+                    normalX = 0;
+                    normalY = -stepY;
+                }
+            }
+            return result;
+        }
+
+    }
+
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#include "color.hpp"
+
+namespace drak {
+
+    // Layout of the display registers, read when the screen is presented:
+    //
+    //   palettes  8 x 64 colors x 3 bytes (r, g, b)
+    //   lines     240 x 8 bytes: palette (0-7), unused, horizontal offset (int16, the row is
+    //             shown starting that many pixels to the right, wrapping around), left clip
+    //             (int16), right margin (int16, columns hidden at the right), unused
+    //   remaps    8 x 64 bytes: color each color is drawn as while that remap table is selected
+    //
+    // Everything is little endian. Clipped columns show color 0 of the line's palette.
+    namespace display {
+
+        static constexpr int Width = 320;
+        static constexpr int Height = 240;
+        static constexpr int Palettes = 8;
+        static constexpr int Colors = 64;
+        static constexpr int PaletteSize = Colors * 3;
+        static constexpr int LineSize = 8;
+        static constexpr int Remaps = 8;
+
+        static constexpr int PaletteOffset = 0;
+        static constexpr int LineOffset = PaletteOffset + Palettes * PaletteSize;
+        static constexpr int RemapOffset = LineOffset + Height * LineSize;
+        static constexpr int Size = RemapOffset + Remaps * Colors;
+
+        struct Line {
+            int palette;
+            int offset;
+            int left;
+            int right;
+        };
+
+        inline int Get16(unsigned char const* p) {
+            return static_cast<std::int16_t>(p[0] | (p[1] << 8));
+        }
+
+        inline void Put16(unsigned char * p, int value) {
+            p[0] = static_cast<unsigned char>(value);
+            p[1] = static_cast<unsigned char>(value >> 8);
+        }
+
+        inline Line GetLine(unsigned char const* registers, int row) {
+            auto p = registers + LineOffset + row * LineSize;
+            Line line;
+            line.palette = p[0] % Palettes;
+            line.offset = Get16(p + 2);
+            line.left = std::min(std::max(Get16(p + 4), 0), Width);
+            line.right = std::max(Width - std::max(Get16(p + 6), 0), line.left);
+            return line;
+        }
+
+        // Maps every color to itself
+        inline void ResetRemap(unsigned char * table) {
+            for(int color = 0; color < Colors; color++) {
+                table[color] = static_cast<unsigned char>(color);
+            }
+        }
+
+        // Every palette the default one, every line plain, every remap table the identity
+        inline void Reset(unsigned char * registers) {
+            std::memset(registers, 0, Size);
+            for(int palette = 0; palette < Palettes; palette++) {
+                for(int color = 0; color < Colors; color++) {
+                    auto p = registers + PaletteOffset + palette * PaletteSize + color * 3;
+                    p[0] = DefaultPalette.data[color].r;
+                    p[1] = DefaultPalette.data[color].g;
+                    p[2] = DefaultPalette.data[color].b;
+                }
+            }
+            for(int remap = 0; remap < Remaps; remap++) {
+                ResetRemap(registers + RemapOffset + remap * Colors);
+            }
+        }
+
+        // Turns the screen (one palette index per pixel) into RGBA8, applying the line registers
+        // as it goes, so raster effects cost a table lookup per line rather than a script call
+        class Presenter {
+            std::array<std::array<std::uint32_t, Colors>, Palettes> _palettes;
+            std::array<unsigned char, Width> _row;
+
+        public:
+            void Convert(unsigned char const* pixels, unsigned char const* registers, std::uint32_t * out) {
+                for(int palette = 0; palette < Palettes; palette++) {
+                    for(int color = 0; color < Colors; color++) {
+                        auto p = registers + PaletteOffset + palette * PaletteSize + color * 3;
+                        _palettes[palette][color] = std::uint32_t(p[0]) | (std::uint32_t(p[1]) << 8) | (std::uint32_t(p[2]) << 16) | 0xFF000000u;
+                    }
+                }
+
+                for(int y = 0; y < Height; y++, pixels += Width, out += Width) {
+                    auto line = GetLine(registers, y);
+                    auto const& palette = _palettes[line.palette];
+
+                    auto source = pixels;
+                    if(line.offset != 0) {
+                        // Screen x shows source x - offset
+                        auto shift = ((line.offset % Width) + Width) % Width;
+                        std::memcpy(_row.data() + shift, pixels, Width - shift);
+                        std::memcpy(_row.data(), pixels + Width - shift, shift);
+                        source = _row.data();
+                    }
+
+                    auto border = palette[0];
+                    std::fill(out, out + line.left, border);
+                    for(int x = line.left; x < line.right; x++) {
+                        out[x] = palette[source[x] & (Colors - 1)];
+                    }
+                    std::fill(out + line.right, out + Width, border);
+                }
+            }
+        };
+
+    }
+
+}
@@ -1,8 +1,10 @@
 #include "pch.h"
 
 #include "system.hpp"
-
-std::shared_ptr<drak::System> drak::System::system = nullptr;
+#include "arguments.hpp"
+#include "batch_runner.hpp"
+#include "audio_device.hpp"
+#include "bench.hpp"
 
 constexpr char source[] = R"(
 trace("Starting Up...");
@@ -26,49 +28,118 @@ std::string readFile(std::string const& filename) {
         in.close();
         return contents;
     }
-    throw errno;
+    throw std::runtime_error("Could not read " + filename + ": " + std::generic_category().message(errno));
 }
 
-int main(int argc, char * argv[]) {
-    std::string do_source;
-    if(argc >= 1) {
-        std::string filename = argv[1];
-        do_source = readFile(filename);
-    } else {
-        do_source = source;
+int runBatch(drak::Arguments const& args) {
+    auto directory = args.Text(0);
+    unsigned int frames = args.Count(1, 600);
+    unsigned int threads = args.Count(2, std::max(1u, std::thread::hardware_concurrency()));
+
+    auto report = drak::BatchRunner(frames, threads).Run(directory);
+    report.Print(nowide::cout);
+
+    return report.Failures() == 0 ? 0 : 1;
+}
+
+int renderWav(drak::Arguments const& args) {
+    unsigned int frames = args.Count(2, 600);
+    auto cart = readFile(args.Text(0));
+
+    drak::System sys;
+    drak::WavRenderer wav(sys.Audio(), args.Text(1));
+    if(!wav.IsOpen()) {
+        throw std::runtime_error("Could not write " + args.Text(1));
     }
 
-    drak::System::InitializeSystem();
+    sys.LoadScript(cart);
+    for(unsigned int frame = 0; frame < frames && !sys.MustQuit(); frame++) {
+        if(!sys.Update()) {
+            return 1;
+        }
+        // Runs faster than real time, so let the renderer keep up instead of overflowing the queue
+        sys.Audio().Flush();
+    }
 
-    try {
+    return 0;
+}
+
+// drak0 [cartridge], the console in a window
+int play(std::string const& filename) {
+    auto do_source = filename.empty() ? std::string(source) : readFile(filename);
+
+    drak::System sys;
+    // Up to 10 seconds, fewer if the cartridge changes so much state that they don't fit in 4 MB
+    sys.SetRewindFrames(10 * 60, 4 * 1024 * 1024);
+
+    // Storage (pmem) persists next to the cartridge
+    if(!filename.empty()) {
+        sys.AttachStorage(std::filesystem::path(filename).replace_extension(".sav"));
+    }
+
+    sf::RenderWindow window(sf::VideoMode(800, 600), "DRAK-0");
 
-        auto & sys = drak::System::Get();
+    // The console screen, scaled up to fill the window
+    std::vector<std::uint32_t> frame(drak::display::Width * drak::display::Height);
+    sf::Texture screen;
+    screen.create(drak::display::Width, drak::display::Height);
+    sf::Sprite sprite(screen);
+    sprite.setScale(800.0f / drak::display::Width, 600.0f / drak::display::Height);
 
-        sf::RenderWindow window(sf::VideoMode(800, 600), "DRAK-0");
+    drak::AudioDevice audio(sys.Audio());
+    audio.play();
 
-        // Load Script/Cartridge
-        sys.LoadScript(do_source);
+    // Load Script/Cartridge
+    sys.LoadScript(do_source);
 
-        while(window.isOpen() && !sys.MustQuit()) {
-            sf::Event event;
+    while(window.isOpen() && !sys.MustQuit()) {
+        sf::Event event;
 
-            while(window.pollEvent(event)) {
-                if(event.type == sf::Event::Closed) {
-                    window.close();
-                }
+        while(window.pollEvent(event)) {
+            if(event.type == sf::Event::Closed) {
+                window.close();
             }
+        }
 
+        // Hold backspace to rewind
+        if(window.hasFocus() && sf::Keyboard::isKeyPressed(sf::Keyboard::BackSpace)) {
+            sys.Rewind();
+        } else {
             sys.Update();
-
-            window.clear();
-            window.display();
         }
 
-    } catch(...) {
-        drak::System::UnitializeSystem();
-    }
+        sys.Present(frame.data());
+        screen.update(reinterpret_cast<sf::Uint8 const*>(frame.data()));
 
-    drak::System::UnitializeSystem();
+        window.clear();
+        window.draw(sprite);
+        window.display();
+    }
 
     return 0;
 }
+
+int main(int argc, char * argv[]) {
+    try {
+        if(argc >= 2 && std::string(argv[1]) == "--batch") {
+            return drak::RunMode(argc, argv, "<directory> [frames] [threads]", runBatch);
+        }
+        if(argc >= 2 && std::string(argv[1]) == "--wav") {
+            return drak::RunMode(argc, argv, "<cartridge> <output.wav> [frames]", renderWav);
+        }
+        int status = 0;
+        if(drak::bench::Run(argc, argv, status)) {
+            return status;
+        }
+        if(argc > 2) {
+            nowide::cerr << "usage: drak0 [cartridge]\n";
+            return 2;
+        }
+        return play(argc >= 2 ? argv[1] : "");
+    } catch(chaiscript::exception::eval_error const& e) {
+        nowide::cerr << "ERROR: " << e.pretty_print() << "\n";
+    } catch(std::exception const& e) {
+        nowide::cerr << "ERROR: " << e.what() << "\n";
+    }
+    return 1;
+}
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "raster.hpp"
+
+namespace drak {
+
+    // Layout of a map page: 40 x 30 cells, row by row, each a 13-bit sprite index packed least
+    // significant bits first like the screen's pixels. Sprites are the 8x8 tiles of the sprite
+    // bank pages in order, 32 x 32 to a page; indices past the last page wrap around.
+    namespace map {
+
+        static constexpr int Width = 40;
+        static constexpr int Height = 30;
+        static constexpr int CellBits = 13;
+        static constexpr int TileSize = 8;
+        static constexpr int PixelWidth = Width * TileSize;
+        static constexpr int PixelHeight = Height * TileSize;
+        static constexpr int Pages = 5;
+        static constexpr int PageTiles = Rasterizer::TextureSize / TileSize;
+        static constexpr int Sprites = 1 << CellBits;
+        static constexpr int PageSize = (Width * Height * CellBits + 7) / 8;
+
+        inline int GetCell(unsigned char const* page, int x, int y) {
+            auto bit = (y * Width + x) * CellBits;
+            auto p = page + bit / 8;
+            // The last cell ends in the page's last byte, so only read a third byte when needed
+            auto value = std::uint32_t(p[0]) | (std::uint32_t(p[1]) << 8);
+            if((bit & 7) + CellBits > 16) {
+                value |= std::uint32_t(p[2]) << 16;
+            }
+            return static_cast<int>((value >> (bit & 7)) & (Sprites - 1));
+        }
+
+        inline void SetCell(unsigned char * page, int x, int y, int sprite) {
+            auto bit = (y * Width + x) * CellBits;
+            auto p = page + bit / 8;
+            auto bytes = (bit & 7) + CellBits > 16 ? 3 : 2;
+            auto mask = std::uint32_t(Sprites - 1) << (bit & 7);
+            auto value = std::uint32_t(sprite & (Sprites - 1)) << (bit & 7);
+            for(int i = 0; i < bytes; i++) {
+                p[i] = static_cast<unsigned char>((p[i] & ~(mask >> (i * 8))) | (value >> (i * 8)));
+            }
+        }
+
+        // Decoded copy of a map page's cells, rebuilt on first use after Invalidate()
+        class Shadow {
+            std::array<std::uint16_t, Width * Height> _cells;
+            bool _valid = false;
+
+        public:
+            void Invalidate() {
+                _valid = false;
+            }
+
+            std::uint16_t const* Get(unsigned char const* page) {
+                if(!_valid) {
+                    for(int y = 0; y < Height; y++) {
+                        for(int x = 0; x < Width; x++) {
+                            _cells[y * Width + x] = static_cast<std::uint16_t>(GetCell(page, x, y));
+                        }
+                    }
+                    _valid = true;
+                }
+                return _cells.data();
+            }
+
+            // Keeps the copy in step with SetCell(page, x, y, sprite)
+            void Set(int x, int y, int sprite) {
+                _cells[y * Width + x] = static_cast<std::uint16_t>(sprite & (Sprites - 1));
+            }
+        };
+
+        // Row (0-7) of a sprite, given the unpacked sprite bank pages
+        inline unsigned char const* TileRow(std::array<unsigned char const*, Pages> const& sprites, int sprite, int row) {
+            auto tile = sprite % (PageTiles * PageTiles);
+            auto page = sprites[(sprite / (PageTiles * PageTiles)) % Pages];
+            return page + ((tile / PageTiles) * TileSize + row) * Rasterizer::TextureSize + (tile % PageTiles) * TileSize;
+        }
+
+        // Map coordinates of the first pixel of a row and the step between pixels
+        struct AffineRow {
+            double u;
+            double v;
+            double du;
+            double dv;
+        };
+
+        // Draws a map page under an affine (mode 7 style) mapping. The page is first composed into
+        // one byte per pixel from the unpacked sprite pages, so that the per pixel work is stepping
+        // 16.16 fixed point coordinates and one lookup.
+        class Affine {
+            std::vector<unsigned char> _image;
+
+            static constexpr std::int64_t One = 1 << 16;
+            static constexpr std::int64_t WidthFixed = PixelWidth * One;
+            static constexpr std::int64_t HeightFixed = PixelHeight * One;
+
+            static std::int64_t Fixed(double value) {
+                return static_cast<std::int64_t>(std::floor(value * One));
+            }
+
+            static std::int64_t Wrap(std::int64_t value, std::int64_t size) {
+                return ((value % size) + size) % size;
+            }
+
+        public:
+            Affine() : _image(PixelWidth * PixelHeight) { }
+
+            // sprites are the unpacked sprite bank pages
+            void Compose(unsigned char const* cells, std::array<unsigned char const*, Pages> const& sprites) {
+                for(int y = 0; y < Height; y++) {
+                    for(int x = 0; x < Width; x++) {
+                        auto in = TileRow(sprites, GetCell(cells, x, y), 0);
+                        auto out = _image.data() + y * TileSize * PixelWidth + x * TileSize;
+                        for(int row = 0; row < TileSize; row++, in += Rasterizer::TextureSize, out += PixelWidth) {
+                            std::memcpy(out, in, TileSize);
+                        }
+                    }
+                }
+            }
+
+            // Draws every clipped row of target that row(y, AffineRow &) returns true for, wrapping
+            // the map around or clamping to its edges, skipping the key color (-1 for none)
+            template <typename RowFunction>
+            void Draw(Rasterizer & target, RowFunction row, bool wrap, int key) {
+                auto image = _image.data();
+                target.Generate([&](int y, int x0, int n, unsigned char * out) {
+                    AffineRow mapping;
+                    if(!row(y, mapping)) {
+                        return Rasterizer::SkipRow;
+                    }
+                    auto u = Fixed(mapping.u + mapping.du * x0);
+                    auto v = Fixed(mapping.v + mapping.dv * x0);
+                    auto du = Fixed(mapping.du);
+                    auto dv = Fixed(mapping.dv);
+
+                    if(wrap) {
+                        // Wrapped steps are less than the map size, so one compare brings the
+                        // coordinates back in range
+                        u = Wrap(u, WidthFixed);
+                        v = Wrap(v, HeightFixed);
+                        du = Wrap(du, WidthFixed);
+                        dv = Wrap(dv, HeightFixed);
+                        for(int i = 0; i < n; i++) {
+                            out[i] = image[(v >> 16) * PixelWidth + (u >> 16)];
+                            u += du;
+                            v += dv;
+                            u -= u >= WidthFixed ? WidthFixed : 0;
+                            v -= v >= HeightFixed ? HeightFixed : 0;
+                        }
+                    } else {
+                        for(int i = 0; i < n; i++) {
+                            auto x = std::min(std::max(u >> 16, std::int64_t(0)), std::int64_t(PixelWidth - 1));
+                            auto y = std::min(std::max(v >> 16, std::int64_t(0)), std::int64_t(PixelHeight - 1));
+                            out[i] = image[y * PixelWidth + x];
+                            u += du;
+                            v += dv;
+                        }
+                    }
+                    return key;
+                });
+            }
+        };
+
+        // One map page of a parallax stack, scrolled so that screen pixel sx, sy shows map pixel
+        // sx + x, sy + y (wrapping around)
+        struct Layer {
+            unsigned char const* cells;
+            int x;
+            int y;
+        };
+
+        // Draws a stack of map pages front to back in one pass. Each row keeps a list of the
+        // pixels no layer has covered yet, and the layers behind the first only look at those, so a
+        // pixel stops at the first layer that isn't the key color there. Pixels no layer covers are
+        // left alone.
+        class Layers {
+        public:
+            static constexpr int MaxLayers = 4;
+
+        private:
+            // First row of the sprite of every cell in the tile row last decoded for each layer
+            std::array<std::array<unsigned char const*, Width>, MaxLayers> _cells;
+            std::array<int, MaxLayers> _cellRow;
+            std::array<unsigned char const*, Width> _tiles;
+            std::array<short, Rasterizer::Width> _open;
+
+        public:
+            // sprites are the unpacked sprite bank pages. Returns how many layer pixels were read.
+            template <typename LayerIterator>
+            long long Draw(Rasterizer & target, std::array<unsigned char const*, Pages> const& sprites, LayerIterator first, LayerIterator last, int key) {
+                long long reads = 0;
+                if(first == last) {
+                    return reads;
+                }
+                _cellRow.fill(-1);
+                target.Generate([&](int y, int x0, int n, unsigned char * out) {
+                    int open = n;
+                    int index = 0;
+                    for(auto layer = first; layer != last && open > 0; ++layer, ++index) {
+                        auto my = ((y + layer->y) % PixelHeight + PixelHeight) % PixelHeight;
+                        auto & cells = _cells[index];
+                        if(_cellRow[index] != my / TileSize) {
+                            _cellRow[index] = my / TileSize;
+                            for(int tx = 0; tx < Width; tx++) {
+                                cells[tx] = TileRow(sprites, GetCell(layer->cells, tx, my / TileSize), 0);
+                            }
+                        }
+                        auto offset = (my % TileSize) * Rasterizer::TextureSize;
+                        for(int tx = 0; tx < Width; tx++) {
+                            _tiles[tx] = cells[tx] + offset;
+                        }
+                        auto mx0 = static_cast<unsigned int>(((x0 + layer->x) % PixelWidth + PixelWidth) % PixelWidth);
+                        reads += open;
+
+                        // Uncovered pixels hold the key, so writing whatever the layer has there is
+                        // harmless, and the list is compacted without branching
+                        int still = 0;
+                        if(index == 0) {
+                            auto mx = mx0;
+                            for(int i = 0; i < n; i++) {
+                                auto color = _tiles[mx / TileSize][mx % TileSize];
+                                out[i] = color;
+                                _open[still] = static_cast<short>(i);
+                                still += color == key;
+                                mx = mx + 1 == PixelWidth ? 0 : mx + 1;
+                            }
+                        } else {
+                            for(int j = 0; j < open; j++) {
+                                auto i = _open[j];
+                                auto mx = mx0 + i;
+                                mx -= mx >= PixelWidth ? PixelWidth : 0;
+                                auto color = _tiles[mx / TileSize][mx % TileSize];
+                                out[i] = color;
+                                _open[still] = i;
+                                still += color == key;
+                            }
+                        }
+                        open = still;
+                    }
+                    // Fully covered rows are copied as they are
+                    return open == 0 ? -1 : key;
+                });
+                return reads;
+            }
+        };
+    }
+
+}
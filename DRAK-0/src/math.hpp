@@ -0,0 +1,224 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "buffer.hpp"
+#include "trig_data.hpp"
+
+namespace drak {
+
+    // Fixed point math that gives the same results on every machine, so replays stay in sync.
+    // Values are 16.16 fixed point in 32 bits and angles are 1/65536 of a turn (wrapping around),
+    // trig comes from the tables in trig_data.hpp and everything else is integer arithmetic.
+    namespace math {
+
+        static constexpr int FixedBits = 16;
+        static constexpr std::int32_t One = 1 << FixedBits;
+        static constexpr std::int32_t QuarterTurn = 1 << 14;
+        static constexpr std::int32_t HalfTurn = 1 << 15;
+
+        inline std::int32_t Saturate(std::int64_t value) {
+            return static_cast<std::int32_t>(std::min<std::int64_t>(std::max<std::int64_t>(value, std::numeric_limits<std::int32_t>::min()), std::numeric_limits<std::int32_t>::max()));
+        }
+
+        // Rounded down, like shifting
+        inline std::int32_t Mul(std::int32_t a, std::int32_t b) {
+            return Saturate((std::int64_t(a) * b) >> FixedBits);
+        }
+
+        // Rounded towards zero, b must not be 0
+        inline std::int32_t Div(std::int32_t a, std::int32_t b) {
+            return Saturate(std::int64_t(a) * One / b);
+        }
+
+        // Largest integer whose square is at most value
+        inline std::uint64_t IntegerSqrt(std::uint64_t value) {
+            std::uint64_t result = 0;
+            std::uint64_t bit = std::uint64_t(1) << 62;
+            while(bit > value) {
+                bit >>= 2;
+            }
+            for(; bit != 0; bit >>= 2) {
+                if(value >= result + bit) {
+                    value -= result + bit;
+                    result = (result >> 1) + bit;
+                } else {
+                    result >>= 1;
+                }
+            }
+            return result;
+        }
+
+        // 0 for negative values
+        inline std::int32_t Sqrt(std::int32_t a) {
+            return a <= 0 ? 0 : static_cast<std::int32_t>(IntegerSqrt(std::uint64_t(a) << FixedBits));
+        }
+
+        // Length of x, y in the same units, which needn't be fixed point
+        inline std::int32_t Length(std::int32_t x, std::int32_t y) {
+            return Saturate(static_cast<std::int64_t>(IntegerSqrt(std::uint64_t(std::int64_t(x) * x) + std::uint64_t(std::int64_t(y) * y))));
+        }
+
+        // Sine of the first quarter turn (0 to QuarterTurn inclusive), between table entries linearly
+        inline std::int32_t QuarterSine(std::int32_t angle) {
+            auto index = angle >> 4;
+            auto fraction = angle & 15;
+            if(index == trig_data_steps) {
+                return sine_quarter_data[index];
+            }
+            auto a = sine_quarter_data[index];
+            return a + (((sine_quarter_data[index + 1] - a) * fraction) >> 4);
+        }
+
+        inline std::int32_t Sin(std::int32_t angle) {
+            auto a = angle & 0xffff;
+            auto within = a & (QuarterTurn - 1);
+            switch(a >> 14) {
+            case 0:
+                return QuarterSine(within);
+            case 1:
+                return QuarterSine(QuarterTurn - within);
+            case 2:
+                return -QuarterSine(within);
+            default:
+                return -QuarterSine(QuarterTurn - within);
+            }
+        }
+
+        inline std::int32_t Cos(std::int32_t angle) {
+            // Added unsigned so it wraps instead of overflowing
+            return Sin(static_cast<std::int32_t>(static_cast<std::uint32_t>(angle) + QuarterTurn));
+        }
+
+        // Angle of x, y from the x axis, -HalfTurn to HalfTurn (0 for 0, 0)
+        inline std::int32_t Atan2(std::int32_t y, std::int32_t x) {
+            auto ax = x < 0 ? -std::int64_t(x) : std::int64_t(x);
+            auto ay = y < 0 ? -std::int64_t(y) : std::int64_t(y);
+            if(ax == 0 && ay == 0) {
+                return 0;
+            }
+            // Reduced to the first octant, as the smaller over the larger in 1/2^20
+            auto ratio = (std::min(ax, ay) << 20) / std::max(ax, ay);
+            auto index = static_cast<int>(ratio >> 10);
+            auto fraction = static_cast<std::int32_t>(ratio & 1023);
+            auto angle = atan_data[index];
+            if(index < trig_data_steps) {
+                angle += ((atan_data[index + 1] - angle) * fraction) >> 10;
+            }
+            if(ay > ax) {
+                angle = QuarterTurn - angle;
+            }
+            if(x < 0) {
+                angle = HalfTurn - angle;
+            }
+            return y < 0 ? -angle : angle;
+        }
+
+        // x, y turned by angle
+        inline void Rotate(std::int32_t & x, std::int32_t & y, std::int32_t angle) {
+            std::int64_t c = Cos(angle);
+            std::int64_t s = Sin(angle);
+            auto rx = (x * c - y * s) >> FixedBits;
+            auto ry = (x * s + y * c) >> FixedBits;
+            x = Saturate(rx);
+            y = Saturate(ry);
+        }
+
+        // Bulk operations on buffers of fixed (or int32) elements, in batches
+        static constexpr int Batch = 1024;
+
+        inline void CheckBuffers(std::initializer_list<Buffer const*> buffers, char const* name) {
+            for(auto buffer : buffers) {
+                if(buffer->Type() != ElementType::Fixed && buffer->Type() != ElementType::Int32) {
+                    throw std::out_of_range(std::string(name) + " needs fixed or int32 buffers");
+                }
+            }
+        }
+
+        // Calls f(first, n, x, y) for the elements of xs and ys (as many as the shorter holds),
+        // writing back what it leaves in x and y
+        template <typename F>
+        void ForPoints(Buffer & xs, Buffer & ys, F f) {
+            std::array<std::int32_t, Batch> x;
+            std::array<std::int32_t, Batch> y;
+            auto count = std::min(xs.Size(), ys.Size());
+            for(int first = 0; first < count; first += Batch) {
+                auto n = std::min(count - first, static_cast<int>(Batch));
+                xs.Load32(first, n, x.data());
+                ys.Load32(first, n, y.data());
+                f(first, n, x.data(), y.data());
+                xs.Store32(first, n, x.data());
+                ys.Store32(first, n, y.data());
+            }
+        }
+
+        // xs[i] += dxs[i], ys[i] += dys[i]
+        inline void Add(Buffer & xs, Buffer & ys, Buffer const& dxs, Buffer const& dys) {
+            CheckBuffers({ &xs, &ys, &dxs, &dys }, "bufadd");
+            if(dxs.Size() < std::min(xs.Size(), ys.Size()) || dys.Size() < std::min(xs.Size(), ys.Size())) {
+                throw std::out_of_range("bufadd needs an offset for every point");
+            }
+            ForPoints(xs, ys, [&](int first, int n, std::int32_t * x, std::int32_t * y) {
+                std::array<std::int32_t, Batch> dx;
+                std::array<std::int32_t, Batch> dy;
+                dxs.Load32(first, n, dx.data());
+                dys.Load32(first, n, dy.data());
+                for(int i = 0; i < n; i++) {
+                    x[i] = static_cast<std::int32_t>(static_cast<std::uint32_t>(x[i]) + static_cast<std::uint32_t>(dx[i]));
+                    y[i] = static_cast<std::int32_t>(static_cast<std::uint32_t>(y[i]) + static_cast<std::uint32_t>(dy[i]));
+                }
+            });
+        }
+
+        // Multiplies every point by k
+        inline void Scale(Buffer & xs, Buffer & ys, std::int32_t k) {
+            CheckBuffers({ &xs, &ys }, "bufscale");
+            ForPoints(xs, ys, [&](int, int n, std::int32_t * x, std::int32_t * y) {
+                for(int i = 0; i < n; i++) {
+                    x[i] = Mul(x[i], k);
+                    y[i] = Mul(y[i], k);
+                }
+            });
+        }
+
+        // Turns every point by angle around cx, cy
+        inline void Rotate(Buffer & xs, Buffer & ys, std::int32_t angle, std::int32_t cx, std::int32_t cy) {
+            CheckBuffers({ &xs, &ys }, "bufrot");
+            std::int64_t c = Cos(angle);
+            std::int64_t s = Sin(angle);
+            ForPoints(xs, ys, [&](int, int n, std::int32_t * x, std::int32_t * y) {
+                for(int i = 0; i < n; i++) {
+                    std::int64_t dx = x[i] - std::int64_t(cx);
+                    std::int64_t dy = y[i] - std::int64_t(cy);
+                    x[i] = Saturate(cx + ((dx * c - dy * s) >> FixedBits));
+                    y[i] = Saturate(cy + ((dx * s + dy * c) >> FixedBits));
+                }
+            });
+        }
+
+        // lengths[i] = Length(xs[i], ys[i])
+        inline void Lengths(Buffer & lengths, Buffer const& xs, Buffer const& ys) {
+            CheckBuffers({ &lengths, &xs, &ys }, "buflen");
+            std::array<std::int32_t, Batch> x;
+            std::array<std::int32_t, Batch> y;
+            auto count = std::min(lengths.Size(), std::min(xs.Size(), ys.Size()));
+            for(int first = 0; first < count; first += Batch) {
+                auto n = std::min(count - first, static_cast<int>(Batch));
+                xs.Load32(first, n, x.data());
+                ys.Load32(first, n, y.data());
+                for(int i = 0; i < n; i++) {
+                    x[i] = Length(x[i], y[i]);
+                }
+                lengths.Store32(first, n, x.data());
+            }
+        }
+
+    }
+
+}
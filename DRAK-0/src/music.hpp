@@ -0,0 +1,349 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+namespace drak {
+
+    // Layout of the music bank:
+    //
+    //   instruments  16 x 8 bytes: wave (0-4), volume (0-15), attack, decay (10 ms units),
+    //                sustain (0-15), release (10 ms units), 2 unused
+    //   patterns     48 x 64 rows x 4 bytes: note, instrument, volume, effect
+    //   tracks       8 x 68 bytes: speed (ticks per row, 0 = 6), rows per pattern (0 = 64),
+    //                length in frames (0 = 16), loop frame, then 16 frames x 4 channels of
+    //                pattern numbers (1-48, 0 = channel silent)
+    //
+    // A note is 1-96 (C0 to B7), 0 leaves the channel alone and NoteOff releases it. The volume
+    // column is 1-16 for volume 0-15, 0 keeps the instrument volume. Effects are a command in the
+    // high nibble and a parameter x in the low one:
+    //
+    //   1x  arpeggio, alternating between the note and x semitones above every tick
+    //   2x  slide up by x eighths of a semitone per tick
+    //   3x  slide down by x eighths of a semitone per tick
+    //   4x  vibrato, x eighths of a semitone deep
+    //   5x  volume slide up by x per tick (volume is 0-255 here)
+    //   6x  volume slide down by x per tick
+    //   Ex  cut the note after x ticks
+    //   Fx  set the speed to x ticks per row
+    namespace music {
+
+        static constexpr unsigned int Instruments = 16;
+        static constexpr unsigned int InstrumentSize = 8;
+        static constexpr unsigned int Patterns = 48;
+        static constexpr unsigned int Rows = 64;
+        static constexpr unsigned int RowSize = 4;
+        static constexpr unsigned int PatternSize = Rows * RowSize;
+        static constexpr unsigned int Tracks = 8;
+        static constexpr unsigned int Frames = 16;
+        static constexpr unsigned int Channels = 4;
+        static constexpr unsigned int TrackSize = 4 + Frames * Channels;
+
+        static constexpr unsigned int InstrumentOffset = 0;
+        static constexpr unsigned int PatternOffset = InstrumentOffset + Instruments * InstrumentSize;
+        static constexpr unsigned int TrackOffset = PatternOffset + Patterns * PatternSize;
+        static constexpr unsigned int Size = TrackOffset + Tracks * TrackSize;
+
+        static constexpr unsigned char NoteOff = 0xFF;
+        static constexpr unsigned int Notes = 96;
+
+        // Pitches are in eighths of a semitone from C0
+        static constexpr int PitchSteps = 8;
+        static constexpr int MaxPitch = Notes * PitchSteps - 1;
+
+        // Vibrato runs one cycle per VibratoLength ticks
+        static constexpr unsigned int VibratoLength = 32;
+
+        // Tables shared by every sequencer, built on first use
+        struct Tables {
+            std::array<float, Notes * PitchSteps> frequency;
+            std::array<signed char, VibratoLength> vibrato;
+
+            Tables() {
+                for(std::size_t pitch = 0; pitch < frequency.size(); pitch++) {
+                    frequency[pitch] = 16.3516f * std::pow(2.0f, pitch / float(12 * PitchSteps));
+                }
+                for(std::size_t i = 0; i < vibrato.size(); i++) {
+                    vibrato[i] = static_cast<signed char>(std::lround(64.0 * std::sin(6.283185307 * i / VibratoLength)));
+                }
+            }
+
+            static Tables const& Get() {
+                static const Tables tables;
+                return tables;
+            }
+        };
+
+        // Envelope times in seconds, levels between 0 and 1
+        struct Instrument {
+            unsigned char wave = 0;
+            float volume = 1.0f;
+            float attack = 0.0f;
+            float decay = 0.0f;
+            float sustain = 1.0f;
+            float release = 0.0f;
+        };
+
+        struct Track {
+            unsigned char speed;
+            unsigned char rows;
+            unsigned char length;
+            unsigned char loop;
+            std::array<std::array<unsigned char, Channels>, Frames> patterns;
+        };
+
+        // Immutable copy of the music bank handed to the audio thread, with the instruments and
+        // track headers decoded up front so that the sequencer only reads plain values
+        struct Data {
+            std::array<unsigned char, Size> source;
+            std::array<Instrument, Instruments> instruments;
+            std::array<Track, Tracks> tracks;
+
+            static std::unique_ptr<Data> Decode(unsigned char const* bank) {
+                auto data = std::make_unique<Data>();
+                std::memcpy(data->source.data(), bank, Size);
+
+                for(unsigned int i = 0; i < Instruments; i++) {
+                    auto in = bank + InstrumentOffset + i * InstrumentSize;
+                    auto & instrument = data->instruments[i];
+                    instrument.wave = std::min<unsigned char>(in[0], 4);
+                    instrument.volume = std::min<unsigned char>(in[1], 15) / 15.0f;
+                    instrument.attack = in[2] / 100.0f;
+                    instrument.decay = in[3] / 100.0f;
+                    instrument.sustain = std::min<unsigned char>(in[4], 15) / 15.0f;
+                    instrument.release = in[5] / 100.0f;
+                }
+
+                for(unsigned int i = 0; i < Tracks; i++) {
+                    auto in = bank + TrackOffset + i * TrackSize;
+                    auto & track = data->tracks[i];
+                    track.speed = in[0] == 0 ? 6 : in[0];
+                    track.rows = in[1] == 0 || in[1] > Rows ? Rows : in[1];
+                    track.length = in[2] == 0 || in[2] > Frames ? Frames : in[2];
+                    track.loop = in[3] < track.length ? in[3] : 0;
+                    for(unsigned int frame = 0; frame < Frames; frame++) {
+                        for(unsigned int channel = 0; channel < Channels; channel++) {
+                            auto pattern = in[4 + frame * Channels + channel];
+                            track.patterns[frame][channel] = pattern <= Patterns ? pattern : 0;
+                        }
+                    }
+                }
+
+                return data;
+            }
+
+            bool Matches(unsigned char const* bank) const {
+                return std::memcmp(source.data(), bank, Size) == 0;
+            }
+
+            unsigned char const* Row(unsigned int pattern, unsigned int row) const {
+                return source.data() + PatternOffset + (pattern - 1) * PatternSize + row * RowSize;
+            }
+        };
+
+        // Packs a playback position into one value for publishing across threads, -1 is stopped
+        inline std::int32_t PackPosition(int track, int frame, int row) {
+            return track < 0 ? -1 : std::int32_t(track | (frame << 8) | (row << 16));
+        }
+
+        // Steps a track one tick (one console frame) at a time on the audio thread. Channel
+        // changes go to a sink with Trigger(channel, instrument, frequency, volume),
+        // Pitch(channel, frequency), Volume(channel, volume), Release(channel) and Cut(channel).
+        class Sequencer {
+            struct Channel {
+                unsigned char pattern = 0;
+                int pitch = 0;
+                int volume = 255;
+                unsigned char effect = 0;
+                unsigned int vibrato = 0;
+                bool sounding = false;
+            };
+
+            Tables const& _tables = Tables::Get();
+            Data const* _data = nullptr;
+            Track const* _track = nullptr;
+            int _trackIndex = -1;
+            unsigned int _frame = 0;
+            unsigned int _row = 0;
+            unsigned int _tick = 0;
+            unsigned int _speed = 6;
+            bool _loop = true;
+            std::array<Channel, Channels> _channels;
+
+        public:
+            Data const* Music() const {
+                return _data;
+            }
+
+            bool Playing() const {
+                return _track != nullptr;
+            }
+
+            std::int32_t Position() const {
+                return PackPosition(_trackIndex, _frame, _row);
+            }
+
+            // Starts a track of data (which must outlive playback) at the given position
+            template <typename Sink>
+            void Play(Sink & sink, Data const* data, int track, int frame, int row, bool loop) {
+                Stop(sink);
+                if(!data || track < 0 || track >= static_cast<int>(Tracks)) {
+                    return;
+                }
+                _data = data;
+                _track = &data->tracks[track];
+                _trackIndex = track;
+                _frame = static_cast<unsigned int>(std::max(frame, 0)) % _track->length;
+                _row = static_cast<unsigned int>(std::max(row, 0)) % _track->rows;
+                _tick = 0;
+                _speed = _track->speed;
+                _loop = loop;
+            }
+
+            template <typename Sink>
+            void Stop(Sink & sink) {
+                for(unsigned int channel = 0; channel < Channels; channel++) {
+                    if(_channels[channel].sounding) {
+                        sink.Release(channel);
+                    }
+                    _channels[channel] = Channel{};
+                }
+                _data = nullptr;
+                _track = nullptr;
+                _trackIndex = -1;
+            }
+
+            template <typename Sink>
+            void Tick(Sink & sink) {
+                if(!_track) {
+                    return;
+                }
+
+                if(_tick == 0) {
+                    for(unsigned int channel = 0; channel < Channels; channel++) {
+                        Row(sink, channel);
+                    }
+                }
+                for(unsigned int channel = 0; channel < Channels; channel++) {
+                    Effect(sink, channel);
+                }
+
+                if(++_tick < _speed) {
+                    return;
+                }
+                _tick = 0;
+                if(++_row < _track->rows) {
+                    return;
+                }
+                _row = 0;
+                if(++_frame < _track->length) {
+                    return;
+                }
+                if(_loop) {
+                    _frame = _track->loop;
+                } else {
+                    Stop(sink);
+                }
+            }
+
+        private:
+            template <typename Sink>
+            void Row(Sink & sink, unsigned int index) {
+                auto & channel = _channels[index];
+                auto pattern = _track->patterns[_frame][index];
+
+                if(pattern != channel.pattern) {
+                    channel.pattern = pattern;
+                    if(pattern == 0 && channel.sounding) {
+                        sink.Release(index);
+                        channel.sounding = false;
+                    }
+                }
+                if(pattern == 0) {
+                    channel.effect = 0;
+                    return;
+                }
+
+                auto row = _data->Row(pattern, _row);
+                auto note = row[0];
+                auto volume = row[2];
+                channel.effect = row[3];
+
+                if(note >= 1 && note <= Notes) {
+                    auto const& instrument = _data->instruments[row[1] % Instruments];
+                    channel.pitch = (note - 1) * PitchSteps;
+                    channel.volume = volume == 0 ? 255 : (std::min<unsigned char>(volume, 16) - 1) * 17;
+                    channel.vibrato = 0;
+                    channel.sounding = true;
+                    sink.Trigger(index, instrument, Frequency(channel.pitch), channel.volume / 255.0f);
+                } else {
+                    if(note == NoteOff && channel.sounding) {
+                        sink.Release(index);
+                        channel.sounding = false;
+                    }
+                    if(volume != 0) {
+                        channel.volume = (std::min<unsigned char>(volume, 16) - 1) * 17;
+                        sink.Volume(index, channel.volume / 255.0f);
+                    }
+                }
+
+                if((channel.effect >> 4) == 0xF && (channel.effect & 0xF) != 0) {
+                    _speed = channel.effect & 0xF;
+                }
+            }
+
+            template <typename Sink>
+            void Effect(Sink & sink, unsigned int index) {
+                auto & channel = _channels[index];
+                if(!channel.sounding || channel.effect == 0) {
+                    return;
+                }
+
+                int x = channel.effect & 0xF;
+                switch(channel.effect >> 4) {
+                case 0x1:
+                    sink.Pitch(index, Frequency(channel.pitch + ((_tick & 1) ? x * PitchSteps : 0)));
+                    break;
+                case 0x2:
+                    channel.pitch = std::min(channel.pitch + x, MaxPitch);
+                    sink.Pitch(index, Frequency(channel.pitch));
+                    break;
+                case 0x3:
+                    channel.pitch = std::max(channel.pitch - x, 0);
+                    sink.Pitch(index, Frequency(channel.pitch));
+                    break;
+                case 0x4:
+                    channel.vibrato = (channel.vibrato + 1) % VibratoLength;
+                    sink.Pitch(index, Frequency(channel.pitch + _tables.vibrato[channel.vibrato] * x / 64));
+                    break;
+                case 0x5:
+                    channel.volume = std::min(channel.volume + x, 255);
+                    sink.Volume(index, channel.volume / 255.0f);
+                    break;
+                case 0x6:
+                    channel.volume = std::max(channel.volume - x, 0);
+                    sink.Volume(index, channel.volume / 255.0f);
+                    break;
+                case 0xE:
+                    if(_tick == static_cast<unsigned int>(x)) {
+                        sink.Cut(index);
+                        channel.sounding = false;
+                    }
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            float Frequency(int pitch) const {
+                return _tables.frequency[std::min(std::max(pitch, 0), MaxPitch)];
+            }
+        };
+
+    }
+
+}
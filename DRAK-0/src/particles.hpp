@@ -0,0 +1,216 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "raster.hpp"
+
+namespace drak {
+
+    // Particles kept outside console memory (so neither save states nor rewinding see them) in
+    // emitters of their own. Each emitter holds its particles as one array per field, and the
+    // per frame work is plain loops over those arrays with the emitter's settings as constants, so
+    // the compiler can vectorize them.
+    namespace particles {
+
+        static constexpr int Emitters = 16;
+        static constexpr int MaxParticles = 65536;
+        static constexpr int RampSize = 8;
+
+        class Emitter {
+        public:
+            // Spawning: particles per frame (fractions carry over) at x, y, moving at an angle in
+            // radians give or take half of spread, at a speed between the two
+            float x = 0.0f;
+            float y = 0.0f;
+            float rate = 0.0f;
+            float angle = 0.0f;
+            float spread = 6.2831853f;
+            float speedMin = 0.5f;
+            float speedMax = 1.0f;
+            // Frames particles live, at least 1
+            float lifeMin = 30.0f;
+            float lifeMax = 60.0f;
+            // Added to the velocity every frame, after multiplying it by drag
+            float gravityX = 0.0f;
+            float gravityY = 0.0f;
+            float drag = 1.0f;
+            // Colors (or sprites) particles go through over their life, evenly spaced
+            std::array<std::uint16_t, RampSize> ramp{ { 15 } };
+            int rampSize = 1;
+            // Draw 8x8 sprites centered on the particles instead of pixels
+            bool sprites = false;
+
+            // Pixel positions and ramp entries are worked out this many particles at a time
+            static constexpr int Batch = 1024;
+
+        private:
+            std::vector<float> _x;
+            std::vector<float> _y;
+            std::vector<float> _vx;
+            std::vector<float> _vy;
+            std::vector<float> _age;
+            std::vector<float> _life;
+            float _pending = 0.0f;
+
+        public:
+            int Count() const {
+                return static_cast<int>(_x.size());
+            }
+
+            void Clear() {
+                for(auto field : { &_x, &_y, &_vx, &_vy, &_age, &_life }) {
+                    field->clear();
+                }
+            }
+
+            // How many particles to spawn this frame at the current rate. No frame can spawn more
+            // than MaxParticles, so the rate is clamped to that (NaN and negative rates spawn none).
+            int Due() {
+                auto per_frame = rate > 0.0f ? std::min(rate, static_cast<float>(MaxParticles)) : 0.0f;
+                _pending = std::min(_pending + per_frame, static_cast<float>(MaxParticles));
+                auto count = static_cast<int>(_pending);
+                _pending -= count;
+                return count;
+            }
+
+            // uniform() returns evenly distributed numbers in [0, 1)
+            template <typename Uniform>
+            void Spawn(int count, Uniform & uniform) {
+                for(int i = 0; i < count; i++) {
+                    auto direction = angle + spread * (uniform() - 0.5f);
+                    auto speed = speedMin + (speedMax - speedMin) * uniform();
+                    _x.push_back(x);
+                    _y.push_back(y);
+                    _vx.push_back(std::cos(direction) * speed);
+                    _vy.push_back(std::sin(direction) * speed);
+                    _age.push_back(0.0f);
+                    _life.push_back(std::max(lifeMin + (lifeMax - lifeMin) * uniform(), 1.0f));
+                }
+            }
+
+            // Moves every particle a frame on and drops the ones whose life is over
+            void Step() {
+                auto n = Count();
+                auto px = _x.data();
+                auto py = _y.data();
+                auto vx = _vx.data();
+                auto vy = _vy.data();
+                auto age = _age.data();
+                auto gx = gravityX;
+                auto gy = gravityY;
+                auto k = drag;
+                for(int i = 0; i < n; i++) {
+                    vx[i] = vx[i] * k + gx;
+                    vy[i] = vy[i] * k + gy;
+                    px[i] += vx[i];
+                    py[i] += vy[i];
+                    age[i] += 1.0f;
+                }
+
+                // Compacting without branches: every particle is copied and only the live ones
+                // move the end of the kept ones along
+                auto life = _life.data();
+                int kept = 0;
+                for(int i = 0; i < n; i++) {
+                    px[kept] = px[i];
+                    py[kept] = py[i];
+                    vx[kept] = vx[i];
+                    vy[kept] = vy[i];
+                    age[kept] = age[i];
+                    life[kept] = life[i];
+                    kept += age[i] < life[i];
+                }
+                for(auto field : { &_x, &_y, &_vx, &_vy, &_age, &_life }) {
+                    field->resize(kept);
+                }
+            }
+
+            // Pixel positions and ramp entries of n particles from first, n at most Batch
+            void Positions(int first, int n, int * xs, int * ys, std::uint16_t * entries) const {
+                auto px = _x.data() + first;
+                auto py = _y.data() + first;
+                auto age = _age.data() + first;
+                auto life = _life.data() + first;
+                // Clamped far enough out that truncating the offset values rounds down
+                for(int i = 0; i < n; i++) {
+                    xs[i] = static_cast<int>(std::min(std::max(px[i], -64.0f), 1024.0f) + 64.0f) - 64;
+                    ys[i] = static_cast<int>(std::min(std::max(py[i], -64.0f), 1024.0f) + 64.0f) - 64;
+                }
+                auto steps = static_cast<float>(rampSize);
+                for(int i = 0; i < n; i++) {
+                    entries[i] = ramp[std::min(static_cast<int>(age[i] / life[i] * steps), rampSize - 1)];
+                }
+            }
+        };
+
+        // Every emitter, with the random numbers they spawn with
+        class Pool {
+            std::array<Emitter, Emitters> _emitters;
+            std::uint32_t _seed = 0x2545f491u;
+            std::array<int, Emitter::Batch> _xs;
+            std::array<int, Emitter::Batch> _ys;
+            std::array<std::uint16_t, Emitter::Batch> _entries;
+            std::array<unsigned char, Emitter::Batch> _colors;
+
+        public:
+            Emitter & Get(int emitter) {
+                return _emitters[emitter];
+            }
+
+            int Count() const {
+                int count = 0;
+                for(auto const& emitter : _emitters) {
+                    count += emitter.Count();
+                }
+                return count;
+            }
+
+            // Spawns up to count particles (fewer when that would pass MaxParticles)
+            void Burst(int emitter, int count) {
+                auto uniform = [this]() {
+                    // xorshift32, top 24 bits as the fraction
+                    _seed ^= _seed << 13;
+                    _seed ^= _seed >> 17;
+                    _seed ^= _seed << 5;
+                    return static_cast<float>(_seed >> 8) * (1.0f / 16777216.0f);
+                };
+                _emitters[emitter].Spawn(std::max(std::min(count, MaxParticles - Count()), 0), uniform);
+            }
+
+            // One frame: spawning at every emitter's rate, then moving everything
+            void Step() {
+                for(int i = 0; i < Emitters; i++) {
+                    Burst(i, _emitters[i].Due());
+                    _emitters[i].Step();
+                }
+            }
+
+            // Draws the particles of an emitter in batches of pixels, or as sprites through
+            // sprite(sprite, x, y) with x, y the top left corner
+            template <typename SpriteFunction>
+            void Draw(int emitter, Rasterizer & target, SpriteFunction sprite) {
+                auto const& e = _emitters[emitter];
+                for(int first = 0; first < e.Count(); first += Emitter::Batch) {
+                    auto n = std::min(e.Count() - first, static_cast<int>(Emitter::Batch));
+                    e.Positions(first, n, _xs.data(), _ys.data(), _entries.data());
+                    if(e.sprites) {
+                        for(int i = 0; i < n; i++) {
+                            sprite(_entries[i], _xs[i] - 4, _ys[i] - 4);
+                        }
+                    } else {
+                        for(int i = 0; i < n; i++) {
+                            _colors[i] = static_cast<unsigned char>(_entries[i]);
+                        }
+                        target.Plot(n, _xs.data(), _ys.data(), _colors.data());
+                    }
+                }
+            }
+        };
+
+    }
+
+}
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "collision.hpp"
+
+namespace drak {
+
+    // Shortest paths between cells of a map page, moving up, down, left or right through cells that
+    // aren't blocked. Searches work on a snapshot of which cells are blocked, so they can run on
+    // other threads while the map changes.
+    namespace path {
+
+        static constexpr int Cells = map::Width * map::Height;
+
+        // One byte per cell, row by row, nonzero where the cell can't be entered
+        using Blocked = std::array<unsigned char, Cells>;
+
+        inline void Snapshot(collision::Grid const& grid, Blocked & blocked) {
+            for(int y = 0; y < map::Height; y++) {
+                for(int x = 0; x < map::Width; x++) {
+                    blocked[y * map::Width + x] = grid.Solid(x, y);
+                }
+            }
+        }
+
+        inline bool Inside(int x, int y) {
+            return x >= 0 && y >= 0 && x < map::Width && y < map::Height;
+        }
+
+        // A* with the Manhattan distance as heuristic. The per cell state is kept between searches
+        // and marked with the search it belongs to, so a search never clears or allocates it.
+        class Finder {
+            std::array<std::uint32_t, Cells> _seen;
+            std::array<std::uint16_t, Cells> _cost;
+            std::array<std::int16_t, Cells> _parent;
+            // Open cells as estimate << 20 | distance left << 11 | cell, so the smallest key is the
+            // best estimate, nearest the goal on ties
+            std::vector<std::uint32_t> _open;
+            std::uint32_t _search = 0;
+
+            static constexpr std::uint32_t Closed = 0x80000000u;
+
+        public:
+            Finder() {
+                _seen.fill(0);
+                _open.reserve(Cells * 4);
+            }
+
+            // Fills cells with the path from x0, y0 to x1, y1 (both ends included) and returns
+            // true, or returns false when the goal can't be reached. The start may be blocked.
+            bool Find(Blocked const& blocked, int x0, int y0, int x1, int y1, std::vector<std::int16_t> & cells) {
+                cells.clear();
+                if(!Inside(x0, y0) || !Inside(x1, y1) || blocked[y1 * map::Width + x1]) {
+                    return false;
+                }
+                // Marks are search | Closed, so wrapping around must skip a whole range of them
+                _search = (_search + 1) & ~Closed;
+                if(_search == 0) {
+                    _seen.fill(0);
+                    _search = 1;
+                }
+
+                auto start = y0 * map::Width + x0;
+                auto goal = y1 * map::Width + x1;
+                auto left = [&](int cell) {
+                    return static_cast<std::uint32_t>(std::abs(cell % map::Width - x1) + std::abs(cell / map::Width - y1));
+                };
+                auto push = [&](int cell, std::uint32_t cost) {
+                    auto h = left(cell);
+                    _open.push_back(((cost + h) << 20) | (h << 11) | static_cast<std::uint32_t>(cell));
+                    std::push_heap(_open.begin(), _open.end(), std::greater<std::uint32_t>());
+                };
+
+                _open.clear();
+                _seen[start] = _search;
+                _cost[start] = 0;
+                _parent[start] = -1;
+                push(start, 0);
+                while(!_open.empty()) {
+                    std::pop_heap(_open.begin(), _open.end(), std::greater<std::uint32_t>());
+                    auto cell = static_cast<int>(_open.back() & 0x7ff);
+                    _open.pop_back();
+                    // A cell can be queued again with a lower cost, the older entries are skipped
+                    if(_seen[cell] == (_search | Closed)) {
+                        continue;
+                    }
+                    if(cell == goal) {
+                        for(auto c = goal; c != -1; c = _parent[c]) {
+                            cells.push_back(static_cast<std::int16_t>(c));
+                        }
+                        std::reverse(cells.begin(), cells.end());
+                        return true;
+                    }
+                    _seen[cell] = _search | Closed;
+
+                    auto x = cell % map::Width;
+                    auto y = cell / map::Width;
+                    auto cost = static_cast<std::uint16_t>(_cost[cell] + 1);
+                    auto visit = [&](int next) {
+                        if(blocked[next] || _seen[next] == (_search | Closed)) {
+                            return;
+                        }
+                        if(_seen[next] != _search || cost < _cost[next]) {
+                            _seen[next] = _search;
+                            _cost[next] = cost;
+                            _parent[next] = static_cast<std::int16_t>(cell);
+                            push(next, cost);
+                        }
+                    };
+                    if(x > 0) visit(cell - 1);
+                    if(x < map::Width - 1) visit(cell + 1);
+                    if(y > 0) visit(cell - map::Width);
+                    if(y < map::Height - 1) visit(cell + map::Width);
+                }
+                return false;
+            }
+        };
+
+        // Distance of every cell from one goal cell, for many agents heading to the same place:
+        // each steps to the neighbour nearest the goal
+        class FlowField {
+            std::array<std::uint16_t, Cells> _distance;
+            std::array<std::int16_t, Cells> _queue;
+
+        public:
+            static constexpr std::uint16_t Unreachable = 0xffff;
+
+            FlowField() {
+                _distance.fill(Unreachable);
+            }
+
+            // Breadth first from x, y through cells that aren't blocked
+            void Build(Blocked const& blocked, int x, int y) {
+                _distance.fill(Unreachable);
+                if(!Inside(x, y) || blocked[y * map::Width + x]) {
+                    return;
+                }
+                int head = 0;
+                int tail = 0;
+                _queue[tail++] = static_cast<std::int16_t>(y * map::Width + x);
+                _distance[y * map::Width + x] = 0;
+                while(head < tail) {
+                    auto cell = _queue[head++];
+                    auto cx = cell % map::Width;
+                    auto cy = cell / map::Width;
+                    auto distance = static_cast<std::uint16_t>(_distance[cell] + 1);
+                    auto visit = [&](int next) {
+                        if(!blocked[next] && _distance[next] == Unreachable) {
+                            _distance[next] = distance;
+                            _queue[tail++] = static_cast<std::int16_t>(next);
+                        }
+                    };
+                    if(cx > 0) visit(cell - 1);
+                    if(cx < map::Width - 1) visit(cell + 1);
+                    if(cy > 0) visit(cell - map::Width);
+                    if(cy < map::Height - 1) visit(cell + map::Width);
+                }
+            }
+
+            // Steps from x, y to the goal, or Unreachable (also outside the map)
+            int Distance(int x, int y) const {
+                return Inside(x, y) ? _distance[y * map::Width + x] : Unreachable;
+            }
+
+            // Direction (dx, dy) of the neighbour nearest the goal; 0, 0 at the goal and where no
+            // neighbour leads to it. A blocked cell next to a reachable one steps out into it.
+            void Step(int x, int y, int & dx, int & dy) const {
+                dx = 0;
+                dy = 0;
+                auto best = Inside(x, y) ? static_cast<int>(_distance[y * map::Width + x]) : static_cast<int>(Unreachable);
+                static constexpr int Directions[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+                for(auto const& d : Directions) {
+                    auto distance = Distance(x + d[0], y + d[1]);
+                    if(distance < best) {
+                        best = distance;
+                        dx = d[0];
+                        dy = d[1];
+                    }
+                }
+            }
+        };
+
+        // Searches asked for during a frame, run across worker threads once it ends and collected
+        // when the next one starts. Each worker keeps its own Finder.
+        class Queue {
+            struct Request {
+                std::shared_ptr<Blocked const> blocked;
+                int x0;
+                int y0;
+                int x1;
+                int y1;
+                int id;
+            };
+
+        public:
+            struct Result {
+                bool found;
+                std::vector<std::int16_t> cells;
+            };
+
+        private:
+            // Requests smaller batches than this aren't worth another thread
+            static constexpr std::size_t MinBatch = 8;
+
+            std::vector<std::unique_ptr<Finder>> _finders;
+            std::vector<Request> _requests;
+            std::vector<Request> _running;
+            std::vector<Result> _results;
+            std::unordered_map<int, Result> _done;
+            std::vector<std::future<void>> _workers;
+            int _next = 0;
+
+        public:
+            explicit Queue(unsigned int workers = std::thread::hardware_concurrency()) {
+                workers = std::max(1u, std::min(workers, 4u));
+                for(unsigned int i = 0; i < workers; i++) {
+                    _finders.push_back(std::make_unique<Finder>());
+                }
+            }
+
+            ~Queue() {
+                Collect();
+            }
+
+            // Returns the id the result will be under
+            int Add(std::shared_ptr<Blocked const> blocked, int x0, int y0, int x1, int y1) {
+                _requests.push_back(Request{ std::move(blocked), x0, y0, x1, y1, _next });
+                return _next++;
+            }
+
+            // Starts the requests added since the last call
+            void Start() {
+                Collect();
+                if(_requests.empty()) {
+                    return;
+                }
+                std::swap(_running, _requests);
+                _requests.clear();
+                _results.resize(_running.size());
+
+                auto workers = std::min(_finders.size(), (_running.size() + MinBatch - 1) / MinBatch);
+                auto per_worker = (_running.size() + workers - 1) / workers;
+                for(std::size_t w = 0; w < workers; w++) {
+                    auto first = w * per_worker;
+                    auto last = std::min(first + per_worker, _running.size());
+                    _workers.push_back(std::async(std::launch::async, [this, w, first, last]() {
+                        for(auto i = first; i < last; i++) {
+                            auto const& request = _running[i];
+                            _results[i].found = _finders[w]->Find(*request.blocked, request.x0, request.y0, request.x1, request.y1, _results[i].cells);
+                        }
+                    }));
+                }
+            }
+
+            // Waits for the running requests and makes their results available
+            void Collect() {
+                if(_workers.empty()) {
+                    return;
+                }
+                for(auto & worker : _workers) {
+                    worker.get();
+                }
+                _workers.clear();
+                for(std::size_t i = 0; i < _running.size(); i++) {
+                    _done[_running[i].id] = std::move(_results[i]);
+                }
+                _running.clear();
+            }
+
+            bool Done(int id) const {
+                return _done.count(id) != 0;
+            }
+
+            // Hands over a collected result, returns false if there is none under id
+            bool Take(int id, Result & result) {
+                auto found = _done.find(id);
+                if(found == _done.end()) {
+                    return false;
+                }
+                result = std::move(found->second);
+                _done.erase(found);
+                return true;
+            }
+        };
+
+    }
+
+}
@@ -5,6 +5,7 @@
 
 #include <nowide/iostream.hpp>
 #include <nowide/fstream.hpp>
+#include <nowide/cstdio.hpp>
 
 #include <randutils.hpp>
 
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace drak {
+
+    // Flushes file through to the disk, so that it survives a crash
+    inline bool SyncFile(std::FILE * file) {
+        if(std::fflush(file) != 0) {
+            return false;
+        }
+#ifdef _WIN32
+        return _commit(_fileno(file)) == 0;
+#else
+        return fsync(fileno(file)) == 0;
+#endif
+    }
+
+    // Write-behind persistence for the storage bank. The frame loop marks dirty pages and
+    // hands them over without waiting; a background thread coalesces them and rewrites the file
+    // (write to a temporary file, then rename) at most once per interval.
+    template <std::size_t Bytes, std::size_t PageSize = 4096>
+    class PersistentStorage {
+        static constexpr std::size_t Pages = (Bytes + PageSize - 1) / PageSize;
+        static_assert(Pages <= 64, "ERROR: PersistentStorage tracks at most 64 pages");
+
+        std::filesystem::path _path;
+        std::chrono::milliseconds _interval;
+
+        // Pages written by the frame loop since the last Commit (frame loop only)
+        std::uint64_t _dirty = 0;
+
+        // Pages copied into _staging that the flusher hasn't written yet
+        std::mutex _mutex;
+        std::condition_variable _wake;
+        std::array<unsigned char, Bytes> _staging;
+        std::uint64_t _pending = 0;
+        bool _stop = false;
+
+        std::array<unsigned char, Bytes> _file;
+        std::thread _flusher;
+
+    public:
+        PersistentStorage(std::filesystem::path path, unsigned char * bank, std::chrono::milliseconds interval = std::chrono::seconds(1))
+            : _path{std::move(path)}, _interval{interval} {
+            Read(bank);
+            _staging = _file;
+            std::memcpy(bank, _file.data(), Bytes);
+            _flusher = std::thread([this]() { Run(); });
+        }
+
+        PersistentStorage(PersistentStorage const&) = delete;
+        PersistentStorage & operator=(PersistentStorage const&) = delete;
+
+        // Stops the flusher after a final flush; pages that were never committed are lost, so
+        // owners Commit(bank, true) first
+        ~PersistentStorage() {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _wake.notify_one();
+            _flusher.join();
+        }
+
+        std::filesystem::path const& Path() const {
+            return _path;
+        }
+
+        void MarkDirty(std::size_t offset, std::size_t size) {
+            if(size == 0 || offset >= Bytes) {
+                return;
+            }
+            auto last = std::min(offset + size, Bytes) - 1;
+            for(auto page = offset / PageSize; page <= last / PageSize; page++) {
+                _dirty |= std::uint64_t(1) << page;
+            }
+        }
+
+        void MarkAllDirty() {
+            _dirty = Pages == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << Pages) - 1;
+        }
+
+        // Hands the dirty pages of the bank to the flusher. Unless wait is set this never
+        // blocks: if the flusher is busy copying, the pages stay dirty until the next call.
+        void Commit(unsigned char const* bank, bool wait = false) {
+            if(_dirty == 0) {
+                return;
+            }
+
+            std::unique_lock<std::mutex> lock(_mutex, std::defer_lock);
+            if(wait) {
+                lock.lock();
+            } else if(!lock.try_lock()) {
+                return;
+            }
+
+            CopyPages(_staging.data(), bank, _dirty);
+            _pending |= _dirty;
+            _dirty = 0;
+            lock.unlock();
+            _wake.notify_one();
+        }
+
+    private:
+        void CopyPages(unsigned char * dst, unsigned char const* src, std::uint64_t pages) {
+            for(std::size_t page = 0; page < Pages; page++) {
+                if(pages & (std::uint64_t(1) << page)) {
+                    auto offset = page * PageSize;
+                    std::memcpy(dst + offset, src + offset, std::min(PageSize, Bytes - offset));
+                }
+            }
+        }
+
+        void Read(unsigned char const* bank) {
+            std::memcpy(_file.data(), bank, Bytes);
+
+            nowide::ifstream in(_path.u8string().c_str(), std::ios::in | std::ios::binary);
+            if(in) {
+                in.read(reinterpret_cast<char *>(_file.data()), Bytes);
+            }
+        }
+
+        // Only renames the temporary file over the old one once it is on the disk, so a crash
+        // leaves either the old or the new file, never a truncated one
+        bool Write() {
+            auto temp = _path;
+            temp += ".tmp";
+
+            auto out = nowide::fopen(temp.u8string().c_str(), "wb");
+            if(!out) {
+                return false;
+            }
+            auto written = std::fwrite(_file.data(), 1, Bytes, out) == Bytes && SyncFile(out);
+            written = std::fclose(out) == 0 && written;
+            if(!written) {
+                return false;
+            }
+
+            std::error_code error;
+            std::filesystem::rename(temp, _path, error);
+            return !error;
+        }
+
+        void Run() {
+            auto last_flush = std::chrono::steady_clock::now() - _interval;
+
+            std::unique_lock<std::mutex> lock(_mutex);
+            for(;;) {
+                _wake.wait(lock, [this]() { return _pending != 0 || _stop; });
+
+                // Let writes pile up until the interval has passed, unless shutting down
+                if(!_stop) {
+                    _wake.wait_until(lock, last_flush + _interval, [this]() { return _stop; });
+                }
+
+                auto pages = _pending;
+                if(pages != 0) {
+                    CopyPages(_file.data(), _staging.data(), pages);
+                    _pending = 0;
+
+                    lock.unlock();
+                    auto written = Write();
+                    last_flush = std::chrono::steady_clock::now();
+                    lock.lock();
+
+                    if(!written) {
+                        nowide::cerr << "ERROR: Could not write storage to " << _path.u8string() << "\n";
+                        // Try again after the next interval, but don't hold up shutdown
+                        if(!_stop) {
+                            _pending |= pages;
+                        }
+                    }
+                }
+
+                if(_stop && _pending == 0) {
+                    return;
+                }
+            }
+        }
+    };
+
+}
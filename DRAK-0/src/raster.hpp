@@ -0,0 +1,763 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace drak {
+
+    // Draws into a one byte per pixel shadow of a 6bpp packed surface (the screen, or a sprite
+    // bank page used as a render target), so that spans are plain byte fills and copies. The packed
+    // surface (pixels least significant bits first, four pixels to a little endian 24-bit group of
+    // three bytes) is only rebuilt by Flush() when something reads it; after it has been written
+    // directly, Invalidate() makes the next draw reload the shadow. All shapes are broken into
+    // horizontal spans and clipped once.
+    class Rasterizer {
+    public:
+        // Size of the screen, the default surface
+        static constexpr int Width = 320;
+        static constexpr int Height = 240;
+        static constexpr int PixelBits = 6;
+        static constexpr int RowBytes = Width * PixelBits / 8;
+        static constexpr int Bytes = RowBytes * Height;
+
+        // Textures are 256x256 pages packed the same way as the screen
+        static constexpr int TextureSize = 256;
+
+        // Triangle corner in pixels, with texture coordinates in texels and depth for
+        // perspective correction (z > 0)
+        struct Vertex {
+            double x;
+            double y;
+            double u;
+            double v;
+            double z;
+        };
+
+    private:
+        // Triangle corners are snapped to 1/16 of a pixel
+        static constexpr int SubPixelBits = 4;
+        static constexpr int SubPixel = 1 << SubPixelBits;
+        // Perspective correct texturing divides once per this many pixels and steps affinely in between
+        static constexpr int PerspectiveStep = 16;
+
+        unsigned char * _surface;
+        int _width;
+        int _height;
+        std::vector<unsigned char> _pixels;
+        // The shadow has pixels the packed surface doesn't, or the other way round
+        bool _dirty = false;
+        bool _stale = true;
+        std::array<unsigned char, Width> _row;
+        // Source offsets of the destination columns of a stretched blit
+        std::array<int, Width> _columns;
+        // Blend table (source * 64 + dest) applied to everything drawn, or nullptr
+        unsigned char const* _blend = nullptr;
+        // 64 entry color remap applied to blits, or nullptr
+        unsigned char const* _remap = nullptr;
+        // Clip rectangle, left/top inclusive and right/bottom exclusive
+        int _clipLeft;
+        int _clipTop;
+        int _clipRight;
+        int _clipBottom;
+
+        static std::uint32_t Load24(unsigned char const* p) {
+            return std::uint32_t(p[0]) | (std::uint32_t(p[1]) << 8) | (std::uint32_t(p[2]) << 16);
+        }
+
+        static void Store24(unsigned char * p, std::uint32_t v) {
+            p[0] = static_cast<unsigned char>(v);
+            p[1] = static_cast<unsigned char>(v >> 8);
+            p[2] = static_cast<unsigned char>(v >> 16);
+        }
+
+        unsigned char const* Read() {
+            if(_stale) {
+                auto in = _surface;
+                auto out = _pixels.data();
+                for(int i = 0; i < _width * _height; i += 4, in += 3, out += 4) {
+                    auto group = Load24(in);
+                    out[0] = static_cast<unsigned char>(group & 63);
+                    out[1] = static_cast<unsigned char>((group >> 6) & 63);
+                    out[2] = static_cast<unsigned char>((group >> 12) & 63);
+                    out[3] = static_cast<unsigned char>(group >> 18);
+                }
+                _stale = false;
+            }
+            return _pixels.data();
+        }
+
+        unsigned char * Draw() {
+            Read();
+            _dirty = true;
+            return _pixels.data();
+        }
+
+        void Put(int index, int color) {
+            auto out = Draw() + index;
+            *out = _blend ? _blend[(color & 63) * 64 + *out] : static_cast<unsigned char>(color & 63);
+        }
+
+        // Fills x0..x1 of row y, both inclusive and already clipped
+        void Fill(int y, int x0, int x1, int color) {
+            auto out = Draw() + y * _width + x0;
+            auto n = x1 - x0 + 1;
+            if(!_blend) {
+                std::memset(out, color & 63, n);
+                return;
+            }
+            auto blend = _blend + (color & 63) * 64;
+            for(int i = 0; i < n; i++) {
+                out[i] = blend[out[i]];
+            }
+        }
+
+        // Writes colors to x0..x1 of row y (already clipped), skipping the key color (-1 for none).
+        // The key is tested before remapping.
+        void Blit(int y, int x0, int x1, unsigned char const* colors, int key) {
+            auto out = Draw() + y * _width + x0;
+            auto n = x1 - x0 + 1;
+            if(_remap) {
+                for(int i = 0; i < n; i++) {
+                    if(colors[i] != key) {
+                        auto color = _remap[colors[i]] & 63;
+                        out[i] = _blend ? _blend[color * 64 + out[i]] : static_cast<unsigned char>(color);
+                    }
+                }
+            } else if(_blend) {
+                for(int i = 0; i < n; i++) {
+                    out[i] = colors[i] == key ? out[i] : _blend[colors[i] * 64 + out[i]];
+                }
+            } else if(key < 0) {
+                std::memcpy(out, colors, n);
+            } else {
+                auto transparent = static_cast<unsigned char>(key);
+                for(int i = 0; i < n; i++) {
+                    out[i] = colors[i] == transparent ? out[i] : colors[i];
+                }
+            }
+        }
+
+        static int Texel(unsigned char const* texture, std::uint32_t u, std::uint32_t v) {
+            auto index = ((v >> 16) & (TextureSize - 1)) * TextureSize + ((u >> 16) & (TextureSize - 1));
+            return static_cast<int>((Load24(texture + (index >> 2) * 3) >> ((index & 3) * PixelBits)) & 63);
+        }
+
+        // u and v in 16.16 fixed point; wrapping around 32 bits is harmless since only the low
+        // 8 integer bits are used
+        static void Sample(unsigned char * out, int n, unsigned char const* texture, std::uint32_t u, std::uint32_t v, std::uint32_t du, std::uint32_t dv) {
+            for(int i = 0; i < n; i++) {
+                out[i] = static_cast<unsigned char>(Texel(texture, u, v));
+                u += du;
+                v += dv;
+            }
+        }
+
+        static std::uint32_t Fixed(double value) {
+            return static_cast<std::uint32_t>(static_cast<std::int64_t>(std::floor(value * 65536.0)));
+        }
+
+        static std::int64_t FloorDiv(std::int64_t a, std::int64_t b) {
+            return a >= 0 ? a / b : -((-a + b - 1) / b);
+        }
+
+        // Attribute a as a plane over the screen, sampled at pixel centers
+        struct Plane {
+            double a;
+            double dx;
+            double dy;
+
+            double At(int x, int y) const {
+                return a + (x + 0.5) * dx + (y + 0.5) * dy;
+            }
+        };
+
+        static Plane Gradient(double const (&x)[3], double const (&y)[3], double a0, double a1, double a2) {
+            auto area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+            Plane plane;
+            plane.dx = ((a1 - a0) * (y[2] - y[0]) - (a2 - a0) * (y[1] - y[0])) / area;
+            plane.dy = ((a2 - a0) * (x[1] - x[0]) - (a1 - a0) * (x[2] - x[0])) / area;
+            plane.a = a0 - x[0] * plane.dx - y[0] * plane.dy;
+            return plane;
+        }
+
+        // Calls span(y, x0, x1) for each row of the triangle inside the clip rectangle. A pixel is
+        // covered when its center is inside the triangle, or on a top or left edge, so triangles
+        // sharing an edge never overlap or leave gaps. The edge functions are evaluated in fixed
+        // point, once per edge and row, and solved for the first and last x instead of per pixel.
+        // Returns the snapped corners in pixels, or false for a degenerate triangle.
+        template <typename SpanFn>
+        bool TriangleSpans(std::array<Vertex, 3> const& vertices, double (&xs)[3], double (&ys)[3], SpanFn && span) const {
+            std::int64_t x[3];
+            std::int64_t y[3];
+            for(int i = 0; i < 3; i++) {
+                x[i] = std::llround(std::min(std::max(vertices[i].x, -32768.0), 32767.0) * SubPixel);
+                y[i] = std::llround(std::min(std::max(vertices[i].y, -32768.0), 32767.0) * SubPixel);
+                xs[i] = x[i] / double(SubPixel);
+                ys[i] = y[i] / double(SubPixel);
+            }
+
+            auto area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+            if(area == 0) {
+                return false;
+            }
+            // Clockwise on screen, so that the edge functions are positive inside
+            int order[3] = { 0, area > 0 ? 1 : 2, area > 0 ? 2 : 1 };
+
+            struct Edge {
+                std::int64_t step;      // per pixel to the right
+                std::int64_t rowStep;   // per row down
+                std::int64_t origin;    // at the center of pixel 0, 0
+                std::int64_t threshold; // 0 on top-left edges, 1 otherwise
+            } edges[3];
+
+            for(int i = 0; i < 3; i++) {
+                auto a = order[i];
+                auto b = order[(i + 1) % 3];
+                auto dx = x[b] - x[a];
+                auto dy = y[b] - y[a];
+                auto half = SubPixel / 2;
+                edges[i].step = -dy * SubPixel;
+                edges[i].rowStep = dx * SubPixel;
+                edges[i].origin = dx * (half - y[a]) - dy * (half - x[a]);
+                edges[i].threshold = (dy < 0 || (dy == 0 && dx > 0)) ? 0 : 1;
+            }
+
+            auto min_y = std::min({ y[0], y[1], y[2] });
+            auto max_y = std::max({ y[0], y[1], y[2] });
+            auto top = std::max<std::int64_t>(-FloorDiv(-(min_y - SubPixel / 2), SubPixel), _clipTop);
+            auto bottom = std::min<std::int64_t>(FloorDiv(max_y - SubPixel / 2, SubPixel), _clipBottom - 1);
+
+            for(auto row = top; row <= bottom; row++) {
+                std::int64_t first = _clipLeft;
+                std::int64_t last = _clipRight - 1;
+                for(auto const& edge : edges) {
+                    auto value = edge.origin + row * edge.rowStep;
+                    if(edge.step > 0) {
+                        first = std::max(first, -FloorDiv(value - edge.threshold, edge.step));
+                    } else if(edge.step < 0) {
+                        last = std::min(last, FloorDiv(value - edge.threshold, -edge.step));
+                    } else if(value < edge.threshold) {
+                        first = last + 1;
+                    }
+                }
+                if(first <= last) {
+                    span(static_cast<int>(row), static_cast<int>(first), static_cast<int>(last));
+                }
+            }
+            return true;
+        }
+
+        // Largest w with w^2 + dy^2 <= limit, the half width at dy of a disc (limit >= dy^2)
+        static std::int64_t HalfWidth(std::int64_t limit, std::int64_t dy) {
+            auto rest = limit - dy * dy;
+            auto w = static_cast<std::int64_t>(std::sqrt(static_cast<double>(rest)));
+            while(w * w > rest) {
+                w--;
+            }
+            while((w + 1) * (w + 1) <= rest) {
+                w++;
+            }
+            return w;
+        }
+
+        // Calls row(dy, w) with the half width w of the disc of radius r (pixels with
+        // dx^2 + dy^2 <= r^2 + r) for each dy in 0..r that puts row y - dy or y + dy inside the
+        // clip rectangle, so large discs cost no more than the rows they cover
+        template <typename Row>
+        void DiscRows(int y, int r, Row && row) const {
+            auto limit = std::int64_t(r) * r + r;
+            // dy putting y - dy, then y + dy, inside the clip rectangle
+            std::int64_t first[2] = { std::int64_t(y) - (_clipBottom - 1), std::int64_t(_clipTop) - y };
+            std::int64_t last[2] = { std::int64_t(y) - _clipTop, std::int64_t(_clipBottom - 1) - y };
+            if(first[1] < first[0]) {
+                std::swap(first[0], first[1]);
+                std::swap(last[0], last[1]);
+            }
+            auto next = std::int64_t(0);
+            for(int i = 0; i < 2; i++) {
+                auto end = std::min<std::int64_t>(last[i], r);
+                for(auto dy = std::max(first[i], next); dy <= end; dy++) {
+                    row(dy, HalfWidth(limit, dy));
+                }
+                next = std::max(next, end + 1);
+            }
+        }
+
+        // Pixel i along the major axis of a line with major and minor lengths major >= minor >= 0
+        // is floor((2 * i * minor + major) / (2 * major)) along the minor one: Bresenham's line,
+        // halfway points rounded away from the start. Steps through it from pixel i on without
+        // multiplying anything past 64 bits.
+        struct LineStep {
+            std::int64_t minor;
+            std::int64_t twiceMajor;
+            std::int64_t twiceMinor;
+            std::int64_t remainder;
+
+            LineStep(std::int64_t major, std::int64_t minor_length, std::int64_t i)
+                : twiceMajor{2 * major}, twiceMinor{2 * minor_length} {
+                // i * minor fits in 64 bits unsigned, twice it might not
+                auto product = static_cast<std::uint64_t>(i) * static_cast<std::uint64_t>(minor_length);
+                auto rest = static_cast<std::int64_t>(product % static_cast<std::uint64_t>(major)) * 2 + major;
+                minor = static_cast<std::int64_t>(product / static_cast<std::uint64_t>(major)) + rest / twiceMajor;
+                remainder = rest % twiceMajor;
+            }
+
+            void Next() {
+                remainder += twiceMinor;
+                if(remainder >= twiceMajor) {
+                    remainder -= twiceMajor;
+                    minor++;
+                }
+            }
+        };
+
+        // Steps through floor((2i + 1) * s / 2d), the source pixel under the center of destination
+        // pixel i when s pixels are stretched over d, from i = first on. The 32.32 fixed point
+        // values are rounded up, which keeps every step exact while (first + 1) * 2d < 2^32.
+        struct CenterStep {
+            std::uint64_t value;
+            std::uint64_t step;
+
+            CenterStep(int s, int d, int first) {
+                step = ((std::uint64_t(s) << 32) + d - 1) / d;
+                value = ((std::uint64_t(s) << 32) + 2 * d - 1) / (2 * d) + step * first;
+            }
+
+            int Next() {
+                auto result = static_cast<int>(value >> 32);
+                value += step;
+                return result;
+            }
+        };
+
+        static int Wrap(std::int64_t value, int size) {
+            return static_cast<int>(((value % size) + size) % size);
+        }
+
+        // Fills _row with n pixels of source pixels (in, in + step, ...) each repeated K times,
+        // starting at destination column first
+        template <int K>
+        void Expand(unsigned char const* in, int step, int first, int n) {
+            auto out = _row.data();
+            auto end = out + n;
+            in += (first / K) * step;
+            // The first source pixel may be partly clipped away
+            for(int j = first % K; j < K && out < end; j++) {
+                *out++ = *in;
+            }
+            in += step;
+            for(; end - out >= K; out += K, in += step) {
+                auto color = *in;
+                for(int j = 0; j < K; j++) {
+                    out[j] = color;
+                }
+            }
+            while(out < end) {
+                *out++ = *in;
+            }
+        }
+
+    public:
+        // width * height must be a multiple of 4, and width at most Width
+        explicit Rasterizer(unsigned char * surface, int width = Width, int height = Height)
+            : _surface{surface}, _width{width}, _height{height}, _pixels(width * height) {
+            Unclip();
+        }
+
+        int SurfaceWidth() const {
+            return _width;
+        }
+
+        int SurfaceHeight() const {
+            return _height;
+        }
+
+        // The packed surface was written directly, after a Flush() unless all of it was
+        void Invalidate() {
+            _stale = true;
+            _dirty = false;
+        }
+
+        // Brings the packed surface up to date with what was drawn
+        void Flush() {
+            if(!_dirty) {
+                return;
+            }
+            auto in = _pixels.data();
+            auto out = _surface;
+            for(int i = 0; i < _width * _height; i += 4, in += 4, out += 3) {
+                Store24(out, std::uint32_t(in[0]) | (std::uint32_t(in[1]) << 6) | (std::uint32_t(in[2]) << 12) | (std::uint32_t(in[3]) << 18));
+            }
+            _dirty = false;
+        }
+
+        // One byte per pixel, row by row
+        unsigned char const* Pixels() {
+            return Read();
+        }
+
+        // Restricts drawing to x, y, w, h (clamped to the surface)
+        void Clip(int x, int y, int w, int h) {
+            _clipLeft = std::min(std::max(x, 0), _width);
+            _clipTop = std::min(std::max(y, 0), _height);
+            _clipRight = static_cast<int>(std::max<std::int64_t>(std::min<std::int64_t>(std::int64_t(x) + std::max(w, 0), _width), _clipLeft));
+            _clipBottom = static_cast<int>(std::max<std::int64_t>(std::min<std::int64_t>(std::int64_t(y) + std::max(h, 0), _height), _clipTop));
+        }
+
+        void Unclip() {
+            Clip(0, 0, _width, _height);
+        }
+
+        // Blend everything drawn from now on through table (see BlendTables), nullptr to stop
+        void Blend(unsigned char const* table) {
+            _blend = table;
+        }
+
+        // Remap blitted colors through table (64 entries), nullptr to draw them as they are
+        void Remap(unsigned char const* table) {
+            _remap = table;
+        }
+
+        // Ignores the clip rectangle and blending
+        void Clear(int color) {
+            // Every pixel is replaced, so there's nothing to reload
+            std::memset(_pixels.data(), color & 63, _pixels.size());
+            _stale = false;
+            _dirty = true;
+        }
+
+        int Get(int x, int y) {
+            if(x < 0 || y < 0 || x >= _width || y >= _height) {
+                return 0;
+            }
+            return Read()[y * _width + x];
+        }
+
+        void Pixel(int x, int y, int color) {
+            if(x >= _clipLeft && x < _clipRight && y >= _clipTop && y < _clipBottom) {
+                Put(y * _width + x, color);
+            }
+        }
+
+        // Pixel() for n pixels at once, xs[i], ys[i] in colors[i]
+        void Plot(int n, int const* xs, int const* ys, unsigned char const* colors) {
+            auto out = Draw();
+            for(int i = 0; i < n; i++) {
+                if(xs[i] >= _clipLeft && xs[i] < _clipRight && ys[i] >= _clipTop && ys[i] < _clipBottom) {
+                    auto pixel = out + ys[i] * _width + xs[i];
+                    auto color = colors[i] & 63;
+                    *pixel = _blend ? _blend[color * 64 + *pixel] : static_cast<unsigned char>(color);
+                }
+            }
+        }
+
+        // The one place spans are clipped, x0 to x1 inclusive (empty if x0 > x1). Coordinates are
+        // 64-bit so that shapes reaching past the int range clip instead of overflowing.
+        void Span(std::int64_t y, std::int64_t x0, std::int64_t x1, int color) {
+            if(y < _clipTop || y >= _clipBottom) {
+                return;
+            }
+            x0 = std::max<std::int64_t>(x0, _clipLeft);
+            x1 = std::min<std::int64_t>(x1, _clipRight - 1);
+            if(x0 <= x1) {
+                Fill(static_cast<int>(y), static_cast<int>(x0), static_cast<int>(x1), color);
+            }
+        }
+
+        void Rect(int x, int y, int w, int h, int color) {
+            if(w <= 0 || h <= 0) {
+                return;
+            }
+            auto top = std::max<std::int64_t>(y, _clipTop);
+            auto bottom = std::min<std::int64_t>(std::int64_t(y) + h, _clipBottom);
+            for(auto row = top; row < bottom; row++) {
+                Span(row, x, std::int64_t(x) + w - 1, color);
+            }
+        }
+
+        void RectB(int x, int y, int w, int h, int color) {
+            if(w <= 0 || h <= 0) {
+                return;
+            }
+            auto right = std::int64_t(x) + w - 1;
+            auto bottom = std::int64_t(y) + h - 1;
+            Span(y, x, right, color);
+            if(h > 1) {
+                Span(bottom, x, right, color);
+            }
+            auto first = std::max<std::int64_t>(std::int64_t(y) + 1, _clipTop);
+            auto last = std::min<std::int64_t>(bottom, _clipBottom);
+            for(auto row = first; row < last; row++) {
+                Span(row, x, x, color);
+                if(w > 1) {
+                    Span(row, right, right, color);
+                }
+            }
+        }
+
+        // Bresenham (see LineStep), with the pixels of each row merged into one span. Only the
+        // pixels whose major axis coordinate is inside the clip rectangle are stepped through.
+        void Line(int x0, int y0, int x1, int y1, int color) {
+            if(std::max(x0, x1) < _clipLeft || std::min(x0, x1) >= _clipRight ||
+               std::max(y0, y1) < _clipTop || std::min(y0, y1) >= _clipBottom) {
+                return;
+            }
+
+            auto dx = std::abs(std::int64_t(x1) - x0);
+            auto dy = std::abs(std::int64_t(y1) - y0);
+            auto sx = x0 < x1 ? 1 : -1;
+            auto sy = y0 < y1 ? 1 : -1;
+            if(dx == 0 && dy == 0) {
+                Span(y0, x0, x0, color);
+                return;
+            }
+
+            // Pixels first..last along the major axis, from the start, are inside the clip
+            // rectangle on that axis
+            auto major_x = dx >= dy;
+            auto start = major_x ? x0 : y0;
+            auto step = major_x ? sx : sy;
+            auto low = major_x ? _clipLeft : _clipTop;
+            auto high = (major_x ? _clipRight : _clipBottom) - 1;
+            auto first = std::max<std::int64_t>(step > 0 ? low - std::int64_t(start) : std::int64_t(start) - high, 0);
+            auto last = std::min<std::int64_t>(step > 0 ? high - std::int64_t(start) : std::int64_t(start) - low, major_x ? dx : dy);
+            if(first > last) {
+                return;
+            }
+
+            LineStep minor(major_x ? dx : dy, major_x ? dy : dx, first);
+            if(!major_x) {
+                for(auto i = first; i <= last; i++, minor.Next()) {
+                    auto x = x0 + sx * minor.minor;
+                    Span(y0 + sy * i, x, x, color);
+                }
+                return;
+            }
+
+            // Pixels a..b of the line, all on one row
+            auto run = [&](std::int64_t row, std::int64_t a, std::int64_t b) {
+                auto xa = x0 + sx * a;
+                auto xb = x0 + sx * b;
+                Span(y0 + sy * row, std::min(xa, xb), std::max(xa, xb), color);
+            };
+            auto row = minor.minor;
+            auto run_start = first;
+            for(auto i = first; i <= last; i++, minor.Next()) {
+                if(minor.minor != row) {
+                    run(row, run_start, i - 1);
+                    row = minor.minor;
+                    run_start = i;
+                }
+            }
+            run(row, run_start, last);
+        }
+
+        // Filled disc, the pixels with dx^2 + dy^2 <= r^2 + r
+        void Circ(int x, int y, int r, int color) {
+            if(r < 0 || std::int64_t(x) + r < _clipLeft || std::int64_t(x) - r >= _clipRight ||
+               std::int64_t(y) + r < _clipTop || std::int64_t(y) - r >= _clipBottom) {
+                return;
+            }
+            DiscRows(y, r, [&](std::int64_t dy, std::int64_t w) {
+                Span(y - dy, x - w, x + w, color);
+                if(dy != 0) {
+                    Span(y + dy, x - w, x + w, color);
+                }
+            });
+        }
+
+        // Outline: the disc of radius r minus the disc of radius r - 1
+        void CircB(int x, int y, int r, int color) {
+            if(r < 0 || std::int64_t(x) + r < _clipLeft || std::int64_t(x) - r >= _clipRight ||
+               std::int64_t(y) + r < _clipTop || std::int64_t(y) - r >= _clipBottom) {
+                return;
+            }
+
+            auto inner_limit = std::int64_t(r - 1) * (r - 1) + (r - 1);
+            DiscRows(y, r, [&](std::int64_t dy, std::int64_t w) {
+                auto inner = dy <= r - 1 ? HalfWidth(inner_limit, dy) : -1;
+                auto row = [&](std::int64_t ry) {
+                    if(inner < 0) {
+                        Span(ry, x - w, x + w, color);
+                    } else {
+                        Span(ry, x - w, x - inner - 1, color);
+                        Span(ry, x + inner + 1, x + w, color);
+                    }
+                };
+                row(y - dy);
+                if(dy != 0) {
+                    row(y + dy);
+                }
+            });
+        }
+
+        void Tri(std::array<Vertex, 3> const& vertices, int color) {
+            double xs[3];
+            double ys[3];
+            TriangleSpans(vertices, xs, ys, [&](int y, int x0, int x1) {
+                Fill(y, x0, x1, color);
+            });
+        }
+
+        // Maps texture (a packed page) onto the triangle, u and v wrapping around it. key is a
+        // transparent color or -1. With perspective, u/z, v/z and 1/z are interpolated instead of
+        // u and v, dividing every PerspectiveStep pixels.
+        void TexTri(std::array<Vertex, 3> const& vertices, unsigned char const* texture, int key, bool perspective) {
+            double xs[3];
+            double ys[3];
+            Plane u;
+            Plane v;
+            Plane q;
+            bool planes = false;
+
+            TriangleSpans(vertices, xs, ys, [&](int y, int x0, int x1) {
+                if(!planes) {
+                    auto w = [&](int i) { return perspective ? 1.0 / vertices[i].z : 1.0; };
+                    u = Gradient(xs, ys, vertices[0].u * w(0), vertices[1].u * w(1), vertices[2].u * w(2));
+                    v = Gradient(xs, ys, vertices[0].v * w(0), vertices[1].v * w(1), vertices[2].v * w(2));
+                    q = Gradient(xs, ys, w(0), w(1), w(2));
+                    planes = true;
+                }
+
+                auto n = x1 - x0 + 1;
+                if(!perspective) {
+                    Sample(_row.data(), n, texture, Fixed(u.At(x0, y)), Fixed(v.At(x0, y)), Fixed(u.dx), Fixed(v.dx));
+                } else {
+                    auto uq = u.At(x0, y);
+                    auto vq = v.At(x0, y);
+                    auto qq = q.At(x0, y);
+                    auto su = uq / qq;
+                    auto sv = vq / qq;
+                    for(int i = 0; i < n; i += PerspectiveStep) {
+                        auto len = std::min(PerspectiveStep, n - i);
+                        uq += u.dx * len;
+                        vq += v.dx * len;
+                        qq += q.dx * len;
+                        auto eu = uq / qq;
+                        auto ev = vq / qq;
+                        Sample(_row.data() + i, len, texture, Fixed(su), Fixed(sv), Fixed((eu - su) / len), Fixed((ev - sv) / len));
+                        su = eu;
+                        sv = ev;
+                    }
+                }
+                Blit(y, x0, x1, _row.data(), key);
+            });
+        }
+
+        // For every row of the clip rectangle, fill(y, x0, n, out) writes the n colors from x0 on
+        // into out and returns the row's transparent color (-1 for none), or SkipRow to not draw it
+        static constexpr int SkipRow = -2;
+
+        template <typename F>
+        void Generate(F fill) {
+            auto n = _clipRight - _clipLeft;
+            if(n <= 0) {
+                return;
+            }
+            for(int y = _clipTop; y < _clipBottom; y++) {
+                auto key = fill(y, _clipLeft, n, _row.data());
+                if(key != SkipRow) {
+                    Blit(y, _clipLeft, _clipRight - 1, _row.data(), key);
+                }
+            }
+        }
+
+        // Draws the sw x sh region at sx, sy of source (wrapping around it) stretched over dw x dh
+        // at dx, dy, mirrored if asked, skipping the key color (-1 for none). Each destination
+        // pixel shows the source pixel under its center; sizes up to 256 stretched up to 32768 are
+        // exact. Rows that show the same source row are only fetched once, and exact 2x, 3x and 4x
+        // widths repeat pixels instead of looking up every column.
+        void Stretch(Rasterizer & source, int sx, int sy, int sw, int sh, int dx, int dy, int dw, int dh, bool flipX, bool flipY, int key) {
+            if(sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0) {
+                return;
+            }
+            auto x0 = std::max(dx, _clipLeft);
+            auto x1 = static_cast<int>(std::min<std::int64_t>(std::int64_t(dx) + dw, _clipRight));
+            auto y0 = std::max(dy, _clipTop);
+            auto y1 = static_cast<int>(std::min<std::int64_t>(std::int64_t(dy) + dh, _clipBottom));
+            if(x0 >= x1 || y0 >= y1) {
+                return;
+            }
+            // How far into the destination the clipped corner is, less than dw and dh here
+            auto skipX = static_cast<int>(std::int64_t(x0) - dx);
+            auto skipY = static_cast<int>(std::int64_t(y0) - dy);
+
+            auto pixels = source.Read();
+            auto n = x1 - x0;
+            // Exact multiples of a region that doesn't wrap around are stepped through directly
+            auto left = Wrap(sx, source._width);
+            auto scale = dw % sw == 0 && sw <= source._width - left ? dw / sw : 0;
+            auto first = flipX ? left + sw - 1 : left;
+            auto step = flipX ? -1 : 1;
+            if(scale < 2 || scale > 4) {
+                CenterStep columns(sw, dw, skipX);
+                for(int i = 0; i < n; i++) {
+                    auto u = columns.Next();
+                    _columns[i] = Wrap(std::int64_t(sx) + (flipX ? sw - 1 - u : u), source._width);
+                }
+            }
+
+            CenterStep rows(sh, dh, skipY);
+            auto previous = -1;
+            for(int y = y0; y < y1; y++) {
+                auto v = rows.Next();
+                auto row = Wrap(std::int64_t(sy) + (flipY ? sh - 1 - v : v), source._height);
+                if(row != previous) {
+                    auto in = pixels + row * source._width;
+                    switch(scale) {
+                    case 2: Expand<2>(in + first, step, skipX, n); break;
+                    case 3: Expand<3>(in + first, step, skipX, n); break;
+                    case 4: Expand<4>(in + first, step, skipX, n); break;
+                    default:
+                        for(int i = 0; i < n; i++) {
+                            _row[i] = in[_columns[i]];
+                        }
+                        break;
+                    }
+                    previous = row;
+                }
+                Blit(y, x0, x1 - 1, _row.data(), key);
+            }
+        }
+
+        // Copies the w x h region at sx, sy of source (which may be this rasterizer) to dx, dy,
+        // skipping the key color (-1 for none)
+        void Copy(Rasterizer & source, int sx, int sy, int w, int h, int dx, int dy, int key) {
+            // Clip to the source surface and then to the clip rectangle, moving both corners together
+            // (in 64 bits, corners and sizes may be anything an int holds)
+            auto left = std::max<std::int64_t>(std::max(-std::int64_t(sx), std::int64_t(_clipLeft) - dx), 0);
+            auto top = std::max<std::int64_t>(std::max(-std::int64_t(sy), std::int64_t(_clipTop) - dy), 0);
+            auto width = std::min(std::min(w - left, source._width - (sx + left)), _clipRight - (dx + left));
+            auto height = std::min(std::min(h - top, source._height - (sy + top)), _clipBottom - (dy + top));
+            if(width <= 0 || height <= 0) {
+                return;
+            }
+            // Now both corners are on their surfaces
+            sx = static_cast<int>(sx + left);
+            dx = static_cast<int>(dx + left);
+            sy = static_cast<int>(sy + top);
+            dy = static_cast<int>(dy + top);
+            w = static_cast<int>(width);
+            h = static_cast<int>(height);
+
+            auto pixels = source.Read();
+            auto self = &source == this;
+            for(int i = 0; i < h; i++) {
+                // Copying within one surface goes through _row, bottom up when moving down
+                auto row = self && dy > sy ? h - 1 - i : i;
+                auto from = pixels + (sy + row) * source._width + sx;
+                if(self) {
+                    std::memcpy(_row.data(), from, w);
+                    from = _row.data();
+                }
+                Blit(dy + row, dx, dx + w - 1, from, key);
+            }
+        }
+    };
+
+}
@@ -0,0 +1,527 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "buffer.hpp"
+
+namespace drak {
+
+    namespace delta {
+
+        inline void PutVarint(std::vector<unsigned char> & out, std::size_t value) {
+            while(value >= 0x80) {
+                out.push_back(static_cast<unsigned char>(value | 0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<unsigned char>(value));
+        }
+
+        inline std::size_t GetVarint(unsigned char const*& in) {
+            std::size_t value = 0;
+            for(unsigned int shift = 0; ; shift += 7) {
+                auto byte = *in++;
+                value |= std::size_t(byte & 0x7F) << shift;
+                if((byte & 0x80) == 0) {
+                    return value;
+                }
+            }
+        }
+
+        // Appends cur XOR prev as (unchanged run, changed run, changed bytes...) records. A
+        // changed run only ends at two unchanged bytes in a row so lone matches stay literal.
+        inline void EncodeXorRle(unsigned char const* cur, unsigned char const* prev, std::size_t size, std::vector<unsigned char> & out) {
+            std::size_t i = 0;
+            while(i < size) {
+                auto changed = i;
+                while(changed < size && cur[changed] == prev[changed]) {
+                    changed++;
+                }
+                auto end = changed;
+                while(end < size && !(cur[end] == prev[end] && (end + 1 == size || cur[end + 1] == prev[end + 1]))) {
+                    end++;
+                }
+
+                PutVarint(out, changed - i);
+                PutVarint(out, end - changed);
+                for(auto j = changed; j < end; j++) {
+                    out.push_back(cur[j] ^ prev[j]);
+                }
+                i = end;
+            }
+        }
+
+        // XORs an encoded page back into data, which turns either side of the delta into the other
+        inline void ApplyXorRle(unsigned char const* in, unsigned char const* in_end, unsigned char * data) {
+            while(in < in_end) {
+                data += GetVarint(in);
+                auto changed = GetVarint(in);
+                for(std::size_t j = 0; j < changed; j++) {
+                    *data++ ^= *in++;
+                }
+            }
+        }
+
+    }
+
+    // Script variables visible from the top level of a cartridge, written into a byte image (see
+    // ScriptWriter) so that the running script can't modify them after the fact, and so that the
+    // images of consecutive frames delta-encode like memory. Constants (like the *_type globals)
+    // are left out, they can't change.
+    struct ScriptState {
+        // (local, name, value) records
+        std::vector<unsigned char> image;
+        // Values the image refers to by index: used as they are, copied again on every restore,
+        // and one instance with undefined attributes per script class shape
+        std::vector<chaiscript::Boxed_Value> shared;
+        std::vector<chaiscript::Boxed_Value> cloned;
+        std::vector<chaiscript::dispatch::Dynamic_Object> shapes;
+    };
+
+    // A full copy of the console: every memory bank plus the script variables
+    struct SaveState {
+        std::vector<unsigned char> memory;
+        ScriptState script;
+    };
+
+    using CloneFunction = std::function<chaiscript::Boxed_Value(chaiscript::Boxed_Value const&)>;
+
+    // A Boxed_Value and the block holding its data, roughly
+    constexpr std::size_t BoxedBytes = 64;
+
+    // Copies a value the image can't hold: numbers of other types than double and int, buffer
+    // views (which still look at the same console memory, saved with the rest) and anything the
+    // script's clone() knows. Throws for values with no clone() (functions, ...).
+    inline chaiscript::Boxed_Value CopyValue(chaiscript::Boxed_Value const& value, CloneFunction const& clone) {
+        using namespace chaiscript;
+
+        auto const& type = value.get_type_info();
+        if(type.is_arithmetic()) {
+            return Boxed_Number(value).get_as(type).bv;
+        }
+        if(type.bare_equal(user_type<Buffer>())) {
+            return Boxed_Value(std::make_shared<Buffer>(boxed_cast<Buffer const&>(value)));
+        }
+        return clone(value);
+    }
+
+    // What follows each tag in a script image
+    enum class ValueTag : unsigned char {
+        Constant,   // index into shared: undefined, null or const, used as it is
+        Shared,     // index into shared: no clone(), used as it is
+        Cloned,     // index into cloned
+        Reference,  // id of a value written earlier in the same image
+        Double,     // 8 bytes
+        Int,        // 4 bytes
+        False,
+        True,
+        String,     // size, bytes
+        Vector,     // size, values
+        Map,        // size, (key size, key bytes, value) records
+        Buffer,     // element type, size, elements as stored
+        Object,     // index into shapes, explicit, one value per attribute
+    };
+
+    // Writes script variables into a ScriptState in one pass. Every string, container, buffer and
+    // object gets an id the first time it is reached (in writing order) and is written as a
+    // Reference after that, so values shared between variables stay shared and cycles end.
+    // Doubles, ints and booleans are written by value.
+    class ScriptWriter {
+        ScriptState & _state;
+        CloneFunction const& _clone;
+        std::unordered_map<void const*, std::size_t> _ids;
+        std::unordered_map<chaiscript::dispatch::Dynamic_Object_Shape const*, std::size_t> _shapes;
+
+        void Put(ValueTag tag) {
+            _state.image.push_back(static_cast<unsigned char>(tag));
+        }
+
+        void PutBytes(void const* data, std::size_t size) {
+            auto bytes = static_cast<unsigned char const*>(data);
+            _state.image.insert(_state.image.end(), bytes, bytes + size);
+        }
+
+        void PutString(std::string const& text) {
+            delta::PutVarint(_state.image, text.size());
+            PutBytes(text.data(), text.size());
+        }
+
+        // Writes a Reference if object was reached before, otherwise gives it the next id
+        bool Seen(void const* object) {
+            auto id = _ids.emplace(object, _ids.size());
+            if(!id.second) {
+                Put(ValueTag::Reference);
+                delta::PutVarint(_state.image, id.first->second);
+            }
+            return !id.second;
+        }
+
+        std::size_t Shape(chaiscript::dispatch::Dynamic_Object const& object) {
+            auto index = _shapes.emplace(object.get_shape().get(), _state.shapes.size());
+            if(index.second) {
+                _state.shapes.push_back(object);
+                for(std::size_t slot = 0; slot < object.get_shape()->size(); slot++) {
+                    _state.shapes.back().get_slot(slot) = chaiscript::Boxed_Value();
+                }
+            }
+            return index.first->second;
+        }
+
+    public:
+        ScriptWriter(ScriptState & state, CloneFunction const& clone)
+            : _state{state}, _clone{clone} { }
+
+        void Write(std::string const& name, bool local, chaiscript::Boxed_Value const& value) {
+            _state.image.push_back(local ? 1 : 0);
+            PutString(name);
+            Write(value);
+        }
+
+        void Write(chaiscript::Boxed_Value const& value) {
+            using namespace chaiscript;
+
+            if(value.is_undef() || value.is_const() || value.is_null()) {
+                Put(ValueTag::Constant);
+                delta::PutVarint(_state.image, _state.shared.size());
+                _state.shared.push_back(value);
+                return;
+            }
+
+            // Scripts mostly use these, checked first and read in place
+            auto const& type = value.get_type_info();
+            auto data = value.get_const_ptr();
+            if(type.bare_equal(user_type<double>())) {
+                Put(ValueTag::Double);
+                PutBytes(data, sizeof(double));
+                return;
+            }
+            if(type.bare_equal(user_type<int>())) {
+                Put(ValueTag::Int);
+                PutBytes(data, sizeof(int));
+                return;
+            }
+            if(type.bare_equal(user_type<bool>())) {
+                Put(*static_cast<bool const*>(data) ? ValueTag::True : ValueTag::False);
+                return;
+            }
+            if(Seen(data)) {
+                return;
+            }
+
+            if(type.bare_equal(user_type<std::string>())) {
+                Put(ValueTag::String);
+                PutString(*static_cast<std::string const*>(data));
+            } else if(type.bare_equal(user_type<std::vector<Boxed_Value>>())) {
+                auto const& elements = *static_cast<std::vector<Boxed_Value> const*>(data);
+                Put(ValueTag::Vector);
+                delta::PutVarint(_state.image, elements.size());
+                for(auto const& element : elements) {
+                    Write(element);
+                }
+            } else if(type.bare_equal(user_type<std::map<std::string, Boxed_Value>>())) {
+                auto const& elements = *static_cast<std::map<std::string, Boxed_Value> const*>(data);
+                Put(ValueTag::Map);
+                delta::PutVarint(_state.image, elements.size());
+                for(auto const& element : elements) {
+                    PutString(element.first);
+                    Write(element.second);
+                }
+            } else if(type.bare_equal(user_type<Buffer>()) && !static_cast<Buffer const*>(data)->IsView()) {
+                auto const& buffer = *static_cast<Buffer const*>(data);
+                Put(ValueTag::Buffer);
+                _state.image.push_back(static_cast<unsigned char>(buffer.Type()));
+                delta::PutVarint(_state.image, buffer.Size());
+                PutBytes(buffer.Data(), buffer.Size() * Buffer::ElementSize(buffer.Type()));
+            } else if(type.bare_equal(user_type<dispatch::Dynamic_Object>())) {
+                auto const& object = *static_cast<dispatch::Dynamic_Object const*>(data);
+                Put(ValueTag::Object);
+                delta::PutVarint(_state.image, Shape(object));
+                _state.image.push_back(object.is_explicit() ? 1 : 0);
+                for(std::size_t slot = 0; slot < object.get_shape()->size(); slot++) {
+                    Write(object.get_slot(slot));
+                }
+            } else {
+                try {
+                    auto copy = CopyValue(value, _clone);
+                    Put(ValueTag::Cloned);
+                    delta::PutVarint(_state.image, _state.cloned.size());
+                    _state.cloned.push_back(copy);
+                } catch(...) {
+                    Put(ValueTag::Shared);
+                    delta::PutVarint(_state.image, _state.shared.size());
+                    _state.shared.push_back(value);
+                }
+            }
+        }
+    };
+
+    // Turns a ScriptState back into values, new ones every time
+    class ScriptReader {
+        ScriptState const& _state;
+        CloneFunction const& _clone;
+        unsigned char const* _in;
+        unsigned char const* _end;
+        // By id, see ScriptWriter
+        std::vector<chaiscript::Boxed_Value> _values;
+
+        chaiscript::Boxed_Value const& Track(chaiscript::Boxed_Value value) {
+            _values.push_back(std::move(value));
+            return _values.back();
+        }
+
+        std::string GetString() {
+            auto size = delta::GetVarint(_in);
+            std::string text(reinterpret_cast<char const*>(_in), size);
+            _in += size;
+            return text;
+        }
+
+    public:
+        ScriptReader(ScriptState const& state, CloneFunction const& clone)
+            : _state{state}, _clone{clone}, _in{state.image.data()}, _end{state.image.data() + state.image.size()} { }
+
+        // The next variable, false after the last one
+        bool Next(bool & local, std::string & name, chaiscript::Boxed_Value & value) {
+            if(_in == _end) {
+                return false;
+            }
+            local = *_in++ != 0;
+            name = GetString();
+            value = Read();
+            return true;
+        }
+
+        chaiscript::Boxed_Value Read() {
+            using namespace chaiscript;
+
+            switch(static_cast<ValueTag>(*_in++)) {
+            case ValueTag::Constant:
+                return _state.shared[delta::GetVarint(_in)];
+            case ValueTag::Shared:
+                return Track(_state.shared[delta::GetVarint(_in)]);
+            case ValueTag::Cloned:
+                return Track(CopyValue(_state.cloned[delta::GetVarint(_in)], _clone));
+            case ValueTag::Reference:
+                return _values[delta::GetVarint(_in)];
+            case ValueTag::Double: {
+                double number;
+                std::memcpy(&number, _in, sizeof(double));
+                _in += sizeof(double);
+                return Boxed_Value(number);
+            }
+            case ValueTag::Int: {
+                int number;
+                std::memcpy(&number, _in, sizeof(int));
+                _in += sizeof(int);
+                return Boxed_Value(number);
+            }
+            case ValueTag::False:
+                return Boxed_Value(false);
+            case ValueTag::True:
+                return Boxed_Value(true);
+            case ValueTag::String:
+                return Track(Boxed_Value(GetString()));
+            case ValueTag::Vector: {
+                // Tracked before the elements are read, which may refer to it
+                auto size = delta::GetVarint(_in);
+                auto result = Track(Boxed_Value(std::vector<Boxed_Value>()));
+                auto & elements = *static_cast<std::vector<Boxed_Value> *>(result.get_ptr());
+                elements.reserve(size);
+                for(std::size_t i = 0; i < size; i++) {
+                    elements.push_back(Read());
+                }
+                return result;
+            }
+            case ValueTag::Map: {
+                auto size = delta::GetVarint(_in);
+                auto result = Track(Boxed_Value(std::map<std::string, Boxed_Value>()));
+                auto & elements = *static_cast<std::map<std::string, Boxed_Value> *>(result.get_ptr());
+                for(std::size_t i = 0; i < size; i++) {
+                    auto key = GetString();
+                    elements.emplace_hint(elements.end(), std::move(key), Read());
+                }
+                return result;
+            }
+            case ValueTag::Buffer: {
+                auto type = static_cast<ElementType>(*_in++);
+                auto size = static_cast<int>(delta::GetVarint(_in));
+                auto buffer = std::make_shared<Buffer>(type, size);
+                auto bytes = size * Buffer::ElementSize(type);
+                std::memcpy(buffer->Data(), _in, bytes);
+                _in += bytes;
+                return Track(Boxed_Value(buffer));
+            }
+            case ValueTag::Object: {
+                auto object = std::make_shared<dispatch::Dynamic_Object>(_state.shapes[delta::GetVarint(_in)]);
+                object->set_explicit(*_in++ != 0);
+                auto result = Track(Boxed_Value(object));
+                for(std::size_t slot = 0; slot < object->get_shape()->size(); slot++) {
+                    object->get_slot(slot) = Read();
+                }
+                return result;
+            }
+            }
+            return Boxed_Value();
+        }
+    };
+
+    // Ring of per-frame console states for rewinding. Only the pages that changed since the
+    // previous frame are kept, XOR-delta and run-length encoded, and the script image the same
+    // way against the previous frame's. Both count towards max_bytes.
+    template <std::size_t Bytes, std::size_t PageSize = 1024>
+    class RewindBuffer {
+        static constexpr std::size_t Pages = (Bytes + PageSize - 1) / PageSize;
+
+        struct Frame {
+            // (page, encoded size, encoded page) records turning the previous frame into this one
+            std::vector<unsigned char> delta;
+            // Size of the previous frame's script image, then the encoded image turning this
+            // frame's into it (the shorter of the two padded with zeros)
+            std::vector<unsigned char> scriptDelta;
+            // Without its image, see _lastImage
+            ScriptState script;
+        };
+
+        std::deque<Frame> _frames;
+        // Memory and script image as of the newest frame
+        std::unique_ptr<std::array<unsigned char, Bytes>> _last;
+        std::vector<unsigned char> _lastImage;
+        std::size_t _maxFrames;
+        std::size_t _maxBytes;
+        std::size_t _bytes = 0;
+
+        static std::size_t FrameBytes(Frame const& frame) {
+            auto const& script = frame.script;
+            return frame.delta.size() + frame.scriptDelta.size()
+                + (script.shared.size() + script.cloned.size() + script.shapes.size()) * BoxedBytes;
+        }
+
+    public:
+        RewindBuffer(std::size_t max_frames = 0, std::size_t max_bytes = 4 * 1024 * 1024)
+            : _maxFrames{max_frames}, _maxBytes{max_bytes} { }
+
+        void SetLimits(std::size_t max_frames, std::size_t max_bytes) {
+            _maxFrames = max_frames;
+            _maxBytes = max_bytes;
+            Trim();
+        }
+
+        bool Enabled() const {
+            return _maxFrames > 0;
+        }
+
+        std::size_t Frames() const {
+            return _frames.size();
+        }
+
+        // Encoded memory and script images held by the buffer, the full copies of the newest
+        // frame's excluded
+        std::size_t DeltaBytes() const {
+            return _bytes;
+        }
+
+        void Clear() {
+            _frames.clear();
+            _last.reset();
+            _lastImage.clear();
+            _bytes = 0;
+        }
+
+        void Capture(std::array<unsigned char, Bytes> const& memory, ScriptState script) {
+            Frame frame;
+
+            if(!_last) {
+                _last = std::make_unique<std::array<unsigned char, Bytes>>(memory);
+            } else {
+                for(std::size_t page = 0; page < Pages; page++) {
+                    auto offset = page * PageSize;
+                    auto size = std::min(PageSize, Bytes - offset);
+                    auto cur = memory.data() + offset;
+                    auto prev = _last->data() + offset;
+                    if(std::memcmp(cur, prev, size) != 0) {
+                        std::vector<unsigned char> encoded;
+                        delta::EncodeXorRle(cur, prev, size, encoded);
+                        delta::PutVarint(frame.delta, page);
+                        delta::PutVarint(frame.delta, encoded.size());
+                        frame.delta.insert(frame.delta.end(), encoded.begin(), encoded.end());
+                        std::memcpy(prev, cur, size);
+                    }
+                }
+                frame.delta.shrink_to_fit();
+
+                auto & image = script.image;
+                auto size = image.size();
+                auto padded = std::max(size, _lastImage.size());
+                delta::PutVarint(frame.scriptDelta, _lastImage.size());
+                image.resize(padded);
+                _lastImage.resize(padded);
+                delta::EncodeXorRle(image.data(), _lastImage.data(), padded, frame.scriptDelta);
+                image.resize(size);
+                frame.scriptDelta.shrink_to_fit();
+            }
+
+            _lastImage.swap(script.image);
+            script.image = {};
+            frame.script = std::move(script);
+            _bytes += FrameBytes(frame);
+            _frames.push_back(std::move(frame));
+            Trim();
+        }
+
+        // Drops up to frames of the newest frames, always keeping the oldest one. Returns how many
+        // frames were dropped; Restore() then yields the new newest frame.
+        std::size_t StepBack(std::size_t frames) {
+            std::size_t stepped = 0;
+            for(; stepped < frames && _frames.size() >= 2; stepped++) {
+                auto const& delta = _frames.back().delta;
+                auto in = delta.data();
+                auto end = in + delta.size();
+                while(in < end) {
+                    auto page = delta::GetVarint(in);
+                    auto size = delta::GetVarint(in);
+                    delta::ApplyXorRle(in, in + size, _last->data() + page * PageSize);
+                    in += size;
+                }
+
+                auto const& scriptDelta = _frames.back().scriptDelta;
+                auto script = scriptDelta.data();
+                auto size = delta::GetVarint(script);
+                _lastImage.resize(std::max(size, _lastImage.size()));
+                delta::ApplyXorRle(script, scriptDelta.data() + scriptDelta.size(), _lastImage.data());
+                _lastImage.resize(size);
+
+                _bytes -= FrameBytes(_frames.back());
+                _frames.pop_back();
+            }
+            return stepped;
+        }
+
+        // Writes the newest frame to memory and script, the buffer must not be empty
+        void Restore(std::array<unsigned char, Bytes> & memory, ScriptState & script) const {
+            memory = *_last;
+            script = _frames.back().script;
+            script.image = _lastImage;
+        }
+
+    private:
+        void Trim() {
+            while(!_frames.empty() && (_frames.size() > _maxFrames || (_bytes > _maxBytes && _frames.size() > 1))) {
+                _bytes -= FrameBytes(_frames.front());
+                _frames.pop_front();
+            }
+            if(_frames.empty()) {
+                _last.reset();
+                _lastImage.clear();
+            }
+        }
+    };
+
+}
@@ -1,6 +1,18 @@
 #pragma once
 
 #include "bit_array.hpp"
+#include "save_state.hpp"
+#include "persistent_storage.hpp"
+#include "audio.hpp"
+#include "raster.hpp"
+#include "display.hpp"
+#include "blend.hpp"
+#include "map.hpp"
+#include "collision.hpp"
+#include "path.hpp"
+#include "particles.hpp"
+#include "buffer.hpp"
+#include "math.hpp"
 
 namespace drak {
 
@@ -8,14 +20,19 @@ namespace drak {
 
         static constexpr unsigned int ScreenSize = (320 * 240 * 6) / 8;
         static constexpr unsigned int SpriteBankPageSize = (256 * 256 * 6) / 8;
-        static constexpr unsigned int SpriteBankSize = SpriteBankPageSize * 5;
+        static constexpr unsigned int SpriteBankPages = 5;
+        static constexpr unsigned int SpriteBankSize = SpriteBankPageSize * SpriteBankPages;
         static constexpr unsigned int MapSprites = 1200;
         static constexpr unsigned int SpriteIndexBits = 13;
         static constexpr unsigned int MapBankPageSize = (MapSprites * SpriteIndexBits) / 8;
-        static constexpr unsigned int MapBankSize = MapBankPageSize * 16;
+        static constexpr unsigned int MapBankPages = 16;
+        static constexpr unsigned int MapBankSize = MapBankPageSize * MapBankPages;
         static constexpr unsigned int ControllerSize = 16;
         static constexpr unsigned int CodeSize = 256 * 1024;
         static constexpr unsigned int StorageSize = 64 * 1024;
+        static constexpr unsigned int MusicSize = 16 * 1024;
+        static constexpr unsigned int DisplaySize = 4 * 1024;
+        static constexpr unsigned int FlagsSize = 8 * 1024;
 
         static constexpr unsigned int ScreenOffset = 0;
         static constexpr unsigned int SpriteBankOffset = ScreenOffset + ScreenSize;
@@ -44,6 +61,17 @@ namespace drak {
         static constexpr unsigned int ControllerOffset = MapBankOffset + MapBankSize;
         static constexpr unsigned int CodeOffset = ControllerOffset + ControllerSize;
         static constexpr unsigned int StorageOffset = CodeOffset + CodeSize;
+        static constexpr unsigned int MusicOffset = StorageOffset + StorageSize;
+        static constexpr unsigned int DisplayOffset = MusicOffset + MusicSize;
+        static constexpr unsigned int FlagsOffset = DisplayOffset + DisplaySize;
+
+        static_assert(music::Size <= MusicSize, "ERROR: Music data doesn't fit the music bank");
+        static_assert(display::Size <= DisplaySize, "ERROR: Display registers don't fit the display bank");
+        static_assert(Rasterizer::Bytes == ScreenSize, "ERROR: Rasterizer doesn't match the screen layout");
+        static_assert(Rasterizer::TextureSize * Rasterizer::TextureSize * Rasterizer::PixelBits / 8 == SpriteBankPageSize, "ERROR: Rasterizer textures don't match the sprite bank pages");
+        static_assert(map::PageSize == MapBankPageSize && map::Width * map::Height == MapSprites, "ERROR: Map layout doesn't match the map bank pages");
+        static_assert(map::Pages == SpriteBankPages && map::CellBits == SpriteIndexBits, "ERROR: Map sprites don't match the sprite bank");
+        static_assert(map::Sprites == FlagsSize, "ERROR: Sprite flags don't match the sprite indices");
 
         static constexpr unsigned int MemoryBytes =
             ScreenSize +
@@ -51,31 +79,127 @@ namespace drak {
             MapBankSize +
             ControllerSize +
             CodeSize +
-            StorageSize;
+            StorageSize +
+            MusicSize +
+            DisplaySize +
+            FlagsSize;
 
         using array_type = std::array<unsigned char, MemoryBytes>;
         using array_ptr = std::shared_ptr<array_type>;
         array_ptr _memory;
         BitArray<MemoryBytes> _bits;
+        Rasterizer _raster;
+        // Sprite bank pages as render targets, and what drawing currently goes to
+        std::vector<Rasterizer> _pages;
+        Rasterizer * _drawTarget;
+        map::Affine _affine;
+        map::Layers _layerRenderer;
+        std::array<map::Shadow, MapBankPages> _mapShadows;
+        // Pathfinding: the last snapshot of blocked cells (shared by requests while it holds), the
+        // finder for immediate searches, flow fields and the requests for the worker threads
+        std::shared_ptr<path::Blocked const> _blocked;
+        path::Finder _finder;
+        std::array<path::FlowField, 4> _flowFields;
+        path::Queue _paths;
+        particles::Pool _particles;
 
         chaiscript::ChaiScript _scriptEngine;
+        std::function<void()> _update;
+        std::function<void(int)> _scanline;
+        bool _scanlineResolved = false;
+        display::Presenter _presenter;
+        BlendCache _blendCache{DefaultBlendTables()};
+        BlendMode _blendMode = BlendMode::None;
+        CloneFunction _clone;
+        std::function<std::map<std::string, chaiscript::Boxed_Value>()> _objects;
+        RewindBuffer<MemoryBytes> _rewind;
+        std::unique_ptr<PersistentStorage<StorageSize>> _storage;
+        AudioQueue _audio;
+        // Music data sent to the synth and how many queued or playing commands still use it
+        std::vector<std::pair<std::unique_ptr<music::Data>, unsigned int>> _musicData;
         bool _mustQuit;
+        std::ostream * _log = &nowide::cout;
 
-        static std::shared_ptr<System> system;
     public:
-        System() : _mustQuit{false}, _memory{std::make_shared<array_type>()}, _bits{_memory} { }
+        System() : _memory{std::make_shared<array_type>()}, _bits{_memory}, _raster{_memory->data() + ScreenOffset}, _drawTarget{&_raster}, _scriptEngine{ScriptSnapshot()}, _mustQuit{false} {
+            _pages.reserve(SpriteBankPages);
+            for(unsigned int page = 0; page < SpriteBankPages; page++) {
+                _pages.push_back(Rasterizer{_memory->data() + SpriteBankOffset + page * SpriteBankPageSize, Rasterizer::TextureSize, Rasterizer::TextureSize});
+            }
+            display::Reset(_memory->data() + DisplayOffset);
+            BindScriptApi();
+        }
+
+        // The script API is bound to this instance, so it must stay where it was constructed
+        System(System const&) = delete;
+        System & operator=(System const&) = delete;
+
+        ~System() {
+            DetachStorage();
+        }
 
         chaiscript::ChaiScript & ScriptEngine() {
             return _scriptEngine;
         }
 
-        void Update() {
-            auto update_it = _scriptEngine.get_locals().find("update");
-            if(update_it != _scriptEngine.get_locals().end()) {
-                update_it->second.get().cast<std::function<void()>>()();
+        // Commands for the synth; attach at most one AudioDevice or WavRenderer at a time to consume
+        // them. Without one, sound commands are dropped.
+        AudioQueue & Audio() {
+            return _audio;
+        }
+
+        // The screen as one palette index per pixel, row by row
+        unsigned char const* Screen() {
+            return _raster.Pixels();
+        }
+
+        // Converts the screen to RGBA8 (320x240) with the display registers applied
+        void Present(std::uint32_t * rgba) {
+            _presenter.Convert(_raster.Pixels(), _memory->data() + DisplayOffset, rgba);
+        }
+
+        // Returns false if the cartridge has no update function
+        bool Update() {
+            if(!_update) {
+                _update = FindCallback<void()>("update");
+            }
+
+            if(_update) {
+                // Paths asked for last frame are ready for this one
+                _paths.Collect();
+                _update();
+                // An optional scanline(row) sets up the display registers of each row in turn
+                if(!_scanlineResolved) {
+                    _scanline = FindCallback<void(int)>("scanline");
+                    _scanlineResolved = true;
+                }
+                if(_scanline) {
+                    for(int row = 0; row < display::Height; row++) {
+                        _scanline(row);
+                    }
+                }
+                _paths.Start();
+                _particles.Step();
+                // Blending works on palette 0
+                if(_blendCache.Update(_memory->data() + DisplayOffset + display::PaletteOffset)) {
+                    ApplyBlend();
+                }
+                _audio.Send(AudioCommand{});
+                ReclaimMusic();
+                if(_storage) {
+                    _storage->Commit(_memory->data() + StorageOffset);
+                }
+                if(_rewind.Enabled()) {
+                    FlushTargets();
+                    _rewind.Capture(*_memory, CaptureScript());
+                }
+                return true;
             } else {
-                nowide::cerr << "ERROR: Cartridge must have a function \"update\" defined!\n";
+                if(_log) {
+                    nowide::cerr << "ERROR: Cartridge must have a function \"update\" defined!\n";
+                }
                 _mustQuit = true;
+                return false;
             }
         }
 
@@ -83,49 +207,194 @@ namespace drak {
             return _mustQuit;
         }
 
+        // Where trace() and loader messages go, nullptr silences them (headless runs)
+        void SetLog(std::ostream * log) {
+            _log = log;
+        }
+
         void LoadScript(std::string const& source) {
-            nowide::cout << "Source size = " << source.length() << std::endl;
+            if(_log) {
+                *_log << "Source size = " << source.length() << std::endl;
+            }
             assert((source.length() <= CodeSize) && "ERROR: Code is too big! Maximum of 256 KiB or 262144 Bytes.");
             //strncpy((char *)(_memory->data()), source.c_str(), CodeSize);
             strncpy_s((char *)(_memory->data()), CodeSize, source.c_str(), CodeSize);
+            _update = nullptr;
+            _scanline = nullptr;
+            _scanlineResolved = false;
             _scriptEngine.eval(source);
         }
 
+        SaveState Save() {
+            FlushTargets();
+            return SaveState{std::vector<unsigned char>(_memory->begin(), _memory->end()), CaptureScript()};
+        }
+
+        void Load(SaveState const& state) {
+            assert((state.memory.size() == MemoryBytes) && "ERROR: Save state does not match the memory layout");
+            std::copy(state.memory.begin(), state.memory.end(), _memory->begin());
+            InvalidateShadows();
+            RestoreScript(state.script);
+            _rewind.Clear();
+            if(_storage) {
+                _storage->MarkAllDirty();
+            }
+        }
+
+        // Keeps the last frames states (0 disables rewinding), captured after every Update
+        void SetRewindFrames(std::size_t frames, std::size_t max_bytes = 4 * 1024 * 1024) {
+            _rewind.SetLimits(frames, max_bytes);
+        }
+
+        // Goes back up to frames updates, returns false if there is no older state
+        bool Rewind(std::size_t frames = 1) {
+            if(_rewind.StepBack(frames) == 0) {
+                return false;
+            }
+            ScriptState script;
+            _rewind.Restore(*_memory, script);
+            InvalidateShadows();
+            RestoreScript(script);
+            if(_storage) {
+                _storage->MarkAllDirty();
+            }
+            return true;
+        }
+
+        // Loads the storage bank from path (if it exists) and keeps writing it back there in
+        // the background as the cartridge changes it
+        void AttachStorage(std::filesystem::path const& path) {
+            DetachStorage();
+            _storage = std::make_unique<PersistentStorage<StorageSize>>(path, _memory->data() + StorageOffset);
+        }
+
+        // Flushes pending storage writes and waits for them to reach the disk
+        void DetachStorage() {
+            if(_storage) {
+                _storage->Commit(_memory->data() + StorageOffset, true);
+                _storage = nullptr;
+            }
+        }
+
+        template <typename Signature>
+        std::function<Signature> FindCallback(std::string const& name) {
+            auto locals = _scriptEngine.get_locals();
+            auto callback_it = locals.find(name);
+            if(callback_it != locals.end()) {
+                return callback_it->second.get().cast<std::function<Signature>>();
+            }
+            // def name() registers a function rather than a local
+            try {
+                return _scriptEngine.eval<std::function<Signature>>(name);
+            } catch(chaiscript::exception::eval_error const&) {
+                return nullptr;
+            }
+        }
+
         // These functions a bound to the scripting API
         //
-        // scanline
+        // blend
+        // blit
         // btn
+        // buffer
+        // bufadd
+        // buflen
+        // bufrot
+        // bufscale
         // btnp
         // clip
         // cls
         // circ
         // circb
+        // envelope
         // exit
+        // fatan2
+        // fcos
+        // fdiv
+        // fget
+        // fix
+        // flen
+        // flow
+        // flowfield
+        // fmul
         // font
+        // fset
+        // fsin
+        // fsqrt
+        // layers
         // line
+        // lineclip
+        // lineoffset
+        // linepal
+        // linereset
         // map
         // memcpy
         // memset
         // mget
+        // mode7
         // mouse
         // mset
-        // music -- N/A
+        // pal
+        // palset
+        // path
+        // pathasync
+        // pathdone
+        // pathresult
+        // music
         // peek
         // peek4
+        // pburst
+        // pclear
+        // pcount
+        // pdraw
+        // pemit
+        // pforce
         // pix
+        // plife
+        // plot
         // pmem
+        // pmotion
+        // pramp
         // poke
         // poke4
         // text
         // rect
+        // raycast
         // rectb
-        // sfx -- N/A
+        // remap
+        // sfx
         // spr
+        // sspr
+        // sweep
         // sync
+        // target
         // time
         // trace
+        // tileline
         // tri
         // textri
+        // unfix
+        // vdot
+        // view
+        // vnorm
+        // vrot
+
+        // 0 none, 1 average, 2 add, 3 multiply, 4 subtract; applies to everything drawn but cls
+        void _blend(int mode) {
+            if(mode < 0 || mode > static_cast<int>(BlendMode::Subtract)) {
+                throw std::out_of_range("blend mode out of range");
+            }
+            _blendMode = static_cast<BlendMode>(mode);
+            ApplyBlend();
+        }
+
+        // Copies w x h pixels at sx, sy of sprite bank page (0-4) to dx, dy of the draw target
+        void _blit(int page, int sx, int sy, int w, int h, int dx, int dy, int trans = -1) {
+            if(page < 0 || page >= static_cast<int>(SpriteBankPages)) {
+                throw std::out_of_range("blit page out of range");
+            }
+            _drawTarget->Copy(_pages[page], sx, sy, w, h, dx, dy, trans);
+        }
 
         bool _btn(int id) {
             return false;
@@ -135,106 +404,1069 @@ namespace drak {
             return false;
         }
 
+        // Clip rectangle of the draw target for everything but cls, clip() resets it to the whole target
+        void _clip(int x, int y, int w, int h) {
+            _drawTarget->Clip(x, y, w, h);
+        }
+
         void _cls(int color = 0) {
-            
+            _drawTarget->Clear(color);
+        }
+
+        void _circ(int x, int y, int r, int color) {
+            _drawTarget->Circ(x, y, r, color);
+        }
+
+        void _circb(int x, int y, int r, int color) {
+            _drawTarget->CircB(x, y, r, color);
         }
 
         void _exit() {
             _mustQuit = true;
         }
 
+        static void CheckRange(int address, int size, char const* what) {
+            if(address < 0 || size < 0 || static_cast<unsigned int>(address) + static_cast<unsigned int>(size) > MemoryBytes) {
+                throw std::out_of_range(std::string(what) + " address out of range");
+            }
+        }
+
+        static bool Overlaps(unsigned int address, unsigned int size, unsigned int offset, unsigned int region_size) {
+            return address < offset + region_size && address + size > offset;
+        }
+
+        // f(rasterizer, offset, size) for the screen and every sprite bank page
+        template <typename F>
+        void ForEachTarget(F f) {
+            f(_raster, ScreenOffset, ScreenSize);
+            for(unsigned int page = 0; page < SpriteBankPages; page++) {
+                f(_pages[page], SpriteBankOffset + page * SpriteBankPageSize, SpriteBankPageSize);
+            }
+        }
+
+        void FlushTargets() {
+            ForEachTarget([](Rasterizer & target, unsigned int, unsigned int) { target.Flush(); });
+        }
+
+        // After memory was replaced wholesale, everything decoded from it is rebuilt on next use
+        void InvalidateShadows() {
+            ForEachTarget([](Rasterizer & target, unsigned int, unsigned int) { target.Invalidate(); });
+            for(auto & shadow : _mapShadows) {
+                shadow.Invalidate();
+            }
+        }
+
+        void ApplyBlend() {
+            auto table = _blendCache.Current().Get(_blendMode);
+            ForEachTarget([&](Rasterizer & target, unsigned int, unsigned int) { target.Blend(table); });
+        }
+
+        // Render targets are drawn into their rasterizer's shadow, so reads (and partial writes)
+        // of their memory need it packed first
+        void BeforeAccess(unsigned int address, unsigned int size) {
+            ForEachTarget([&](Rasterizer & target, unsigned int offset, unsigned int region_size) {
+                if(Overlaps(address, size, offset, region_size)) {
+                    target.Flush();
+                }
+            });
+        }
+
+        void AfterWrite(unsigned int address, unsigned int size) {
+            ForEachTarget([&](Rasterizer & target, unsigned int offset, unsigned int region_size) {
+                if(Overlaps(address, size, offset, region_size)) {
+                    target.Invalidate();
+                }
+            });
+            for(unsigned int page = 0; page < MapBankPages; page++) {
+                if(Overlaps(address, size, MapBankOffset + page * MapBankPageSize, MapBankPageSize)) {
+                    _mapShadows[page].Invalidate();
+                }
+            }
+            if(_storage && Overlaps(address, size, StorageOffset, StorageSize)) {
+                auto first = std::max(address, StorageOffset);
+                _storage->MarkDirty(first - StorageOffset, std::min(address + size, StorageOffset + StorageSize) - first);
+            }
+        }
+
+        // Bytes of the whole memory map, see the offsets above
+        int _peek(int address) {
+            CheckRange(address, 1, "peek");
+            BeforeAccess(address, 1);
+            return (*_memory)[address];
+        }
+
+        void _poke(int address, int value) {
+            CheckRange(address, 1, "poke");
+            BeforeAccess(address, 1);
+            (*_memory)[address] = static_cast<unsigned char>(value);
+            AfterWrite(address, 1);
+        }
+
+        // Regions may overlap
+        void _memcpy(int dest, int source, int size) {
+            CheckRange(dest, size, "memcpy");
+            CheckRange(source, size, "memcpy");
+            BeforeAccess(source, size);
+            BeforeAccess(dest, size);
+            std::memmove(_memory->data() + dest, _memory->data() + source, size);
+            AfterWrite(dest, size);
+        }
+
+        void _memset(int dest, int value, int size) {
+            CheckRange(dest, size, "memset");
+            BeforeAccess(dest, size);
+            std::memset(_memory->data() + dest, value, size);
+            AfterWrite(dest, size);
+        }
+
+        // Map bank page (0-15), see map.hpp
+        unsigned char * MapPage(int page) {
+            if(page < 0 || page >= static_cast<int>(MapBankPages)) {
+                throw std::out_of_range("map page out of range");
+            }
+            return _memory->data() + MapBankOffset + page * MapBankPageSize;
+        }
+
+        // Sprite index of a map cell, 0 outside the map
+        int _mget(int x, int y, int page = 0) {
+            auto cells = MapPage(page);
+            if(x < 0 || y < 0 || x >= map::Width || y >= map::Height) {
+                return 0;
+            }
+            return map::GetCell(cells, x, y);
+        }
+
+        void _mset(int x, int y, int sprite, int page = 0) {
+            auto cells = MapPage(page);
+            if(x >= 0 && y >= 0 && x < map::Width && y < map::Height) {
+                map::SetCell(cells, x, y, sprite);
+                _mapShadows[page].Set(x, y, sprite);
+            }
+        }
+
+        // Sprite flags are a byte per sprite index; fget(sprite) gives all of them, fget(sprite, bit) one
+        unsigned char * SpriteFlags(int sprite) {
+            if(sprite < 0 || sprite >= map::Sprites) {
+                throw std::out_of_range("sprite out of range");
+            }
+            return _memory->data() + FlagsOffset + sprite;
+        }
+
+        int _fget(int sprite) {
+            return *SpriteFlags(sprite);
+        }
+
+        bool _fget_bit(int sprite, int bit) {
+            return (*SpriteFlags(sprite) >> (bit & 7)) & 1;
+        }
+
+        void _fset(int sprite, int flags) {
+            *SpriteFlags(sprite) = static_cast<unsigned char>(flags);
+        }
+
+        void _fset_bit(int sprite, int bit, bool value) {
+            auto flags = SpriteFlags(sprite);
+            *flags = static_cast<unsigned char>(value ? *flags | (1 << (bit & 7)) : *flags & ~(1 << (bit & 7)));
+        }
+
+        // Cells of map page (0-15) are solid where their sprite's flags share a bit with mask
+        collision::Grid SolidCells(int page, int mask) {
+            auto cells = MapPage(page);
+            return collision::Grid(_mapShadows[page].Get(cells), _memory->data() + FlagsOffset, mask);
+        }
+
+        // Moves the w x h box at x, y by dx and then dy, stopping at solid cells. Returns the new
+        // x, y and the sides that were stopped (1 left, 2 right, 4 top, 8 bottom).
+        std::vector<chaiscript::Boxed_Value> _sweep(double x, double y, double w, double h, double dx, double dy, int mask = 1, int page = 0) {
+            auto box = collision::Sweep(SolidCells(page, mask), collision::Box{ x, y, w, h, 0 }, dx, dy);
+            return { chaiscript::Boxed_Value(box.x), chaiscript::Boxed_Value(box.y), chaiscript::Boxed_Value(box.hit) };
+        }
+
+        // First solid cell on the line from x0, y0 to x1, y1 (map pixels): the point where the
+        // line enters it, the cell and the side it was entered from (nx, ny), or an empty Vector
+        std::vector<chaiscript::Boxed_Value> _raycast(double x0, double y0, double x1, double y1, int mask = 1, int page = 0) {
+            auto hit = collision::Raycast(SolidCells(page, mask), x0, y0, x1, y1);
+            if(!hit.hit) {
+                return {};
+            }
+            return {
+                chaiscript::Boxed_Value(hit.x), chaiscript::Boxed_Value(hit.y),
+                chaiscript::Boxed_Value(hit.cellX), chaiscript::Boxed_Value(hit.cellY),
+                chaiscript::Boxed_Value(hit.normalX), chaiscript::Boxed_Value(hit.normalY)
+            };
+        }
+
+        // First solid cell on the line between the centers of two cells, or an empty Vector
+        std::vector<chaiscript::Boxed_Value> _tileline(int x0, int y0, int x1, int y1, int mask = 1, int page = 0) {
+            auto center = [](int cell) { return cell * map::TileSize + map::TileSize / 2.0; };
+            auto hit = collision::Raycast(SolidCells(page, mask), center(x0), center(y0), center(x1), center(y1));
+            if(!hit.hit) {
+                return {};
+            }
+            return { chaiscript::Boxed_Value(hit.cellX), chaiscript::Boxed_Value(hit.cellY) };
+        }
+
+        // Which cells of map page (0-15) can't be entered, see SolidCells
+        std::shared_ptr<path::Blocked const> BlockedCells(int page, int mask) {
+            auto blocked = std::make_shared<path::Blocked>();
+            path::Snapshot(SolidCells(page, mask), *blocked);
+            if(!_blocked || *_blocked != *blocked) {
+                _blocked = std::move(blocked);
+            }
+            return _blocked;
+        }
+
+        static std::vector<chaiscript::Boxed_Value> PathCells(std::vector<std::int16_t> const& cells) {
+            std::vector<chaiscript::Boxed_Value> result;
+            result.reserve(cells.size() * 2);
+            for(auto cell : cells) {
+                result.push_back(chaiscript::Boxed_Value(cell % map::Width));
+                result.push_back(chaiscript::Boxed_Value(cell / map::Width));
+            }
+            return result;
+        }
+
+        // Shortest path from cell x0, y0 to x1, y1 through cells that aren't solid, as x, y of
+        // every cell from the start to the goal, or an empty Vector if there is none
+        std::vector<chaiscript::Boxed_Value> _path(int x0, int y0, int x1, int y1, int mask = 1, int page = 0) {
+            std::vector<std::int16_t> cells;
+            _finder.Find(*BlockedCells(page, mask), x0, y0, x1, y1, cells);
+            return PathCells(cells);
+        }
+
+        // The same searched on a worker thread after this frame, against the map as it is now.
+        // Returns an id for pathresult, which has the path from the next frame on.
+        int _pathasync(int x0, int y0, int x1, int y1, int mask = 1, int page = 0) {
+            return _paths.Add(BlockedCells(page, mask), x0, y0, x1, y1);
+        }
+
+        bool _pathdone(int id) {
+            return _paths.Done(id);
+        }
+
+        // The path searched for id, once: later calls with the same id fail like ones before it's done
+        std::vector<chaiscript::Boxed_Value> _pathresult(int id) {
+            path::Queue::Result result;
+            if(!_paths.Take(id, result)) {
+                throw std::out_of_range("path not done");
+            }
+            return PathCells(result.cells);
+        }
+
+        path::FlowField & FlowField(int field) {
+            if(field < 0 || field >= static_cast<int>(_flowFields.size())) {
+                throw std::out_of_range("flow field out of range");
+            }
+            return _flowFields[field];
+        }
+
+        // Fills flow field (0-3) with the way to cell x, y from every other cell
+        void _flowfield(int field, int x, int y, int mask = 1, int page = 0) {
+            FlowField(field).Build(*BlockedCells(page, mask), x, y);
+        }
+
+        // The step (dx, dy) from cell x, y towards the goal of a flow field and how many steps are
+        // left, -1 if the goal can't be reached from there
+        std::vector<chaiscript::Boxed_Value> _flow(int field, int x, int y) {
+            auto const& flow = FlowField(field);
+            int dx;
+            int dy;
+            flow.Step(x, y, dx, dy);
+            auto distance = flow.Distance(x, y);
+            return {
+                chaiscript::Boxed_Value(dx), chaiscript::Boxed_Value(dy),
+                chaiscript::Boxed_Value(distance == path::FlowField::Unreachable ? -1 : distance)
+            };
+        }
+
+        // The sprite bank pages, one byte per pixel
+        std::array<unsigned char const*, map::Pages> SpritePixels() {
+            std::array<unsigned char const*, map::Pages> sprites;
+            for(int i = 0; i < map::Pages; i++) {
+                sprites[i] = _pages[i].Pixels();
+            }
+            return sprites;
+        }
+
+        template <typename RowFunction>
+        void DrawAffine(int page, RowFunction row, bool wrap, int trans) {
+            auto cells = MapPage(page);
+            _affine.Compose(cells, SpritePixels());
+            _affine.Draw(*_drawTarget, row, wrap, trans);
+        }
+
+        // Draws up to 4 map pages as parallax layers, given as page, x and y scroll for each from
+        // the front. trans (0-63) is the transparent color of every layer.
+        void _layers(std::vector<chaiscript::Boxed_Value> const& layers, int trans = 0) {
+            if(layers.size() / 3 > map::Layers::MaxLayers) {
+                throw std::out_of_range("layers takes at most 4 layers");
+            }
+            std::array<map::Layer, map::Layers::MaxLayers> stack;
+            auto count = layers.size() / 3;
+            for(std::size_t i = 0; i < count; i++) {
+                auto value = [&](std::size_t j) { return chaiscript::Boxed_Number(layers[i * 3 + j]).get_as<int>(); };
+                stack[i] = map::Layer{ MapPage(value(0)), value(1), value(2) };
+            }
+            _layerRenderer.Draw(*_drawTarget, SpritePixels(), stack.begin(), stack.begin() + count, trans & 63);
+        }
+
+        // Draws map page (0-15) over the draw target with the map pixel at screen x, y being
+        // (a * x + b * y + tx, c * x + d * y + ty), wrapping around the map or clamped to its edges
+        void _mode7(int page, double a, double b, double c, double d, double tx, double ty, bool wrap = true, int trans = -1) {
+            DrawAffine(page, [&](int y, map::AffineRow & row) {
+                row = map::AffineRow{ b * y + tx, d * y + ty, a, c };
+                return true;
+            }, wrap, trans);
+        }
+
+        // The same with u, v (map pixel at x = 0), du, dv (step per pixel) for each row in turn
+        // from the top; rows past the end of rows aren't drawn
+        void _mode7rows(int page, std::vector<chaiscript::Boxed_Value> const& rows, bool wrap = true, int trans = -1) {
+            std::vector<double> values(rows.size() / 4 * 4);
+            for(std::size_t i = 0; i < values.size(); i++) {
+                values[i] = chaiscript::Boxed_Number(rows[i]).get_as<double>();
+            }
+            DrawAffineRows(page, values, wrap, trans);
+        }
+
+        // The same with the rows in a Buffer
+        void _mode7buffer(int page, Buffer const& rows, bool wrap = true, int trans = -1) {
+            std::vector<double> values(rows.Size() / 4 * 4);
+            rows.Values(0, static_cast<int>(values.size()), values.data());
+            DrawAffineRows(page, values, wrap, trans);
+        }
+
+        void DrawAffineRows(int page, std::vector<double> const& values, bool wrap, int trans) {
+            auto count = static_cast<int>(values.size() / 4);
+            DrawAffine(page, [&](int y, map::AffineRow & row) {
+                if(y >= count) {
+                    return false;
+                }
+                row = map::AffineRow{ values[y * 4], values[y * 4 + 1], values[y * 4 + 2], values[y * 4 + 3] };
+                return true;
+            }, wrap, trans);
+        }
+
+        // Display registers of count rows from first, see display.hpp
+        unsigned char * DisplayLine(int row) {
+            return _memory->data() + DisplayOffset + display::LineOffset + row * display::LineSize;
+        }
+
+        template <typename Set>
+        void SetLines(int first, int count, Set && set) {
+            auto begin = std::max(first, 0);
+            auto end = std::min(first + std::max(count, 0), display::Height);
+            for(auto row = begin; row < end; row++) {
+                set(DisplayLine(row));
+            }
+        }
+
+        void _lineclip(int first, int count, int left, int right) {
+            SetLines(first, count, [&](unsigned char * line) {
+                display::Put16(line + 4, left);
+                display::Put16(line + 6, display::Width - right);
+            });
+        }
+
+        void _lineoffset(int first, int count, int offset) {
+            SetLines(first, count, [&](unsigned char * line) { display::Put16(line + 2, offset); });
+        }
+
+        // One offset per row from first, for waves and the like in a single call
+        void _lineoffsets(int first, std::vector<chaiscript::Boxed_Value> const& offsets) {
+            auto row = first;
+            for(auto const& offset : offsets) {
+                if(row >= 0 && row < display::Height) {
+                    display::Put16(DisplayLine(row) + 2, chaiscript::Boxed_Number(offset).get_as<int>());
+                }
+                row++;
+            }
+        }
+
+        void _linepal(int first, int count, int palette) {
+            SetLines(first, count, [&](unsigned char * line) { line[0] = static_cast<unsigned char>(palette % display::Palettes); });
+        }
+
+        void _linereset() {
+            std::memset(DisplayLine(0), 0, display::Height * display::LineSize);
+        }
+
+        unsigned char * RemapTable(int table) {
+            if(table < 0 || table >= display::Remaps) {
+                throw std::out_of_range("remap table out of range");
+            }
+            return _memory->data() + DisplayOffset + display::RemapOffset + table * display::Colors;
+        }
+
+        // Makes table draw color from as to, or resets the whole table when from is negative
+        void _pal(int table, int from, int to) {
+            auto entries = RemapTable(table);
+            if(from < 0) {
+                display::ResetRemap(entries);
+                return;
+            }
+            if(from >= display::Colors) {
+                throw std::out_of_range("pal color out of range");
+            }
+            entries[from] = static_cast<unsigned char>(to & (display::Colors - 1));
+        }
+
+        // Selects the remap table (0-7) blits go through, -1 for none
+        void _remap(int table) {
+            auto entries = table < 0 ? nullptr : RemapTable(table);
+            ForEachTarget([&](Rasterizer & target, unsigned int, unsigned int) { target.Remap(entries); });
+        }
+
+        void _palset(int palette, int color, int r, int g, int b) {
+            if(palette < 0 || palette >= display::Palettes || color < 0 || color >= display::Colors) {
+                throw std::out_of_range("palset palette or color out of range");
+            }
+            auto entry = _memory->data() + DisplayOffset + display::PaletteOffset + palette * display::PaletteSize + color * 3;
+            entry[0] = static_cast<unsigned char>(r);
+            entry[1] = static_cast<unsigned char>(g);
+            entry[2] = static_cast<unsigned char>(b);
+        }
+
+        void _line(int x0, int y0, int x1, int y1, int color) {
+            _drawTarget->Line(x0, y0, x1, y1, color);
+        }
+
+        // Returns the color at x, y (0 outside the draw target), and sets it first if color isn't negative
         int _pix(int x, int y, int color = -1) {
-            return 0;
+            if(color >= 0) {
+                _drawTarget->Pixel(x, y, color);
+            }
+            return _drawTarget->Get(x, y);
         }
 
-        int _time() {
-            return 0;
+        // Draws the sw x sh region at sx, sy of sprite bank page (0-4) stretched over dw x dh at
+        // dx, dy of the draw target, mirrored if asked; trans is a transparent color (-1 for none)
+        void _sspr(int page, int sx, int sy, int sw, int sh, int dx, int dy, int dw, int dh, bool flipx = false, bool flipy = false, int trans = -1) {
+            if(page < 0 || page >= static_cast<int>(SpriteBankPages)) {
+                throw std::out_of_range("sspr page out of range");
+            }
+            if(sw > Rasterizer::TextureSize || sh > Rasterizer::TextureSize || dw > MaxStretch || dh > MaxStretch) {
+                throw std::out_of_range("sspr size out of range");
+            }
+            _drawTarget->Stretch(_pages[page], sx, sy, sw, sh, dx, dy, dw, dh, flipx, flipy, trans);
         }
 
-        void _trace(std::string const& msg) {
-            nowide::cout << msg << std::endl;
+        particles::Emitter & Emitter(int emitter) {
+            if(emitter < 0 || emitter >= particles::Emitters) {
+                throw std::out_of_range("emitter out of range");
+            }
+            return _particles.Get(emitter);
+        }
+
+        // Particle emitters (0-15) spawn rate particles per frame at x, y; the engine moves them
+        // after every update and pdraw draws them
+        void _pemit(int emitter, double x, double y, double rate) {
+            auto & e = Emitter(emitter);
+            e.x = static_cast<float>(x);
+            e.y = static_cast<float>(y);
+            e.rate = static_cast<float>(rate);
+        }
+
+        void _pburst(int emitter, int count) {
+            Emitter(emitter);
+            _particles.Burst(emitter, count);
+        }
+
+        // New particles head at angle (radians) give or take half of spread, at a speed between
+        // the two in pixels per frame
+        void _pmotion(int emitter, double angle, double spread, double speed_min, double speed_max) {
+            auto & e = Emitter(emitter);
+            e.angle = static_cast<float>(angle);
+            e.spread = static_cast<float>(spread);
+            e.speedMin = static_cast<float>(speed_min);
+            e.speedMax = static_cast<float>(speed_max);
+        }
+
+        // Every frame velocities are multiplied by drag and then gx, gy is added
+        void _pforce(int emitter, double gx, double gy, double drag = 1.0) {
+            auto & e = Emitter(emitter);
+            e.gravityX = static_cast<float>(gx);
+            e.gravityY = static_cast<float>(gy);
+            e.drag = static_cast<float>(drag);
+        }
+
+        // New particles live between min and max frames
+        void _plife(int emitter, double min, double max) {
+            auto & e = Emitter(emitter);
+            e.lifeMin = static_cast<float>(min);
+            e.lifeMax = static_cast<float>(max);
+        }
+
+        // Up to 8 colors particles go through over their life, or sprites (drawn with color 0
+        // transparent) if sprites is true
+        void _pramp(int emitter, std::vector<chaiscript::Boxed_Value> const& ramp, bool sprites = false) {
+            auto & e = Emitter(emitter);
+            if(ramp.empty() || ramp.size() > particles::RampSize) {
+                throw std::out_of_range("pramp takes 1 to 8 entries");
+            }
+            for(std::size_t i = 0; i < ramp.size(); i++) {
+                auto entry = chaiscript::Boxed_Number(ramp[i]).get_as<int>();
+                e.ramp[i] = static_cast<std::uint16_t>(sprites ? entry & (map::Sprites - 1) : entry & 63);
+            }
+            e.rampSize = static_cast<int>(ramp.size());
+            e.sprites = sprites;
+        }
+
+        void _pclear(int emitter) {
+            Emitter(emitter).Clear();
+        }
+
+        int _pcount(int emitter) {
+            return Emitter(emitter).Count();
+        }
+
+        void _pdraw(int emitter) {
+            Emitter(emitter);
+            _particles.Draw(emitter, *_drawTarget, [this](int sprite, int x, int y) {
+                auto tile = sprite % (map::PageTiles * map::PageTiles);
+                auto & page = _pages[(sprite / (map::PageTiles * map::PageTiles)) % map::Pages];
+                _drawTarget->Copy(page, (tile % map::PageTiles) * map::TileSize, (tile / map::PageTiles) * map::TileSize, map::TileSize, map::TileSize, x, y, 0);
+            });
+        }
+
+        // Largest buffer, in elements
+        static constexpr int MaxBufferSize = 1 << 24;
+
+        // Typed arrays (see buffer.hpp) of "int8", "int16", "int32", "fixed" (16.16) or "float"
+        // elements, set to 0
+        std::shared_ptr<Buffer> _buffer(std::string const& type, int size) {
+            if(size < 0 || size > MaxBufferSize) {
+                throw std::out_of_range("buffer size out of range");
+            }
+            return std::make_shared<Buffer>(Buffer::ParseType(type), size);
+        }
+
+        // The same holding values
+        std::shared_ptr<Buffer> _buffer_values(std::string const& type, std::vector<chaiscript::Boxed_Value> const& values) {
+            auto buffer = _buffer(type, static_cast<int>(values.size()));
+            for(int i = 0; i < buffer->Size(); i++) {
+                buffer->Set(i, chaiscript::Boxed_Number(values[i]).get_as<double>());
+            }
+            return buffer;
+        }
+
+        // A buffer over count elements of console memory from address
+        std::shared_ptr<Buffer> _view(std::string const& type, int address, int count) {
+            auto element = Buffer::ParseType(type);
+            if(count < 0 || count > static_cast<int>(MemoryBytes)) {
+                throw std::out_of_range("view size out of range");
+            }
+            CheckRange(address, count * Buffer::ElementSize(element), "view");
+            return std::make_shared<Buffer>(element, count, _memory->data() + address, _memory, address, [this](unsigned int at, unsigned int size, bool write) {
+                if(write) {
+                    AfterWrite(at, size);
+                } else {
+                    BeforeAccess(at, size);
+                }
+            });
+        }
+
+        // Elements of integer buffers come out as integers, the others as floating point
+        static chaiscript::Boxed_Value BufferGet(Buffer const& buffer, int index) {
+            auto value = buffer.Get(index);
+            return buffer.IsInteger() ? chaiscript::Boxed_Value(static_cast<int>(value)) : chaiscript::Boxed_Value(value);
+        }
+
+        static std::vector<chaiscript::Boxed_Value> BufferVector(Buffer const& buffer) {
+            std::vector<chaiscript::Boxed_Value> values;
+            values.reserve(buffer.Size());
+            for(int i = 0; i < buffer.Size(); i++) {
+                values.push_back(BufferGet(buffer, i));
+            }
+            return values;
+        }
+
+        // Sets the pixels at xs[i], ys[i] to color, for as many points as the shorter buffer holds
+        void _plot(Buffer const& xs, Buffer const& ys, int color) {
+            PlotBuffers(xs, ys, [color](int, int n, unsigned char * colors) { std::memset(colors, color & 63, n); });
+        }
+
+        // The same in colors[i]
+        void _plot_colors(Buffer const& xs, Buffer const& ys, Buffer const& colors) {
+            if(colors.Size() < std::min(xs.Size(), ys.Size())) {
+                throw std::out_of_range("plot needs a color for every point");
+            }
+            PlotBuffers(xs, ys, [&](int first, int n, unsigned char * out) {
+                std::array<int, PlotBatch> values;
+                colors.Integers(first, n, values.data());
+                for(int i = 0; i < n; i++) {
+                    out[i] = static_cast<unsigned char>(values[i] & 63);
+                }
+            });
+        }
+
+        static constexpr int PlotBatch = 1024;
+
+        template <typename ColorFunction>
+        void PlotBuffers(Buffer const& xs, Buffer const& ys, ColorFunction colors) {
+            std::array<int, PlotBatch> x;
+            std::array<int, PlotBatch> y;
+            std::array<unsigned char, PlotBatch> c;
+            auto count = std::min(xs.Size(), ys.Size());
+            for(int first = 0; first < count; first += PlotBatch) {
+                auto n = std::min(count - first, static_cast<int>(PlotBatch));
+                xs.Integers(first, n, x.data());
+                ys.Integers(first, n, y.data());
+                colors(first, n, c.data());
+                _drawTarget->Plot(n, x.data(), y.data(), c.data());
+            }
+        }
+
+        // Fixed point math, see math.hpp: values are 16.16 fixed point ints and angles 1/65536 of
+        // a turn. The same on every machine, so replays stay in sync.
+        static int _fix(double value) {
+            // Out of range saturates, NaN becomes 0
+            if(!(std::abs(value) < 32768.0)) {
+                return value > 0 ? std::numeric_limits<int>::max() : value < 0 ? std::numeric_limits<int>::min() : 0;
+            }
+            return math::Saturate(static_cast<std::int64_t>(std::floor(value * math::One + 0.5)));
+        }
+
+        static double _unfix(int value) {
+            return value / static_cast<double>(math::One);
+        }
+
+        static int _fdiv(int a, int b) {
+            if(b == 0) {
+                throw std::out_of_range("fdiv by zero");
+            }
+            return math::Div(a, b);
+        }
+
+        static std::vector<chaiscript::Boxed_Value> Point(std::int32_t x, std::int32_t y) {
+            return { chaiscript::Boxed_Value(static_cast<int>(x)), chaiscript::Boxed_Value(static_cast<int>(y)) };
+        }
+
+        static std::vector<chaiscript::Boxed_Value> _vrot(int x, int y, int angle) {
+            std::int32_t rx = x;
+            std::int32_t ry = y;
+            math::Rotate(rx, ry, angle);
+            return Point(rx, ry);
+        }
+
+        // x, y scaled to length 1 (0, 0 stays as it is)
+        static std::vector<chaiscript::Boxed_Value> _vnorm(int x, int y) {
+            auto length = math::Length(x, y);
+            return length == 0 ? Point(0, 0) : Point(math::Div(x, length), math::Div(y, length));
         }
 
-        static System & Get() {
-            return *system;
+        static int _vdot(int ax, int ay, int bx, int by) {
+            return math::Saturate(((std::int64_t(ax) * bx) >> math::FixedBits) + ((std::int64_t(ay) * by) >> math::FixedBits));
         }
 
-        static bool Btn(int id) {
-            return system->_btn(id);
+        // Draws to sprite bank page (0-4) as a 256x256 render target, -1 for the screen
+        void _target(int page) {
+            if(page >= static_cast<int>(SpriteBankPages)) {
+                throw std::out_of_range("target page out of range");
+            }
+            _drawTarget = page < 0 ? &_raster : &_pages[page];
         }
 
-        static bool Btnp(int id, int hold=-1, int period=-1) {
-            return system->_btnp(id, hold, period);
+        void _rect(int x, int y, int w, int h, int color) {
+            _drawTarget->Rect(x, y, w, h, color);
         }
 
-        static void Cls(int color=0) {
-            system->_cls(color);
+        void _rectb(int x, int y, int w, int h, int color) {
+            _drawTarget->RectB(x, y, w, h, color);
         }
 
-        static void Exit() {
-            system->_exit();
+        // Largest sspr destination size
+        static constexpr int MaxStretch = 32768;
+
+        // pmem slots are little endian 32-bit values filling the storage bank
+        static constexpr unsigned int PmemSlots = StorageSize / 4;
+
+        std::uint32_t _pmem(int index) {
+            if(index < 0 || static_cast<unsigned int>(index) >= PmemSlots) {
+                throw std::out_of_range("pmem index out of range");
+            }
+            auto slot = _memory->data() + StorageOffset + index * 4;
+            return std::uint32_t(slot[0]) | (std::uint32_t(slot[1]) << 8) | (std::uint32_t(slot[2]) << 16) | (std::uint32_t(slot[3]) << 24);
         }
 
-        static int Pix(int x, int y, int color = -1) {
-            return system->_pix(x, y, color);
+        // Returns the previous value
+        std::uint32_t _pmem(int index, std::uint32_t value) {
+            auto previous = _pmem(index);
+            auto slot = _memory->data() + StorageOffset + index * 4;
+            slot[0] = static_cast<unsigned char>(value);
+            slot[1] = static_cast<unsigned char>(value >> 8);
+            slot[2] = static_cast<unsigned char>(value >> 16);
+            slot[3] = static_cast<unsigned char>(value >> 24);
+            if(_storage) {
+                _storage->MarkDirty(index * 4, 4);
+            }
+            return previous;
         }
 
-        static int Time() {
-            return system->_time();
+        // wave: 0 square, 1 triangle, 2 saw, 3 sine, 4 noise, -1 stops the channel.
+        // duration is in frames (-1 plays until stopped), volume goes from 0 to 15.
+        void _sfx(int wave, double frequency, int duration = -1, int channel = 0, int volume = 15) {
+            AudioCommand command;
+            command.channel = static_cast<unsigned char>(channel);
+            if(wave < 0) {
+                command.type = AudioCommand::Type::Stop;
+            } else {
+                command.type = AudioCommand::Type::Note;
+                command.wave = static_cast<Waveform>(std::min(wave, static_cast<int>(Waveform::Noise)));
+                command.frequency = static_cast<float>(frequency);
+                command.duration = duration < 0 ? -1 : duration * static_cast<int>(Synth::SamplesPerFrame);
+                command.volume = volume / 15.0f;
+            }
+            _audio.Send(command);
         }
 
-        static void Trace(std::string const& msg) {
-            system->_trace(msg);
+        // attack, decay and release in milliseconds, sustain from 0 to 15
+        void _envelope(int channel, int attack, int decay, int sustain, int release) {
+            AudioCommand command;
+            command.type = AudioCommand::Type::Envelope;
+            command.channel = static_cast<unsigned char>(channel);
+            command.envelope = Envelope{attack / 1000.0f, decay / 1000.0f, sustain / 15.0f, release / 1000.0f};
+            _audio.Send(command);
         }
 
-        static void InitializeSystem() {
+        // Plays track of the music bank as it is now; later changes to the bank are heard from the
+        // next call on. A negative track stops the music.
+        void _music(int track = -1, int frame = 0, int row = 0, bool loop = true) {
+            ReclaimMusic();
+
+            AudioCommand command;
+            command.type = AudioCommand::Type::Music;
+            command.track = track;
+            command.frame = frame;
+            command.row = row;
+            command.loop = loop;
+
+            if(track >= 0) {
+                auto bank = _memory->data() + MusicOffset;
+                if(_musicData.empty() || !_musicData.back().first->Matches(bank)) {
+                    _musicData.emplace_back(music::Data::Decode(bank), 0);
+                }
+                command.music = _musicData.back().first.get();
+            }
+
+            if(_audio.Send(command) && command.music) {
+                _musicData.back().second++;
+            }
+        }
+
+        // [track, frame, row] of the music being played, track is -1 when stopped
+        std::vector<chaiscript::Boxed_Value> _music_position() {
+            auto position = _audio.position.load(std::memory_order_relaxed);
+            if(position < 0) {
+                return {chaiscript::Boxed_Value(-1), chaiscript::Boxed_Value(-1), chaiscript::Boxed_Value(-1)};
+            }
+            return {chaiscript::Boxed_Value(int(position & 0xFF)), chaiscript::Boxed_Value(int((position >> 8) & 0xFF)), chaiscript::Boxed_Value(int(position >> 16))};
+        }
+
+        // Frees music data the synth has handed back, keeping the newest for reuse
+        void ReclaimMusic() {
+            music::Data const* retired;
+            while(_audio.retired.Pop(retired)) {
+                for(auto & data : _musicData) {
+                    if(data.first.get() == retired && data.second > 0) {
+                        data.second--;
+                        break;
+                    }
+                }
+            }
+            if(!_musicData.empty()) {
+                _musicData.erase(std::remove_if(_musicData.begin(), _musicData.end() - 1, [](auto const& data) { return data.second == 0; }), _musicData.end() - 1);
+            }
+        }
+
+        void _tri(double x1, double y1, double x2, double y2, double x3, double y3, int color) {
+            std::array<Rasterizer::Vertex, 3> vertices = {{ { x1, y1, 0.0, 0.0, 1.0 }, { x2, y2, 0.0, 0.0, 1.0 }, { x3, y3, 0.0, 0.0, 1.0 } }};
+            _drawTarget->Tri(vertices, color);
+        }
+
+        // Texture comes from sprite bank page (0-4), trans is a transparent color (-1 for none).
+        // Giving all three z (> 0) makes the mapping perspective correct.
+        void _textri(double x1, double y1, double x2, double y2, double x3, double y3,
+                     double u1, double v1, double u2, double v2, double u3, double v3,
+                     int page = 0, int trans = -1, double z1 = 0.0, double z2 = 0.0, double z3 = 0.0) {
+            if(page < 0 || page >= static_cast<int>(SpriteBankPages)) {
+                throw std::out_of_range("textri page out of range");
+            }
+            auto perspective = z1 > 0.0 && z2 > 0.0 && z3 > 0.0;
+            std::array<Rasterizer::Vertex, 3> vertices = {{
+                { x1, y1, u1, v1, perspective ? z1 : 1.0 },
+                { x2, y2, u2, v2, perspective ? z2 : 1.0 },
+                { x3, y3, u3, v3, perspective ? z3 : 1.0 },
+            }};
+            // The page may have been drawn to
+            _pages[page].Flush();
+            _drawTarget->TexTri(vertices, _memory->data() + SpriteBankOffset + page * SpriteBankPageSize, trans, perspective);
+        }
+
+        int _time() {
+            return 0;
+        }
+
+        void _trace(std::string const& msg) {
+            if(_log) {
+                *_log << msg << std::endl;
+            }
+        }
+
+        void BindScriptState() {
+            if(!_clone) {
+                _clone = _scriptEngine.eval<CloneFunction>("clone");
+                _objects = _scriptEngine.eval<std::function<std::map<std::string, chaiscript::Boxed_Value>()>>("get_objects");
+            }
+        }
+
+        ScriptState CaptureScript() {
+            BindScriptState();
+
+            ScriptState state;
+            ScriptWriter writer(state, _clone);
+            auto locals = _scriptEngine.get_locals();
+            for(auto const& object : _objects()) {
+                if(object.second.is_const()) {
+                    continue;
+                }
+                writer.Write(object.first, locals.count(object.first) != 0, object.second);
+            }
+            return state;
+        }
+
+        // Values are made anew so that the state can be restored more than once
+        void RestoreScript(ScriptState const& state) {
+            BindScriptState();
+
+            auto locals = _scriptEngine.get_locals();
+            ScriptReader reader(state, _clone);
+            bool local;
+            std::string name;
+            chaiscript::Boxed_Value value;
+            while(reader.Next(local, name, value)) {
+                if(!local) {
+                    _scriptEngine.set_global(value, name);
+                    continue;
+                }
+                auto local_it = locals.find(name);
+                if(local_it != locals.end()) {
+                    local_it->second.assign(value);
+                } else {
+                    locals.emplace(name, value);
+                }
+            }
+            _scriptEngine.set_locals(locals);
+        }
+
+        // Binds the part of the scripting API that works on this instance. It can't go into the
+        // shared snapshot: the functions capture `this`, and a native function has no way to find
+        // out which engine (and so which System) is calling it.
+        void BindScriptApi() {
+            using namespace chaiscript;
+
+            auto & api = _scriptEngine;
+
+            api.add(fun(&System::_blend, this), "blend");
+            api.add(fun([this]() { _blend(0); }), "blend");
+            api.add(fun(&System::_blit, this), "blit");
+            api.add(fun([this](int page, int sx, int sy, int w, int h, int dx, int dy) { _blit(page, sx, sy, w, h, dx, dy); }), "blit");
+            api.add(fun(&System::_btn, this), "btn");
+            api.add(fun(&System::_buffer, this), "buffer");
+            api.add(fun(&System::_buffer_values, this), "buffer");
+            api.add(fun(&System::_btnp, this), "btnp");
+            api.add(fun([this](int id) -> bool { return _btnp(id); }), "btnp");
+            api.add(fun([this](int id, int hold) -> bool { return _btnp(id, hold); }), "btnp");
+            api.add(fun(&System::_clip, this), "clip");
+            api.add(fun([this]() { _drawTarget->Unclip(); }), "clip");
+            api.add(fun(&System::_cls, this), "cls");
+            api.add(fun([this]() { _cls(); }), "cls");
+            api.add(fun(&System::_circ, this), "circ");
+            api.add(fun(&System::_circb, this), "circb");
+            api.add(fun(&System::_exit, this), "exit");
+            api.add(fun(&System::_fget, this), "fget");
+            api.add(fun(&System::_fget_bit, this), "fget");
+            //api.add(fun(&System::_font, this), "font");
+            api.add(fun(&System::_flow, this), "flow");
+            api.add(fun(&System::_flowfield, this), "flowfield");
+            api.add(fun([this](int field, int x, int y) { _flowfield(field, x, y); }), "flowfield");
+            api.add(fun([this](int field, int x, int y, int mask) { _flowfield(field, x, y, mask); }), "flowfield");
+            api.add(fun(&System::_fset, this), "fset");
+            api.add(fun(&System::_fset_bit, this), "fset");
+            api.add(fun(&System::_layers, this), "layers");
+            api.add(fun([this](std::vector<chaiscript::Boxed_Value> const& layers) { _layers(layers); }), "layers");
+            api.add(fun(&System::_line, this), "line");
+            api.add(fun(&System::_lineclip, this), "lineclip");
+            api.add(fun([this](int row, int left, int right) { _lineclip(row, 1, left, right); }), "lineclip");
+            api.add(fun(&System::_lineoffset, this), "lineoffset");
+            api.add(fun([this](int row, int offset) { _lineoffset(row, 1, offset); }), "lineoffset");
+            api.add(fun(&System::_lineoffsets, this), "lineoffset");
+            api.add(fun(&System::_linepal, this), "linepal");
+            api.add(fun([this](int row, int palette) { _linepal(row, 1, palette); }), "linepal");
+            api.add(fun(&System::_linereset, this), "linereset");
+            //api.add(fun(&System::_map, this), "map");
+            api.add(fun(&System::_memcpy, this), "memcpy");
+            api.add(fun(&System::_memset, this), "memset");
+            api.add(fun(&System::_mget, this), "mget");
+            api.add(fun([this](int x, int y) { return _mget(x, y); }), "mget");
+            //api.add(fun(&System::_mouse, this), "mouse");
+            api.add(fun(&System::_mset, this), "mset");
+            api.add(fun([this](int x, int y, int sprite) { _mset(x, y, sprite); }), "mset");
+            api.add(fun(&System::_mode7, this), "mode7");
+            api.add(fun([this](int page, double a, double b, double c, double d, double tx, double ty) { _mode7(page, a, b, c, d, tx, ty); }), "mode7");
+            api.add(fun([this](int page, double a, double b, double c, double d, double tx, double ty, bool wrap) { _mode7(page, a, b, c, d, tx, ty, wrap); }), "mode7");
+            api.add(fun(&System::_mode7rows, this), "mode7");
+            api.add(fun([this](int page, std::vector<chaiscript::Boxed_Value> const& rows) { _mode7rows(page, rows); }), "mode7");
+            api.add(fun([this](int page, std::vector<chaiscript::Boxed_Value> const& rows, bool wrap) { _mode7rows(page, rows, wrap); }), "mode7");
+            api.add(fun(&System::_mode7buffer, this), "mode7");
+            api.add(fun([this](int page, Buffer const& rows) { _mode7buffer(page, rows); }), "mode7");
+            api.add(fun([this](int page, Buffer const& rows, bool wrap) { _mode7buffer(page, rows, wrap); }), "mode7");
+            api.add(fun([this]() { return _music_position(); }), "music");
+            api.add(fun([this](int track) { _music(track); }), "music");
+            api.add(fun([this](int track, int frame) { _music(track, frame); }), "music");
+            api.add(fun([this](int track, int frame, int row) { _music(track, frame, row); }), "music");
+            api.add(fun(&System::_music, this), "music");
+            api.add(fun(&System::_peek, this), "peek");
+            //api.add(fun(&System::_peek4, this), "peek4");
+            api.add(fun(&System::_pal, this), "pal");
+            api.add(fun([this](int table) { _pal(table, -1, 0); }), "pal");
+            api.add(fun(&System::_palset, this), "palset");
+            api.add(fun(&System::_path, this), "path");
+            api.add(fun([this](int x0, int y0, int x1, int y1) { return _path(x0, y0, x1, y1); }), "path");
+            api.add(fun([this](int x0, int y0, int x1, int y1, int mask) { return _path(x0, y0, x1, y1, mask); }), "path");
+            api.add(fun(&System::_pathasync, this), "pathasync");
+            api.add(fun([this](int x0, int y0, int x1, int y1) { return _pathasync(x0, y0, x1, y1); }), "pathasync");
+            api.add(fun([this](int x0, int y0, int x1, int y1, int mask) { return _pathasync(x0, y0, x1, y1, mask); }), "pathasync");
+            api.add(fun(&System::_pathdone, this), "pathdone");
+            api.add(fun(&System::_pathresult, this), "pathresult");
+            api.add(fun(&System::_pburst, this), "pburst");
+            api.add(fun(&System::_pclear, this), "pclear");
+            api.add(fun([this]() { for(int i = 0; i < particles::Emitters; i++) { _pclear(i); } }), "pclear");
+            api.add(fun(&System::_pcount, this), "pcount");
+            api.add(fun([this]() { return _particles.Count(); }), "pcount");
+            api.add(fun(&System::_pdraw, this), "pdraw");
+            api.add(fun([this]() { for(int i = 0; i < particles::Emitters; i++) { _pdraw(i); } }), "pdraw");
+            api.add(fun(&System::_pemit, this), "pemit");
+            api.add(fun(&System::_pforce, this), "pforce");
+            api.add(fun([this](int emitter, double gx, double gy) { _pforce(emitter, gx, gy); }), "pforce");
+            api.add(fun(&System::_pix, this), "pix");
+            api.add(fun(&System::_plot, this), "plot");
+            api.add(fun(&System::_plot_colors, this), "plot");
+            api.add(fun([this](int x, int y) -> int { return _pix(x, y); }), "pix");
+            api.add(fun(&System::_plife, this), "plife");
+            api.add(fun([this](int index) { return _pmem(index); }), "pmem");
+            api.add(fun([this](int index, std::uint32_t value) { return _pmem(index, value); }), "pmem");
+            api.add(fun(&System::_pmotion, this), "pmotion");
+            api.add(fun(&System::_poke, this), "poke");
+            api.add(fun(&System::_pramp, this), "pramp");
+            api.add(fun([this](int emitter, std::vector<chaiscript::Boxed_Value> const& ramp) { _pramp(emitter, ramp); }), "pramp");
+            //api.add(fun(&System::_poke4, this), "poke4");
+            //api.add(fun(&System::_text, this), "text");
+            api.add(fun(&System::_rect, this), "rect");
+            api.add(fun(&System::_raycast, this), "raycast");
+            api.add(fun([this](double x0, double y0, double x1, double y1) { return _raycast(x0, y0, x1, y1); }), "raycast");
+            api.add(fun([this](double x0, double y0, double x1, double y1, int mask) { return _raycast(x0, y0, x1, y1, mask); }), "raycast");
+            api.add(fun(&System::_rectb, this), "rectb");
+            api.add(fun(&System::_remap, this), "remap");
+            api.add(fun([this]() { _remap(-1); }), "remap");
+            api.add(fun(&System::_sfx, this), "sfx");
+            api.add(fun([this](int wave, double frequency) { _sfx(wave, frequency); }), "sfx");
+            api.add(fun([this](int wave, double frequency, int duration) { _sfx(wave, frequency, duration); }), "sfx");
+            api.add(fun([this](int wave, double frequency, int duration, int channel) { _sfx(wave, frequency, duration, channel); }), "sfx");
+            api.add(fun(&System::_envelope, this), "envelope");
+            //api.add(fun(&System::_spr, this), "spr");
+            api.add(fun(&System::_sspr, this), "sspr");
+            api.add(fun([this](int page, int sx, int sy, int sw, int sh, int dx, int dy, int dw, int dh) {
+                _sspr(page, sx, sy, sw, sh, dx, dy, dw, dh);
+            }), "sspr");
+            api.add(fun([this](int page, int sx, int sy, int sw, int sh, int dx, int dy, int dw, int dh, bool flipx) {
+                _sspr(page, sx, sy, sw, sh, dx, dy, dw, dh, flipx);
+            }), "sspr");
+            api.add(fun([this](int page, int sx, int sy, int sw, int sh, int dx, int dy, int dw, int dh, bool flipx, bool flipy) {
+                _sspr(page, sx, sy, sw, sh, dx, dy, dw, dh, flipx, flipy);
+            }), "sspr");
+            api.add(fun(&System::_sweep, this), "sweep");
+            api.add(fun([this](double x, double y, double w, double h, double dx, double dy) { return _sweep(x, y, w, h, dx, dy); }), "sweep");
+            api.add(fun([this](double x, double y, double w, double h, double dx, double dy, int mask) { return _sweep(x, y, w, h, dx, dy, mask); }), "sweep");
+            //api.add(fun(&System::_sync, this), "sync");
+            api.add(fun(&System::_target, this), "target");
+            api.add(fun([this]() { _target(-1); }), "target");
+            api.add(fun(&System::_time, this), "time");
+            api.add(fun(&System::_trace, this), "trace");
+            api.add(fun(&System::_tileline, this), "tileline");
+            api.add(fun([this](int x0, int y0, int x1, int y1) { return _tileline(x0, y0, x1, y1); }), "tileline");
+            api.add(fun([this](int x0, int y0, int x1, int y1, int mask) { return _tileline(x0, y0, x1, y1, mask); }), "tileline");
+            api.add(fun(&System::_tri, this), "tri");
+            api.add(fun(&System::_view, this), "view");
+            api.add(fun(&System::_textri, this), "textri");
+            api.add(fun([this](double x1, double y1, double x2, double y2, double x3, double y3, double u1, double v1, double u2, double v2, double u3, double v3) {
+                _textri(x1, y1, x2, y2, x3, y3, u1, v1, u2, v2, u3, v3);
+            }), "textri");
+            api.add(fun([this](double x1, double y1, double x2, double y2, double x3, double y3, double u1, double v1, double u2, double v2, double u3, double v3, int page) {
+                _textri(x1, y1, x2, y2, x3, y3, u1, v1, u2, v2, u3, v3, page);
+            }), "textri");
+            api.add(fun([this](double x1, double y1, double x2, double y2, double x3, double y3, double u1, double v1, double u2, double v2, double u3, double v3, int page, int trans) {
+                _textri(x1, y1, x2, y2, x3, y3, u1, v1, u2, v2, u3, v3, page, trans);
+            }), "textri");
+        }
+
+        // Blend tables for the default palette, built once and shared by every System
+        static std::shared_ptr<BlendTables const> const& DefaultBlendTables() {
+            static const auto tables = []() {
+                std::array<unsigned char, display::Size> registers;
+                display::Reset(registers.data());
+                return BlendTables::Build(registers.data() + display::PaletteOffset);
+            }();
+            return tables;
+        }
+
+        // The part of the scripting API that doesn't depend on a System: buffers and fixed point
+        // math. It is bound once, into the snapshot.
+        static chaiscript::ModulePtr SharedScriptApi() {
             using namespace chaiscript;
 
-            system = std::make_shared<System>();
-
-            auto & scriptEngine = system->ScriptEngine();
-
-            //scriptEngine.add(fun(&System::Scanline), "scanline");
-            scriptEngine.add(fun(&System::Btn), "btn");
-            scriptEngine.add(fun(&System::Btnp), "btnp");
-            scriptEngine.add(fun([](int id) -> bool { return System::Btnp(id); }), "btnp");
-            scriptEngine.add(fun([](int id, int hold) -> bool { return System::Btnp(id, hold); }), "btnp");
-            //scriptEngine.add(fun(&System::Clip), "clip");
-            scriptEngine.add(fun(&System::Cls), "cls");
-            scriptEngine.add(fun([]() { System::Cls(); }), "cls");
-            //scriptEngine.add(fun(&System::Circ), "circ");
-            //scriptEngine.add(fun(&System::Circb), "circb");
-            scriptEngine.add(fun(&System::Exit), "exit");
-            //scriptEngine.add(fun(&System::Font), "font");
-            //scriptEngine.add(fun(&System::Line), "line");
-            //scriptEngine.add(fun(&System::Map), "map");
-            //scriptEngine.add(fun(&System::Memcpy), "memcpy");
-            //scriptEngine.add(fun(&System::Memset), "memset");
-            //scriptEngine.add(fun(&System::Mget), "mget");
-            //scriptEngine.add(fun(&System::Mouse), "mouse");
-            //scriptEngine.add(fun(&System::Mset), "mset");
-            //scriptEngine.add(fun(&System::Music), "music");
-            //scriptEngine.add(fun(&System::Peek), "peek");
-            //scriptEngine.add(fun(&System::Peek4), "peek4");
-            scriptEngine.add(fun(&System::Pix), "pix");
-            scriptEngine.add(fun([](int x, int y) -> int { return System::Pix(x, y); }), "pix");
-            //scriptEngine.add(fun(&System::Pmem), "pmem");
-            //scriptEngine.add(fun(&System::Poke), "poke");
-            //scriptEngine.add(fun(&System::Poke4), "poke4");
-            //scriptEngine.add(fun(&System::Text), "text");
-            //scriptEngine.add(fun(&System::Rect), "rect");
-            //scriptEngine.add(fun(&System::Rectb), "rectb");
-            //scriptEngine.add(fun(&System::Sfx), "sfx");
-            //scriptEngine.add(fun(&System::Spr), "spr");
-            //scriptEngine.add(fun(&System::Sync), "sync");
-            scriptEngine.add(fun(&System::Time), "time");
-            scriptEngine.add(fun(&System::Trace), "trace");
-            //scriptEngine.add(fun(&System::Tri), "tri");
-            //scriptEngine.add(fun(&System::Textri), "textri");
-        }
-
-        static void UnitializeSystem() {
-            system = nullptr;
+            auto api = std::make_shared<Module>();
+
+            api->add(user_type<Buffer>(), "Buffer");
+            // No [] on purpose: it could only return a copy of the element, so b[i] = v and
+            // b[i] += n would silently change that copy instead of the buffer
+            api->add(fun(&System::BufferGet), "get");
+            api->add(fun(&Buffer::Set), "set");
+            // Integers would otherwise take the slow way through converting to double
+            api->add(fun([](Buffer & buffer, int index, int value) { buffer.Set(index, value); }), "set");
+            api->add(fun(&Buffer::Size), "size");
+            api->add(fun([](Buffer & buffer, double value) { buffer.Fill(value, 0, buffer.Size()); }), "fill");
+            api->add(fun(&Buffer::Fill), "fill");
+            api->add(fun([](Buffer & buffer, Buffer const& source) { buffer.Copy(0, source, 0, std::min(buffer.Size(), source.Size())); }), "copy");
+            api->add(fun(&Buffer::Copy), "copy");
+            api->add(fun(&System::BufferVector), "to_vector");
+            api->add(fun(&math::Add), "bufadd");
+            api->add(fun(&math::Lengths), "buflen");
+            api->add(fun([](Buffer & xs, Buffer & ys, int angle, int cx, int cy) { math::Rotate(xs, ys, angle, cx, cy); }), "bufrot");
+            api->add(fun(&math::Scale), "bufscale");
+            // The math functions are bound once each with exact types, which keeps the lookup
+            // and the argument conversion cheap
+            api->add(fun(&math::Atan2), "fatan2");
+            api->add(fun(&math::Cos), "fcos");
+            api->add(fun(&System::_fdiv), "fdiv");
+            api->add(fun(&System::_fix), "fix");
+            api->add(fun(&math::Length), "flen");
+            api->add(fun(&math::Mul), "fmul");
+            api->add(fun(&math::Sin), "fsin");
+            api->add(fun(&math::Sqrt), "fsqrt");
+            api->add(fun(&System::_unfix), "unfix");
+            api->add(fun(&System::_vdot), "vdot");
+            api->add(fun(&System::_vnorm), "vnorm");
+            api->add(fun(&System::_vrot), "vrot");
+
+            return api;
+        }
+
+        // Standard library, prelude (already parsed) and the shared part of the scripting API,
+        // built once and shared by every System
+        static chaiscript::ChaiScript::Snapshot const& ScriptSnapshot() {
+            static const auto snapshot = chaiscript::ChaiScript::snapshot(SharedScriptApi());
+            return snapshot;
         }
     };
 
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstdint>
+
+namespace drak {
+
+    // Generated tables for math.hpp, kept as data so every machine gets the same values.
+    // sine_quarter_data[i] is sin(i / 1024 of a quarter turn) in 16.16 fixed point and atan_data[i]
+    // is atan(i / 1024) in 1/65536 of a turn, both rounded.
+    constexpr int trig_data_steps = 1024;
+    constexpr std::int32_t sine_quarter_data[trig_data_steps + 1] = {
+        0, 101, 201, 302, 402, 503, 603, 704, 804, 905, 1005, 1106, 1206, 1307, 1407, 1508, 1608,
+        1709, 1809, 1910, 2010, 2111, 2211, 2312, 2412, 2513, 2613, 2714, 2814, 2914, 3015, 3115,
+        3216, 3316, 3417, 3517, 3617, 3718, 3818, 3918, 4019, 4119, 4219, 4320, 4420, 4520, 4621,
+        4721, 4821, 4921, 5022, 5122, 5222, 5322, 5422, 5523, 5623, 5723, 5823, 5923, 6023, 6123,
+        6224, 6324, 6424, 6524, 6624, 6724, 6824, 6924, 7024, 7124, 7224, 7323, 7423, 7523, 7623,
+        7723, 7823, 7923, 8022, 8122, 8222, 8322, 8421, 8521, 8621, 8720, 8820, 8919, 9019, 9119,
+        9218, 9318, 9417, 9517, 9616, 9716, 9815, 9914, 10014, 10113, 10212, 10312, 10411, 10510,
+        10609, 10709, 10808, 10907, 11006, 11105, 11204, 11303, 11402, 11501, 11600, 11699, 11798,
+        11897, 11996, 12095, 12193, 12292, 12391, 12490, 12588, 12687, 12785, 12884, 12983, 13081,
+        13180, 13278, 13376, 13475, 13573, 13672, 13770, 13868, 13966, 14065, 14163, 14261, 14359,
+        14457, 14555, 14653, 14751, 14849, 14947, 15045, 15143, 15240, 15338, 15436, 15534, 15631,
+        15729, 15826, 15924, 16021, 16119, 16216, 16314, 16411, 16508, 16606, 16703, 16800, 16897,
+        16994, 17091, 17188, 17285, 17382, 17479, 17576, 17673, 17770, 17867, 17963, 18060, 18156,
+        18253, 18350, 18446, 18543, 18639, 18735, 18832, 18928, 19024, 19120, 19216, 19313, 19409,
+        19505, 19600, 19696, 19792, 19888, 19984, 20080, 20175, 20271, 20366, 20462, 20557, 20653,
+        20748, 20844, 20939, 21034, 21129, 21224, 21320, 21415, 21510, 21604, 21699, 21794, 21889,
+        21984, 22078, 22173, 22268, 22362, 22457, 22551, 22645, 22740, 22834, 22928, 23022, 23116,
+        23210, 23304, 23398, 23492, 23586, 23680, 23774, 23867, 23961, 24054, 24148, 24241, 24335,
+        24428, 24521, 24614, 24708, 24801, 24894, 24987, 25080, 25172, 25265, 25358, 25451, 25543,
+        25636, 25728, 25821, 25913, 26005, 26098, 26190, 26282, 26374, 26466, 26558, 26650, 26742,
+        26833, 26925, 27017, 27108, 27200, 27291, 27382, 27474, 27565, 27656, 27747, 27838, 27929,
+        28020, 28111, 28202, 28293, 28383, 28474, 28564, 28655, 28745, 28835, 28926, 29016, 29106,
+        29196, 29286, 29376, 29466, 29555, 29645, 29735, 29824, 29914, 30003, 30093, 30182, 30271,
+        30360, 30449, 30538, 30627, 30716, 30805, 30893, 30982, 31071, 31159, 31248, 31336, 31424,
+        31512, 31600, 31688, 31776, 31864, 31952, 32040, 32127, 32215, 32303, 32390, 32477, 32565,
+        32652, 32739, 32826, 32913, 33000, 33087, 33173, 33260, 33347, 33433, 33520, 33606, 33692,
+        33778, 33865, 33951, 34037, 34122, 34208, 34294, 34380, 34465, 34551, 34636, 34721, 34806,
+        34892, 34977, 35062, 35146, 35231, 35316, 35401, 35485, 35570, 35654, 35738, 35823, 35907,
+        35991, 36075, 36159, 36243, 36326, 36410, 36493, 36577, 36660, 36744, 36827, 36910, 36993,
+        37076, 37159, 37241, 37324, 37407, 37489, 37572, 37654, 37736, 37818, 37900, 37982, 38064,
+        38146, 38228, 38309, 38391, 38472, 38554, 38635, 38716, 38797, 38878, 38959, 39040, 39120,
+        39201, 39282, 39362, 39442, 39523, 39603, 39683, 39763, 39843, 39922, 40002, 40082, 40161,
+        40241, 40320, 40399, 40478, 40557, 40636, 40715, 40794, 40872, 40951, 41029, 41108, 41186,
+        41264, 41342, 41420, 41498, 41576, 41653, 41731, 41808, 41886, 41963, 42040, 42117, 42194,
+        42271, 42348, 42424, 42501, 42578, 42654, 42730, 42806, 42882, 42958, 43034, 43110, 43186,
+        43261, 43337, 43412, 43487, 43562, 43638, 43713, 43787, 43862, 43937, 44011, 44086, 44160,
+        44234, 44308, 44382, 44456, 44530, 44604, 44677, 44751, 44824, 44898, 44971, 45044, 45117,
+        45190, 45262, 45335, 45408, 45480, 45552, 45625, 45697, 45769, 45841, 45912, 45984, 46056,
+        46127, 46199, 46270, 46341, 46412, 46483, 46554, 46624, 46695, 46765, 46836, 46906, 46976,
+        47046, 47116, 47186, 47256, 47325, 47395, 47464, 47534, 47603, 47672, 47741, 47809, 47878,
+        47947, 48015, 48084, 48152, 48220, 48288, 48356, 48424, 48491, 48559, 48626, 48694, 48761,
+        48828, 48895, 48962, 49029, 49095, 49162, 49228, 49295, 49361, 49427, 49493, 49559, 49624,
+        49690, 49756, 49821, 49886, 49951, 50016, 50081, 50146, 50211, 50275, 50340, 50404, 50468,
+        50532, 50596, 50660, 50724, 50787, 50851, 50914, 50977, 51041, 51104, 51166, 51229, 51292,
+        51354, 51417, 51479, 51541, 51603, 51665, 51727, 51789, 51850, 51911, 51973, 52034, 52095,
+        52156, 52217, 52277, 52338, 52398, 52459, 52519, 52579, 52639, 52699, 52759, 52818, 52878,
+        52937, 52996, 53055, 53114, 53173, 53232, 53290, 53349, 53407, 53465, 53523, 53581, 53639,
+        53697, 53754, 53812, 53869, 53926, 53983, 54040, 54097, 54154, 54210, 54267, 54323, 54379,
+        54435, 54491, 54547, 54603, 54658, 54714, 54769, 54824, 54879, 54934, 54989, 55043, 55098,
+        55152, 55206, 55260, 55314, 55368, 55422, 55476, 55529, 55582, 55636, 55689, 55742, 55794,
+        55847, 55900, 55952, 56004, 56056, 56108, 56160, 56212, 56264, 56315, 56367, 56418, 56469,
+        56520, 56571, 56621, 56672, 56722, 56773, 56823, 56873, 56923, 56972, 57022, 57072, 57121,
+        57170, 57219, 57268, 57317, 57366, 57414, 57463, 57511, 57559, 57607, 57655, 57703, 57750,
+        57798, 57845, 57892, 57939, 57986, 58033, 58079, 58126, 58172, 58219, 58265, 58311, 58356,
+        58402, 58448, 58493, 58538, 58583, 58628, 58673, 58718, 58763, 58807, 58851, 58896, 58940,
+        58983, 59027, 59071, 59114, 59158, 59201, 59244, 59287, 59330, 59372, 59415, 59457, 59499,
+        59541, 59583, 59625, 59667, 59708, 59750, 59791, 59832, 59873, 59914, 59954, 59995, 60035,
+        60075, 60116, 60156, 60195, 60235, 60275, 60314, 60353, 60392, 60431, 60470, 60509, 60547,
+        60586, 60624, 60662, 60700, 60738, 60776, 60813, 60851, 60888, 60925, 60962, 60999, 61035,
+        61072, 61108, 61145, 61181, 61217, 61253, 61288, 61324, 61359, 61394, 61429, 61464, 61499,
+        61534, 61568, 61603, 61637, 61671, 61705, 61739, 61772, 61806, 61839, 61873, 61906, 61939,
+        61971, 62004, 62036, 62069, 62101, 62133, 62165, 62197, 62228, 62260, 62291, 62322, 62353,
+        62384, 62415, 62445, 62476, 62506, 62536, 62566, 62596, 62626, 62655, 62685, 62714, 62743,
+        62772, 62801, 62830, 62858, 62886, 62915, 62943, 62971, 62998, 63026, 63054, 63081, 63108,
+        63135, 63162, 63189, 63215, 63242, 63268, 63294, 63320, 63346, 63372, 63397, 63423, 63448,
+        63473, 63498, 63523, 63547, 63572, 63596, 63621, 63645, 63668, 63692, 63716, 63739, 63763,
+        63786, 63809, 63832, 63854, 63877, 63899, 63922, 63944, 63966, 63987, 64009, 64031, 64052,
+        64073, 64094, 64115, 64136, 64156, 64177, 64197, 64217, 64237, 64257, 64277, 64296, 64316,
+        64335, 64354, 64373, 64392, 64410, 64429, 64447, 64465, 64483, 64501, 64519, 64536, 64554,
+        64571, 64588, 64605, 64622, 64639, 64655, 64672, 64688, 64704, 64720, 64735, 64751, 64766,
+        64782, 64797, 64812, 64827, 64841, 64856, 64870, 64884, 64899, 64912, 64926, 64940, 64953,
+        64967, 64980, 64993, 65006, 65018, 65031, 65043, 65055, 65067, 65079, 65091, 65103, 65114,
+        65126, 65137, 65148, 65159, 65169, 65180, 65190, 65200, 65210, 65220, 65230, 65240, 65249,
+        65259, 65268, 65277, 65286, 65294, 65303, 65311, 65320, 65328, 65336, 65343, 65351, 65358,
+        65366, 65373, 65380, 65387, 65393, 65400, 65406, 65413, 65419, 65425, 65430, 65436, 65442,
+        65447, 65452, 65457, 65462, 65467, 65471, 65476, 65480, 65484, 65488, 65492, 65495, 65499,
+        65502, 65505, 65508, 65511, 65514, 65516, 65519, 65521, 65523, 65525, 65527, 65528, 65530,
+        65531, 65532, 65533, 65534, 65535, 65535, 65536, 65536, 65536,
+    };
+    constexpr std::int32_t atan_data[trig_data_steps + 1] = {
+        0, 10, 20, 31, 41, 51, 61, 71, 81, 92, 102, 112, 122, 132, 143, 153, 163, 173, 183, 194,
+        204, 214, 224, 234, 244, 255, 265, 275, 285, 295, 305, 316, 326, 336, 346, 356, 367, 377,
+        387, 397, 407, 417, 428, 438, 448, 458, 468, 478, 489, 499, 509, 519, 529, 539, 550, 560,
+        570, 580, 590, 600, 610, 621, 631, 641, 651, 661, 671, 681, 692, 702, 712, 722, 732, 742,
+        752, 763, 773, 783, 793, 803, 813, 823, 833, 844, 854, 864, 874, 884, 894, 904, 914, 924,
+        935, 945, 955, 965, 975, 985, 995, 1005, 1015, 1025, 1036, 1046, 1056, 1066, 1076, 1086,
+        1096, 1106, 1116, 1126, 1136, 1146, 1156, 1166, 1177, 1187, 1197, 1207, 1217, 1227, 1237,
+        1247, 1257, 1267, 1277, 1287, 1297, 1307, 1317, 1327, 1337, 1347, 1357, 1367, 1377, 1387,
+        1397, 1407, 1417, 1427, 1437, 1447, 1457, 1467, 1477, 1487, 1497, 1507, 1517, 1527, 1537,
+        1547, 1557, 1567, 1577, 1587, 1597, 1607, 1617, 1627, 1637, 1646, 1656, 1666, 1676, 1686,
+        1696, 1706, 1716, 1726, 1736, 1746, 1756, 1765, 1775, 1785, 1795, 1805, 1815, 1825, 1835,
+        1845, 1854, 1864, 1874, 1884, 1894, 1904, 1914, 1923, 1933, 1943, 1953, 1963, 1973, 1982,
+        1992, 2002, 2012, 2022, 2031, 2041, 2051, 2061, 2071, 2080, 2090, 2100, 2110, 2120, 2129,
+        2139, 2149, 2159, 2168, 2178, 2188, 2198, 2207, 2217, 2227, 2237, 2246, 2256, 2266, 2275,
+        2285, 2295, 2305, 2314, 2324, 2334, 2343, 2353, 2363, 2372, 2382, 2392, 2401, 2411, 2421,
+        2430, 2440, 2450, 2459, 2469, 2478, 2488, 2498, 2507, 2517, 2526, 2536, 2546, 2555, 2565,
+        2574, 2584, 2594, 2603, 2613, 2622, 2632, 2641, 2651, 2660, 2670, 2679, 2689, 2699, 2708,
+        2718, 2727, 2737, 2746, 2756, 2765, 2775, 2784, 2793, 2803, 2812, 2822, 2831, 2841, 2850,
+        2860, 2869, 2879, 2888, 2897, 2907, 2916, 2926, 2935, 2944, 2954, 2963, 2973, 2982, 2991,
+        3001, 3010, 3019, 3029, 3038, 3047, 3057, 3066, 3075, 3085, 3094, 3103, 3113, 3122, 3131,
+        3141, 3150, 3159, 3168, 3178, 3187, 3196, 3206, 3215, 3224, 3233, 3243, 3252, 3261, 3270,
+        3279, 3289, 3298, 3307, 3316, 3325, 3335, 3344, 3353, 3362, 3371, 3380, 3390, 3399, 3408,
+        3417, 3426, 3435, 3444, 3453, 3463, 3472, 3481, 3490, 3499, 3508, 3517, 3526, 3535, 3544,
+        3553, 3562, 3571, 3580, 3589, 3599, 3608, 3617, 3626, 3635, 3644, 3653, 3662, 3670, 3679,
+        3688, 3697, 3706, 3715, 3724, 3733, 3742, 3751, 3760, 3769, 3778, 3787, 3796, 3804, 3813,
+        3822, 3831, 3840, 3849, 3858, 3867, 3875, 3884, 3893, 3902, 3911, 3920, 3928, 3937, 3946,
+        3955, 3964, 3972, 3981, 3990, 3999, 4007, 4016, 4025, 4034, 4042, 4051, 4060, 4069, 4077,
+        4086, 4095, 4103, 4112, 4121, 4129, 4138, 4147, 4155, 4164, 4173, 4181, 4190, 4199, 4207,
+        4216, 4224, 4233, 4242, 4250, 4259, 4267, 4276, 4284, 4293, 4302, 4310, 4319, 4327, 4336,
+        4344, 4353, 4361, 4370, 4378, 4387, 4395, 4404, 4412, 4421, 4429, 4438, 4446, 4454, 4463,
+        4471, 4480, 4488, 4497, 4505, 4513, 4522, 4530, 4539, 4547, 4555, 4564, 4572, 4580, 4589,
+        4597, 4605, 4614, 4622, 4630, 4639, 4647, 4655, 4663, 4672, 4680, 4688, 4697, 4705, 4713,
+        4721, 4730, 4738, 4746, 4754, 4762, 4771, 4779, 4787, 4795, 4803, 4812, 4820, 4828, 4836,
+        4844, 4852, 4860, 4869, 4877, 4885, 4893, 4901, 4909, 4917, 4925, 4933, 4941, 4949, 4958,
+        4966, 4974, 4982, 4990, 4998, 5006, 5014, 5022, 5030, 5038, 5046, 5054, 5062, 5070, 5078,
+        5086, 5094, 5101, 5109, 5117, 5125, 5133, 5141, 5149, 5157, 5165, 5173, 5181, 5188, 5196,
+        5204, 5212, 5220, 5228, 5235, 5243, 5251, 5259, 5267, 5275, 5282, 5290, 5298, 5306, 5313,
+        5321, 5329, 5337, 5344, 5352, 5360, 5368, 5375, 5383, 5391, 5398, 5406, 5414, 5421, 5429,
+        5437, 5444, 5452, 5460, 5467, 5475, 5483, 5490, 5498, 5505, 5513, 5521, 5528, 5536, 5543,
+        5551, 5559, 5566, 5574, 5581, 5589, 5596, 5604, 5611, 5619, 5626, 5634, 5641, 5649, 5656,
+        5664, 5671, 5679, 5686, 5694, 5701, 5708, 5716, 5723, 5731, 5738, 5745, 5753, 5760, 5768,
+        5775, 5782, 5790, 5797, 5804, 5812, 5819, 5826, 5834, 5841, 5848, 5856, 5863, 5870, 5878,
+        5885, 5892, 5899, 5907, 5914, 5921, 5928, 5936, 5943, 5950, 5957, 5964, 5972, 5979, 5986,
+        5993, 6000, 6008, 6015, 6022, 6029, 6036, 6043, 6050, 6058, 6065, 6072, 6079, 6086, 6093,
+        6100, 6107, 6114, 6121, 6128, 6135, 6142, 6150, 6157, 6164, 6171, 6178, 6185, 6192, 6199,
+        6206, 6213, 6220, 6227, 6234, 6240, 6247, 6254, 6261, 6268, 6275, 6282, 6289, 6296, 6303,
+        6310, 6317, 6323, 6330, 6337, 6344, 6351, 6358, 6365, 6371, 6378, 6385, 6392, 6399, 6406,
+        6412, 6419, 6426, 6433, 6440, 6446, 6453, 6460, 6467, 6473, 6480, 6487, 6493, 6500, 6507,
+        6514, 6520, 6527, 6534, 6540, 6547, 6554, 6560, 6567, 6574, 6580, 6587, 6594, 6600, 6607,
+        6613, 6620, 6627, 6633, 6640, 6646, 6653, 6660, 6666, 6673, 6679, 6686, 6692, 6699, 6705,
+        6712, 6718, 6725, 6731, 6738, 6744, 6751, 6757, 6764, 6770, 6777, 6783, 6790, 6796, 6803,
+        6809, 6815, 6822, 6828, 6835, 6841, 6848, 6854, 6860, 6867, 6873, 6879, 6886, 6892, 6898,
+        6905, 6911, 6917, 6924, 6930, 6936, 6943, 6949, 6955, 6962, 6968, 6974, 6980, 6987, 6993,
+        6999, 7005, 7012, 7018, 7024, 7030, 7037, 7043, 7049, 7055, 7061, 7068, 7074, 7080, 7086,
+        7092, 7098, 7105, 7111, 7117, 7123, 7129, 7135, 7141, 7147, 7154, 7160, 7166, 7172, 7178,
+        7184, 7190, 7196, 7202, 7208, 7214, 7220, 7226, 7232, 7238, 7244, 7250, 7256, 7262, 7268,
+        7274, 7280, 7286, 7292, 7298, 7304, 7310, 7316, 7322, 7328, 7334, 7340, 7346, 7352, 7358,
+        7363, 7369, 7375, 7381, 7387, 7393, 7399, 7405, 7411, 7416, 7422, 7428, 7434, 7440, 7446,
+        7451, 7457, 7463, 7469, 7475, 7480, 7486, 7492, 7498, 7503, 7509, 7515, 7521, 7526, 7532,
+        7538, 7544, 7549, 7555, 7561, 7566, 7572, 7578, 7584, 7589, 7595, 7601, 7606, 7612, 7618,
+        7623, 7629, 7635, 7640, 7646, 7651, 7657, 7663, 7668, 7674, 7679, 7685, 7691, 7696, 7702,
+        7707, 7713, 7718, 7724, 7730, 7735, 7741, 7746, 7752, 7757, 7763, 7768, 7774, 7779, 7785,
+        7790, 7796, 7801, 7807, 7812, 7818, 7823, 7828, 7834, 7839, 7845, 7850, 7856, 7861, 7866,
+        7872, 7877, 7883, 7888, 7893, 7899, 7904, 7910, 7915, 7920, 7926, 7931, 7936, 7942, 7947,
+        7952, 7958, 7963, 7968, 7974, 7979, 7984, 7990, 7995, 8000, 8005, 8011, 8016, 8021, 8026,
+        8032, 8037, 8042, 8047, 8053, 8058, 8063, 8068, 8074, 8079, 8084, 8089, 8094, 8100, 8105,
+        8110, 8115, 8120, 8125, 8131, 8136, 8141, 8146, 8151, 8156, 8161, 8166, 8172, 8177, 8182,
+        8187, 8192,
+    };
+
+}
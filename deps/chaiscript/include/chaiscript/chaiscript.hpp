@@ -839,6 +839,36 @@ namespace chaiscript
             t_modulepaths, t_usepaths, t_opts)
         {
         }
+
+      /// \brief Starts from a Snapshot instead of bootstrapping the standard library again
+      /// \sa ChaiScript::snapshot
+      explicit ChaiScript(const Snapshot &t_snapshot,
+          std::vector<std::string> t_modulepaths = {},
+          std::vector<std::string> t_usepaths = {})
+        : ChaiScript_Basic(
+            t_snapshot,
+            std::make_unique<parser::ChaiScript_Parser<eval::Noop_Tracer, optimizer::Optimizer_Default>>(),
+            t_modulepaths, t_usepaths)
+        {
+        }
+
+      /// \brief Bootstraps the standard library and t_lib once and returns a Snapshot that any
+      ///        number of ChaiScript instances can then be constructed from
+      ///
+      /// \b Example:
+      /// \code
+      /// static const auto s = chaiscript::ChaiScript::snapshot(my_bindings());
+      /// chaiscript::ChaiScript chai(s);
+      /// \endcode
+      /// \sa ChaiScript_Basic::make_snapshot
+      static Snapshot snapshot(const ModulePtr &t_lib = ModulePtr(),
+          const std::vector<std::string> &t_scripts = {},
+          const std::vector<Options> &t_opts = chaiscript::default_options())
+      {
+        return make_snapshot({chaiscript::Std_Lib::library(), t_lib},
+            std::make_unique<parser::ChaiScript_Parser<eval::Noop_Tracer, optimizer::Optimizer_Default>>(),
+            t_scripts, t_opts);
+      }
   };
 }
 
@@ -211,7 +211,9 @@ namespace chaiscript {
     No_Load_Modules,
     Load_Modules,
     No_External_Scripts,
-    External_Scripts
+    External_Scripts,
+    No_Bytecode,
+    Bytecode
   };
 
   static inline std::vector<Options> default_options()
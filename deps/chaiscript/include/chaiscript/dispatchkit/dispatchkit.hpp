@@ -20,11 +20,13 @@
 #include <stdexcept>
 #include <string>
 #include <typeinfo>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "../chaiscript_defines.hpp"
 #include "../chaiscript_threading.hpp"
+#include "../utility/symbol_table.hpp"
 #include "bad_boxed_cast.hpp"
 #include "boxed_cast.hpp"
 #include "boxed_cast_helper.hpp"
@@ -447,8 +449,11 @@ namespace chaiscript
           std::vector<std::pair<std::string, std::shared_ptr<std::vector<Proxy_Function>>>> m_functions;
           std::vector<std::pair<std::string, Proxy_Function>> m_function_objects;
           std::vector<std::pair<std::string, Boxed_Value>> m_boxed_functions;
-          std::map<std::string, Boxed_Value> m_global_objects;
+          /// Position of each function name in the three function tables above, which are kept in step
+          std::unordered_map<utility::Symbol, size_t> m_function_index;
+          std::unordered_map<utility::Symbol, Boxed_Value> m_global_objects;
           Type_Name_Map m_types;
+          std::unordered_map<utility::Symbol, Type_Info> m_type_index;
         };
 
         explicit Dispatch_Engine(chaiscript::parser::ChaiScript_Parser_Base &parser)
@@ -555,25 +560,29 @@ namespace chaiscript
             throw chaiscript::exception::global_non_const();
           }
 
+          const auto symbol = utility::Symbol_Table::global().intern(name);
+
           chaiscript::detail::threading::unique_lock<chaiscript::detail::threading::shared_mutex> l(m_mutex);
 
-          if (m_state.m_global_objects.find(name) != m_state.m_global_objects.end())
+          if (m_state.m_global_objects.find(symbol) != m_state.m_global_objects.end())
           {
             throw chaiscript::exception::name_conflict_error(name);
           } else {
-            m_state.m_global_objects.insert(std::make_pair(name, obj));
+            m_state.m_global_objects.insert(std::make_pair(symbol, obj));
           }
         }
 
         /// Adds a new global (non-const) shared object, between all the threads
         Boxed_Value add_global_no_throw(const Boxed_Value &obj, const std::string &name)
         {
+          const auto symbol = utility::Symbol_Table::global().intern(name);
+
           chaiscript::detail::threading::unique_lock<chaiscript::detail::threading::shared_mutex> l(m_mutex);
 
-          const auto itr = m_state.m_global_objects.find(name);
+          const auto itr = m_state.m_global_objects.find(symbol);
           if (itr == m_state.m_global_objects.end())
           {
-            m_state.m_global_objects.insert(std::make_pair(name, obj));
+            m_state.m_global_objects.insert(std::make_pair(symbol, obj));
             return obj;
           } else {
             return itr->second;
@@ -584,27 +593,31 @@ namespace chaiscript
         /// Adds a new global (non-const) shared object, between all the threads
         void add_global(const Boxed_Value &obj, const std::string &name)
         {
+          const auto symbol = utility::Symbol_Table::global().intern(name);
+
           chaiscript::detail::threading::unique_lock<chaiscript::detail::threading::shared_mutex> l(m_mutex);
 
-          if (m_state.m_global_objects.find(name) != m_state.m_global_objects.end())
+          if (m_state.m_global_objects.find(symbol) != m_state.m_global_objects.end())
           {
             throw chaiscript::exception::name_conflict_error(name);
           } else {
-            m_state.m_global_objects.insert(std::make_pair(name, obj));
+            m_state.m_global_objects.insert(std::make_pair(symbol, obj));
           }
         }
 
         /// Updates an existing global shared object or adds a new global shared object if not found
         void set_global(const Boxed_Value &obj, const std::string &name)
         {
+          const auto symbol = utility::Symbol_Table::global().intern(name);
+
           chaiscript::detail::threading::unique_lock<chaiscript::detail::threading::shared_mutex> l(m_mutex);
 
-          const auto itr = m_state.m_global_objects.find(name);
+          const auto itr = m_state.m_global_objects.find(symbol);
           if (itr != m_state.m_global_objects.end())
           {
             itr->second.assign(obj);
           } else {
-            m_state.m_global_objects.insert(std::make_pair(name, obj));
+            m_state.m_global_objects.insert(std::make_pair(symbol, obj));
           }
         }
 
@@ -655,6 +668,13 @@ namespace chaiscript
         /// includes a special overload for the _ place holder object to
         /// ensure that it is always in scope.
         Boxed_Value get_object(const std::string &name, std::atomic_uint_fast32_t &t_loc, Stack_Holder &t_holder) const
+        {
+          return get_object(name, utility::Symbol_Table::global().find(name), t_loc, t_holder);
+        }
+
+        /// \copydoc get_object
+        /// \param t_symbol interned form of name, used for the global and function lookups
+        Boxed_Value get_object(const std::string &name, const utility::Symbol t_symbol, std::atomic_uint_fast32_t &t_loc, Stack_Holder &t_holder) const
         {
           enum class Loc : uint_fast32_t {
             located    = 0x80000000,
@@ -694,14 +714,14 @@ namespace chaiscript
           // Is the value we are looking for a global or function?
           chaiscript::detail::threading::shared_lock<chaiscript::detail::threading::shared_mutex> l(m_mutex);
 
-          const auto itr = m_state.m_global_objects.find(name);
+          const auto itr = m_state.m_global_objects.find(t_symbol);
           if (itr != m_state.m_global_objects.end())
           {
             return itr->second;
           }
 
           // no? is it a function object?
-          auto obj = get_function_object_int(name, loc);
+          auto obj = get_function_object_int(name, t_symbol, loc);
           if (obj.first != loc) { t_loc = uint_fast32_t(obj.first); }
 
           return obj.second;
@@ -713,19 +733,24 @@ namespace chaiscript
         {
           add_global_const(const_var(ti), name + "_type");
 
+          const auto symbol = utility::Symbol_Table::global().intern(name);
+
           chaiscript::detail::threading::unique_lock<chaiscript::detail::threading::shared_mutex> l(m_mutex);
 
           m_state.m_types.insert(std::make_pair(name, ti));
+          m_state.m_type_index.insert(std::make_pair(symbol, ti));
         }
 
         /// Returns the type info for a named type
         Type_Info get_type(const std::string &name, bool t_throw = true) const
         {
+          const auto symbol = utility::Symbol_Table::global().find(name);
+
           chaiscript::detail::threading::shared_lock<chaiscript::detail::threading::shared_mutex> l(m_mutex);
 
-          const auto itr = m_state.m_types.find(name);
+          const auto itr = m_state.m_type_index.find(symbol);
 
-          if (itr != m_state.m_types.end())
+          if (itr != m_state.m_type_index.end())
           {
             return itr->second;
           }
@@ -782,11 +807,11 @@ namespace chaiscript
 
           const auto &funs = get_functions_int();
 
-          auto itr = find_keyed_value(funs, t_name, t_hint);
+          const auto idx = find_function_index(t_name, t_hint);
 
-          if (itr != funs.end())
+          if (idx != npos)
           {
-            return std::make_pair(std::distance(funs.begin(), itr), itr->second);
+            return std::make_pair(idx, funs[idx].second);
           } else {
             return std::make_pair(size_t(0), std::make_shared<std::vector<Proxy_Function>>());
           }
@@ -805,14 +830,19 @@ namespace chaiscript
         /// \throws std::range_error if it does not
         /// \warn does not obtain a mutex lock. \sa get_function_object for public version
         std::pair<size_t, Boxed_Value> get_function_object_int(const std::string &t_name, const size_t t_hint) const
+        {
+          return get_function_object_int(t_name, utility::Symbol_Table::global().find(t_name), t_hint);
+        }
+
+        std::pair<size_t, Boxed_Value> get_function_object_int(const std::string &t_name, const utility::Symbol t_symbol, const size_t t_hint) const
         {
           const auto &funs = get_boxed_functions_int();
 
-          auto itr = find_keyed_value(funs, t_name, t_hint);
+          const auto idx = find_function_index(t_name, t_symbol, t_hint);
 
-          if (itr != funs.end())
+          if (idx != npos)
           {
-            return std::make_pair(std::distance(funs.begin(), itr), itr->second);
+            return std::make_pair(idx, funs[idx].second);
           } else {
             throw std::range_error("Object not found: " + t_name);
           }
@@ -824,8 +854,7 @@ namespace chaiscript
         {
           chaiscript::detail::threading::shared_lock<chaiscript::detail::threading::shared_mutex> l(m_mutex);
 
-          const auto &functions = get_functions_int();
-          return find_keyed_value(functions, name) != functions.end();
+          return find_function_index(utility::Symbol_Table::global().find(name)) != npos;
         }
 
         /// \returns All values in the local thread state in the parent scope, or if it doesn't exist,
@@ -883,7 +912,10 @@ namespace chaiscript
 
           // add the global values
           chaiscript::detail::threading::shared_lock<chaiscript::detail::threading::shared_mutex> l(m_mutex);
-          retval.insert(m_state.m_global_objects.begin(), m_state.m_global_objects.end());
+          for (const auto &global : m_state.m_global_objects)
+          {
+            retval.insert(std::make_pair(utility::Symbol_Table::global().name(global.first), global.second));
+          }
 
           return retval;
         }
@@ -1202,6 +1234,68 @@ namespace chaiscript
           chaiscript::detail::threading::unique_lock<chaiscript::detail::threading::shared_mutex> l(m_mutex);
 
           m_state = t_state;
+          ++m_function_generation;
+        }
+
+        /// Replaces the global state with t_base, then registers this engine's own functions,
+        /// globals and types on top of it. Functions are added as extra overloads, while globals
+        /// and types of the same name replace the ones in t_base. Used to start an engine from a
+        /// snapshot while keeping the functions bound to this engine.
+        void adopt_state(const State &t_base)
+        {
+          State own;
+
+          {
+            chaiscript::detail::threading::unique_lock<chaiscript::detail::threading::shared_mutex> l(m_mutex);
+
+            own = std::move(m_state);
+            m_state = t_base;
+
+            for (const auto &global : own.m_global_objects) {
+              m_state.m_global_objects[global.first] = global.second;
+            }
+
+            for (const auto &type : own.m_types) {
+              m_state.m_types[type.first] = type.second;
+            }
+
+            for (const auto &type : own.m_type_index) {
+              m_state.m_type_index[type.first] = type.second;
+            }
+
+            ++m_function_generation;
+          }
+
+          for (const auto &funcs : own.m_functions) {
+            for (const auto &func : *funcs.second) {
+              add_function(func, funcs.first);
+            }
+          }
+        }
+
+        /// \returns a counter that changes whenever the set of registered functions changes,
+        /// allowing call sites to validate cached dispatch decisions without a name lookup
+        uint_fast32_t function_generation() const noexcept
+        {
+          return m_function_generation;
+        }
+
+        /// \returns an id no other engine in the process has, for caches shared between engines.
+        ///          Unlike the engine's address it is never reused once the engine is gone.
+        uint_fast64_t id() const noexcept
+        {
+          return m_id;
+        }
+
+        /// \returns whether compiled operator expressions run on the bytecode VM
+        bool bytecode_enabled() const noexcept
+        {
+          return m_bytecode_enabled;
+        }
+
+        void set_bytecode_enabled(const bool t_enabled) noexcept
+        {
+          m_bytecode_enabled = t_enabled;
         }
 
         static void save_function_params(Stack_Holder &t_s, std::initializer_list<Boxed_Value> t_params)
@@ -1417,47 +1511,33 @@ namespace chaiscript
 
 
 
-        template<typename Container, typename Key, typename Value>
-          static void add_keyed_value(Container &t_c, const Key &t_key, Value &&t_value)
-          {
-            auto itr = find_keyed_value(t_c, t_key);
-
-            if (itr == t_c.end()) {
-              t_c.reserve(t_c.size() + 1); // tightly control growth of memory usage here
-              t_c.emplace_back(t_key, std::forward<Value>(t_value));
-            } else {
-              typedef typename Container::value_type value_type;
-              *itr = value_type(t_key, std::forward<Value>(t_value));
-            }
-          }
+        static constexpr size_t npos = static_cast<size_t>(-1);
 
-        template<typename Container, typename Key>
-        static typename Container::iterator find_keyed_value(Container &t_c, const Key &t_key)
-          {
-            return std::find_if(t_c.begin(), t_c.end(), 
-                [&t_key](const typename Container::value_type &o) {
-                  return o.first == t_key;
-                });
-          }
+        /// \returns the position of t_symbol in the function tables, or npos
+        size_t find_function_index(const utility::Symbol t_symbol) const
+        {
+          const auto itr = m_state.m_function_index.find(t_symbol);
+          return itr != m_state.m_function_index.end() ? itr->second : npos;
+        }
 
-        template<typename Container, typename Key>
-        static typename Container::const_iterator find_keyed_value(const Container &t_c, const Key &t_key)
-          {
-            return std::find_if(t_c.begin(), t_c.end(), 
-                [&t_key](const typename Container::value_type &o) {
-                  return o.first == t_key;
-                });
+        /// Checks the call site's cached position first and only falls back to the symbol index on a miss
+        size_t find_function_index(const std::string &t_name, const utility::Symbol t_symbol, const size_t t_hint) const
+        {
+          const auto &funs = get_functions_int();
+          if (funs.size() > t_hint && funs[t_hint].first == t_name) {
+            return t_hint;
           }
+          return find_function_index(t_symbol);
+        }
 
-        template<typename Container, typename Key>
-        static typename Container::const_iterator find_keyed_value(const Container &t_c, const Key &t_key, const size_t t_hint)
-          {
-            if (t_c.size() > t_hint && t_c[t_hint].first == t_key) {
-              return std::next(t_c.begin(), static_cast<typename std::iterator_traits<typename Container::const_iterator>::difference_type>(t_hint));
-            } else {
-              return find_keyed_value(t_c, t_key);
-            }
+        size_t find_function_index(const std::string &t_name, const size_t t_hint) const
+        {
+          const auto &funs = get_functions_int();
+          if (funs.size() > t_hint && funs[t_hint].first == t_name) {
+            return t_hint;
           }
+          return find_function_index(utility::Symbol_Table::global().find(t_name));
+        }
 
 
         /// Implementation detail for adding a function. 
@@ -1468,13 +1548,15 @@ namespace chaiscript
 
           auto &funcs = get_functions_int();
 
-          auto itr = find_keyed_value(funcs, t_name);
+          const auto symbol = utility::Symbol_Table::global().intern(t_name);
+          const auto idx = find_function_index(symbol);
 
           Proxy_Function new_func =
             [&]() -> Proxy_Function {
-              if (itr != funcs.end())
+              if (idx != npos)
               {
-                auto vec = *itr->second;
+                auto &entry = funcs[idx];
+                auto vec = *entry.second;
                 for (const auto &func : vec)
                 {
                   if ((*t_f) == *(func))
@@ -1486,7 +1568,7 @@ namespace chaiscript
                 vec.reserve(vec.size() + 1); // tightly control vec growth
                 vec.push_back(t_f);
                 std::stable_sort(vec.begin(), vec.end(), &function_less_than);
-                itr->second = std::make_shared<std::vector<Proxy_Function>>(vec);
+                entry.second = std::make_shared<std::vector<Proxy_Function>>(vec);
                 return std::make_shared<Dispatch_Function>(std::move(vec));
               } else if (t_f->has_arithmetic_param()) {
                 // if the function is the only function but it also contains
@@ -1501,8 +1583,15 @@ namespace chaiscript
               }
             }();
 
-          add_keyed_value(get_boxed_functions_int(), t_name, const_var(new_func));
-          add_keyed_value(get_function_objects_int(), t_name, std::move(new_func));
+          if (idx != npos) {
+            get_boxed_functions_int()[idx].second = const_var(new_func);
+            get_function_objects_int()[idx].second = std::move(new_func);
+          } else {
+            m_state.m_function_index.emplace(symbol, funcs.size() - 1);
+            get_boxed_functions_int().emplace_back(t_name, const_var(new_func));
+            get_function_objects_int().emplace_back(t_name, std::move(new_func));
+          }
+          ++m_function_generation;
         }
 
         mutable chaiscript::detail::threading::shared_mutex m_mutex;
@@ -1513,6 +1602,15 @@ namespace chaiscript
         std::reference_wrapper<parser::ChaiScript_Parser_Base> m_parser;
 
         mutable std::atomic_uint_fast32_t m_method_missing_loc = {0};
+        std::atomic_uint_fast32_t m_function_generation = {0};
+        std::atomic_bool m_bytecode_enabled = {true};
+        const uint_fast64_t m_id = next_id();
+
+        static uint_fast64_t next_id() noexcept
+        {
+          static std::atomic<uint_fast64_t> s_next_id = {0};
+          return ++s_next_id;
+        }
 
         State m_state;
     };
@@ -1559,6 +1657,10 @@ namespace chaiscript
           return m_engine.get().get_object(t_name, t_loc, m_stack_holder.get());
         }
 
+        Boxed_Value get_object(const std::string &t_name, const utility::Symbol t_symbol, std::atomic_uint_fast32_t &t_loc) const {
+          return m_engine.get().get_object(t_name, t_symbol, t_loc, m_stack_holder.get());
+        }
+
       private:
         std::reference_wrapper<Dispatch_Engine> m_engine;
         std::reference_wrapper<Stack_Holder> m_stack_holder;
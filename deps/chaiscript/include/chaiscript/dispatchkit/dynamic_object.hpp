@@ -12,9 +12,12 @@
 #define CHAISCRIPT_DYNAMIC_OBJECT_HPP_
 
 #include <map>
+#include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
+#include "../chaiscript_threading.hpp"
 #include "boxed_value.hpp"
 
 namespace chaiscript {
@@ -40,11 +43,101 @@ namespace chaiscript
       ~option_explicit_set() noexcept override = default;
     };
 
+    /// Hidden class describing the attribute layout of a Dynamic_Object.
+    ///
+    /// Every Dynamic_Object refers to a shape which maps attribute names to slot
+    /// indices. Shapes are immutable once published; adding an attribute moves the
+    /// object along a cached transition to a child shape, so objects of the same
+    /// class that add their attributes in the same order share one shape. This lets
+    /// callers cache a (shape, slot) pair and skip the name lookup entirely.
+    class Dynamic_Object_Shape
+    {
+      public:
+        static constexpr size_t npos = static_cast<size_t>(-1);
+
+        explicit Dynamic_Object_Shape(std::string t_type_name)
+          : m_type_name(std::move(t_type_name))
+        {
+        }
+
+        Dynamic_Object_Shape(const Dynamic_Object_Shape &) = delete;
+        Dynamic_Object_Shape &operator=(const Dynamic_Object_Shape &) = delete;
+
+        /// \returns the shared, attribute-less shape for objects of the given type name
+        static std::shared_ptr<const Dynamic_Object_Shape> root(const std::string &t_type_name)
+        {
+          static chaiscript::detail::threading::mutex s_mutex;
+          static std::map<std::string, std::shared_ptr<const Dynamic_Object_Shape>> s_roots;
+
+          chaiscript::detail::threading::lock_guard<chaiscript::detail::threading::mutex> l(s_mutex);
+
+          auto &shape = s_roots[t_type_name];
+          if (!shape) {
+            shape = std::make_shared<const Dynamic_Object_Shape>(t_type_name);
+          }
+          return shape;
+        }
+
+        const std::string &type_name() const noexcept
+        {
+          return m_type_name;
+        }
+
+        size_t size() const noexcept
+        {
+          return m_names.size();
+        }
+
+        /// \returns the slot name at index t_slot, in insertion order
+        const std::string &attr_name(const size_t t_slot) const
+        {
+          return m_names[t_slot];
+        }
+
+        /// \returns the slot index of t_attr_name, or npos if this shape does not have it
+        size_t find(const std::string &t_attr_name) const
+        {
+          const auto itr = m_slots.find(t_attr_name);
+          return itr != m_slots.end() ? itr->second : npos;
+        }
+
+        /// \returns the shape reached by appending t_attr_name to this shape's attributes
+        std::shared_ptr<const Dynamic_Object_Shape> add(const std::string &t_attr_name) const
+        {
+          chaiscript::detail::threading::lock_guard<chaiscript::detail::threading::mutex> l(m_mutex);
+
+          auto &child = m_transitions[t_attr_name];
+          if (!child) {
+            auto shape = std::make_shared<Dynamic_Object_Shape>(m_type_name);
+            shape->m_names = m_names;
+            shape->m_slots = m_slots;
+            shape->m_slots.emplace(t_attr_name, shape->m_names.size());
+            shape->m_names.push_back(t_attr_name);
+            child = std::move(shape);
+          }
+          return child;
+        }
+
+      private:
+        const std::string m_type_name;
+        std::vector<std::string> m_names;
+        std::map<std::string, size_t> m_slots;
+
+        mutable chaiscript::detail::threading::mutex m_mutex;
+        mutable std::map<std::string, std::shared_ptr<const Dynamic_Object_Shape>> m_transitions;
+    };
+
     class Dynamic_Object
     {
       public:
-        explicit Dynamic_Object(std::string t_type_name)
-          : m_type_name(std::move(t_type_name)), m_option_explicit(false)
+        explicit Dynamic_Object(const std::string &t_type_name)
+          : m_shape(Dynamic_Object_Shape::root(t_type_name)), m_option_explicit(false)
+        {
+        }
+
+        /// Constructs an attribute-less object with the given root shape
+        explicit Dynamic_Object(std::shared_ptr<const Dynamic_Object_Shape> t_shape)
+          : m_shape(std::move(t_shape)), m_option_explicit(false)
         {
         }
 
@@ -62,7 +155,24 @@ namespace chaiscript
 
         std::string get_type_name() const
         {
-          return m_type_name;
+          return m_shape->type_name();
+        }
+
+        const std::shared_ptr<const Dynamic_Object_Shape> &get_shape() const noexcept
+        {
+          return m_shape;
+        }
+
+        /// Direct slot access for callers holding a (shape, slot) pair obtained from get_shape().
+        /// \warning the slot must belong to the object's current shape
+        Boxed_Value &get_slot(const size_t t_slot) noexcept
+        {
+          return m_slots[t_slot];
+        }
+
+        const Boxed_Value &get_slot(const size_t t_slot) const noexcept
+        {
+          return m_slots[t_slot];
         }
 
         const Boxed_Value &operator[](const std::string &t_attr_name) const
@@ -77,27 +187,40 @@ namespace chaiscript
 
         const Boxed_Value &get_attr(const std::string &t_attr_name) const
         {
-          auto a = m_attrs.find(t_attr_name);
+          const auto slot = m_shape->find(t_attr_name);
 
-          if (a != m_attrs.end()) {
-            return a->second;
+          if (slot != Dynamic_Object_Shape::npos) {
+            return m_slots[slot];
           } else {
             throw std::range_error("Attr not found '" + t_attr_name + "' and cannot be added to const obj");
           }
         }
 
         bool has_attr(const std::string &t_attr_name) const {
-          return m_attrs.find(t_attr_name) != m_attrs.end();
+          return m_shape->find(t_attr_name) != Dynamic_Object_Shape::npos;
         }
 
+        /// \returns the named attribute, adding it if it does not exist yet
+        /// \warning Unlike with the std::map attributes were kept in before, adding an attribute
+        ///          may move the others, invalidating Boxed_Value references returned earlier.
+        ///          The values they hold are shared and stay valid: keep a copy of the
+        ///          Boxed_Value (or a reference to the value cast out of it) across additions.
         Boxed_Value &get_attr(const std::string &t_attr_name)
         {
-          return m_attrs[t_attr_name];
+          const auto slot = m_shape->find(t_attr_name);
+
+          if (slot != Dynamic_Object_Shape::npos) {
+            return m_slots[slot];
+          }
+
+          m_shape = m_shape->add(t_attr_name);
+          m_slots.emplace_back();
+          return m_slots.back();
         }
 
         Boxed_Value &method_missing(const std::string &t_method_name)
         {
-          if (m_option_explicit && m_attrs.find(t_method_name) == m_attrs.end()) {
+          if (m_option_explicit && !has_attr(t_method_name)) {
             throw option_explicit_set(t_method_name);
           }
 
@@ -106,7 +229,7 @@ namespace chaiscript
 
         const Boxed_Value &method_missing(const std::string &t_method_name) const
         {
-          if (m_option_explicit && m_attrs.find(t_method_name) == m_attrs.end()) {
+          if (m_option_explicit && !has_attr(t_method_name)) {
             throw option_explicit_set(t_method_name);
           }
 
@@ -115,14 +238,19 @@ namespace chaiscript
 
         std::map<std::string, Boxed_Value> get_attrs() const
         {
-          return m_attrs;
+          std::map<std::string, Boxed_Value> attrs;
+          for (size_t slot = 0; slot < m_slots.size(); ++slot) {
+            attrs.emplace(m_shape->attr_name(slot), m_slots[slot]);
+          }
+          return attrs;
         }
 
       private:
-        const std::string m_type_name = "";
+        std::shared_ptr<const Dynamic_Object_Shape> m_shape = Dynamic_Object_Shape::root("");
         bool m_option_explicit = false;
 
-        std::map<std::string, Boxed_Value> m_attrs;
+        // Slots stay contiguous for the inline caches; see the warning on get_attr
+        std::vector<Boxed_Value> m_slots;
     };
 
   }
@@ -180,7 +180,7 @@ namespace chaiscript
               std::string t_type_name,
               const Proxy_Function &t_func)
             : Proxy_Function_Base(build_type_list(t_func->get_param_types()), t_func->get_arity() - 1),
-              m_type_name(std::move(t_type_name)), m_func(t_func)
+              m_type_name(std::move(t_type_name)), m_func(t_func), m_shape(Dynamic_Object_Shape::root(m_type_name))
           {
             assert( (t_func->get_arity() > 0 || t_func->get_arity() < 0)
                 && "Programming error, Dynamic_Object_Function must have at least one parameter (this)");
@@ -207,7 +207,7 @@ namespace chaiscript
 
           bool call_match(const std::vector<Boxed_Value> &vals, const Type_Conversions_State &t_conversions) const override
           {
-            std::vector<Boxed_Value> new_vals{Boxed_Value(Dynamic_Object(m_type_name))};
+            std::vector<Boxed_Value> new_vals{Boxed_Value(Dynamic_Object(m_shape))};
             new_vals.insert(new_vals.end(), vals.begin(), vals.end());
 
             return m_func->call_match(new_vals, t_conversions);
@@ -216,7 +216,7 @@ namespace chaiscript
         protected:
           Boxed_Value do_call(const std::vector<Boxed_Value> &params, const Type_Conversions_State &t_conversions) const override
           {
-            auto bv = Boxed_Value(Dynamic_Object(m_type_name), true);
+            auto bv = Boxed_Value(Dynamic_Object(m_shape), true);
             std::vector<Boxed_Value> new_params{bv};
             new_params.insert(new_params.end(), params.begin(), params.end());
 
@@ -228,6 +228,7 @@ namespace chaiscript
         private:
           const std::string m_type_name;
           const Proxy_Function m_func;
+          const std::shared_ptr<const Dynamic_Object_Shape> m_shape;
 
       };
     }
@@ -0,0 +1,501 @@
+// This file is distributed under the BSD License.
+// See "license.txt" for details.
+// Copyright 2009-2012, Jonathan Turner (jonathan@emptycrate.com)
+// Copyright 2009-2017, Jason Turner (jason@emptycrate.com)
+// http://www.chaiscript.com
+
+#ifndef CHAISCRIPT_BYTECODE_HPP_
+#define CHAISCRIPT_BYTECODE_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "chaiscript_eval.hpp"
+
+namespace chaiscript
+{
+  /// \brief Register based execution tier for arithmetic expression trees
+  ///
+  /// Binary and prefix operator trees from the optimized AST are flattened into a short
+  /// instruction list that is run by a single loop over a small register file. int and
+  /// double intermediates stay unboxed between instructions. Everything the compiler does
+  /// not understand becomes an eval instruction that hands the subtree back to the tree
+  /// walker, and operands that are not int or double go through the same operator
+  /// dispatch the tree walker uses, so results are identical.
+  namespace bytecode
+  {
+    enum class Opcode : std::uint8_t
+    {
+      eval,      ///< dst = leaves[operand]->eval()
+      constant,  ///< dst = constants[operand]
+      binary,    ///< dst = lhs oper rhs
+      prefix     ///< dst = oper lhs
+    };
+
+    struct Instruction
+    {
+      Opcode code;
+      Operators::Opers oper;
+      std::uint8_t dst;
+      std::uint8_t lhs;
+      std::uint8_t rhs;
+      std::uint32_t operand;
+    };
+
+    /// A VM register, holds an unboxed int, double or bool when the value was computed by the
+    /// program, and the original Boxed_Value when the value came from outside the program
+    class Register
+    {
+      public:
+        enum class Kind : std::uint8_t { int_value, double_value, bool_value, boxed };
+
+        /// An operand as an unboxed number, kind is boxed when it isn't an int or a double
+        struct Number
+        {
+          Kind kind;
+          int i;
+          double d;
+        };
+
+        Register()
+          : m_value(void_var())
+        {
+        }
+
+        /// Holds a value evaluated by the tree walker. It is only looked at when an operator
+        /// uses it, like the tree walker does: it may refer to a variable that the operands
+        /// evaluated in between change (as in `y + ++y`).
+        void set(Boxed_Value t_bv)
+        {
+          m_kind = Kind::boxed;
+          m_value = std::move(t_bv);
+          m_has_value = true;
+        }
+
+        /// Holds a value that can't change, unboxed right away
+        void set_constant(Boxed_Value t_bv)
+        {
+          const auto &ti = t_bv.get_type_info();
+          if (ti == typeid(int)) {
+            m_kind = Kind::int_value;
+            m_int = *static_cast<const int *>(t_bv.get_const_ptr());
+          } else if (ti == typeid(double)) {
+            m_kind = Kind::double_value;
+            m_double = *static_cast<const double *>(t_bv.get_const_ptr());
+          } else {
+            m_kind = Kind::boxed;
+          }
+          m_value = std::move(t_bv);
+          m_has_value = true;
+        }
+
+        void set_int(const int t_i) noexcept
+        {
+          m_kind = Kind::int_value;
+          m_int = t_i;
+          m_has_value = false;
+        }
+
+        void set_double(const double t_d) noexcept
+        {
+          m_kind = Kind::double_value;
+          m_double = t_d;
+          m_has_value = false;
+        }
+
+        void set_bool(const bool t_b) noexcept
+        {
+          m_kind = Kind::bool_value;
+          m_bool = t_b;
+          m_has_value = false;
+        }
+
+        /// The register's value as of now
+        Number number() const
+        {
+          switch (m_kind) {
+            case Kind::int_value:
+              return Number{Kind::int_value, m_int, static_cast<double>(m_int)};
+            case Kind::double_value:
+              return Number{Kind::double_value, 0, m_double};
+            case Kind::bool_value:
+              return Number{Kind::boxed, 0, 0.0};
+            case Kind::boxed:
+              break;
+          }
+
+          const auto &ti = m_value.get_type_info();
+          if (ti == typeid(int)) {
+            const auto i = *static_cast<const int *>(m_value.get_const_ptr());
+            return Number{Kind::int_value, i, static_cast<double>(i)};
+          } else if (ti == typeid(double)) {
+            return Number{Kind::double_value, 0, *static_cast<const double *>(m_value.get_const_ptr())};
+          }
+          return Number{Kind::boxed, 0, 0.0};
+        }
+
+        /// Boxes the register exactly as Boxed_Number would have boxed the same result
+        Boxed_Value box() const
+        {
+          if (m_has_value) {
+            return m_value;
+          }
+
+          switch (m_kind) {
+            case Kind::int_value:
+              return const_var(m_int);
+            case Kind::double_value:
+              return const_var(m_double);
+            case Kind::bool_value:
+              return const_var(m_bool);
+            case Kind::boxed:
+              break;
+          }
+          return m_value;
+        }
+
+      private:
+        Boxed_Value m_value;
+        union {
+          int m_int;
+          double m_double;
+          bool m_bool;
+        };
+        Kind m_kind = Kind::boxed;
+        bool m_has_value = true;
+    };
+
+    /// Fixed capacity register storage that only constructs the registers a program uses
+    class Register_File
+    {
+      public:
+        static constexpr size_t max_registers = 16;
+
+        explicit Register_File(const size_t t_size)
+          : m_size(t_size)
+        {
+          for (size_t i = 0; i < m_size; ++i) {
+            new (&m_storage[i]) Register();
+          }
+        }
+
+        ~Register_File()
+        {
+          for (size_t i = 0; i < m_size; ++i) {
+            (*this)[i].~Register();
+          }
+        }
+
+        Register_File(const Register_File &) = delete;
+        Register_File &operator=(const Register_File &) = delete;
+
+        Register &operator[](const size_t t_index) noexcept
+        {
+          return *reinterpret_cast<Register *>(&m_storage[t_index]);
+        }
+
+      private:
+        std::array<typename std::aligned_storage<sizeof(Register), alignof(Register)>::type, max_registers> m_storage;
+        size_t m_size;
+    };
+
+    /// A compiled expression. The leaves it evaluates are the children of the Compiled_AST_Node
+    /// that runs it.
+    class Program
+    {
+      public:
+        Program(std::vector<Instruction> t_code, std::vector<Register> t_constants, std::vector<std::string> t_operators, const size_t t_num_registers)
+          : m_code(std::move(t_code)),
+            m_constants(std::move(t_constants)),
+            m_operators(std::move(t_operators)),
+            m_locs(new std::atomic_uint_fast32_t[m_code.size()]()),
+            m_num_registers(t_num_registers)
+        {
+        }
+
+        template<typename T>
+        Boxed_Value run(const std::vector<eval::AST_Node_Impl_Ptr<T>> &t_leaves, const chaiscript::detail::Dispatch_State &t_ss) const
+        {
+          Register_File regs(m_num_registers);
+
+          for (size_t pc = 0; pc < m_code.size(); ++pc) {
+            const auto &ins = m_code[pc];
+            switch (ins.code) {
+              case Opcode::eval:
+                regs[ins.dst].set(t_leaves[ins.operand]->eval(t_ss));
+                break;
+              case Opcode::constant:
+                regs[ins.dst] = m_constants[ins.operand];
+                break;
+              case Opcode::binary:
+                binary(ins, regs[ins.lhs], regs[ins.rhs], regs[ins.dst], t_ss, m_locs[pc]);
+                break;
+              case Opcode::prefix:
+                prefix(ins, regs[ins.lhs], regs[ins.dst], t_ss, m_locs[pc]);
+                break;
+            }
+          }
+
+          return regs[0].box();
+        }
+
+      private:
+        void binary(const Instruction &t_ins, const Register &t_lhs, const Register &t_rhs, Register &t_dst,
+            const chaiscript::detail::Dispatch_State &t_ss, std::atomic_uint_fast32_t &t_loc) const
+        {
+          const auto lhs = t_lhs.number();
+          const auto rhs = t_rhs.number();
+          if (lhs.kind == Register::Kind::int_value && rhs.kind == Register::Kind::int_value) {
+            if (int_oper(t_ins.oper, lhs.i, rhs.i, t_dst)) {
+              return;
+            }
+          } else if (lhs.kind != Register::Kind::boxed && rhs.kind != Register::Kind::boxed) {
+            if (double_oper(t_ins.oper, lhs.d, rhs.d, t_dst)) {
+              return;
+            }
+          }
+
+          t_dst.set(eval::detail::binary_operator(t_ss, t_ins.oper, m_operators[t_ins.operand], t_lhs.box(), t_rhs.box(), t_loc));
+        }
+
+        void prefix(const Instruction &t_ins, const Register &t_lhs, Register &t_dst,
+            const chaiscript::detail::Dispatch_State &t_ss, std::atomic_uint_fast32_t &t_loc) const
+        {
+          if (t_ins.oper == Operators::Opers::unary_minus) {
+            const auto lhs = t_lhs.number();
+            if (lhs.kind == Register::Kind::int_value) {
+              t_dst.set_int(-lhs.i);
+              return;
+            } else if (lhs.kind == Register::Kind::double_value) {
+              t_dst.set_double(-lhs.d);
+              return;
+            }
+          }
+
+          t_dst.set(eval::detail::prefix_operator(t_ss, t_ins.oper, m_operators[t_ins.operand], t_lhs.box(), t_loc));
+        }
+
+        static bool int_oper(const Operators::Opers t_oper, const int t, const int u, Register &t_dst)
+        {
+          switch (t_oper) {
+            case Operators::Opers::sum: t_dst.set_int(t + u); return true;
+            case Operators::Opers::difference: t_dst.set_int(t - u); return true;
+            case Operators::Opers::product: t_dst.set_int(t * u); return true;
+            case Operators::Opers::quotient: check_divide_by_zero(u); t_dst.set_int(t / u); return true;
+            case Operators::Opers::remainder: check_divide_by_zero(u); t_dst.set_int(t % u); return true;
+            case Operators::Opers::shift_left: t_dst.set_int(t << u); return true;
+            case Operators::Opers::shift_right: t_dst.set_int(t >> u); return true;
+            case Operators::Opers::bitwise_and: t_dst.set_int(t & u); return true;
+            case Operators::Opers::bitwise_or: t_dst.set_int(t | u); return true;
+            case Operators::Opers::bitwise_xor: t_dst.set_int(t ^ u); return true;
+            default: return compare(t_oper, t, u, t_dst);
+          }
+        }
+
+        static bool double_oper(const Operators::Opers t_oper, const double t, const double u, Register &t_dst)
+        {
+          switch (t_oper) {
+            case Operators::Opers::sum: t_dst.set_double(t + u); return true;
+            case Operators::Opers::difference: t_dst.set_double(t - u); return true;
+            case Operators::Opers::product: t_dst.set_double(t * u); return true;
+            case Operators::Opers::quotient: t_dst.set_double(t / u); return true;
+            default: return compare(t_oper, t, u, t_dst);
+          }
+        }
+
+        template<typename N>
+        static bool compare(const Operators::Opers t_oper, const N t, const N u, Register &t_dst)
+        {
+          switch (t_oper) {
+            case Operators::Opers::equals: t_dst.set_bool(t == u); return true;
+            case Operators::Opers::not_equal: t_dst.set_bool(t != u); return true;
+            case Operators::Opers::less_than: t_dst.set_bool(t < u); return true;
+            case Operators::Opers::greater_than: t_dst.set_bool(t > u); return true;
+            case Operators::Opers::less_than_equal: t_dst.set_bool(t <= u); return true;
+            case Operators::Opers::greater_than_equal: t_dst.set_bool(t >= u); return true;
+            default: return false;
+          }
+        }
+
+        static void check_divide_by_zero(const int t_i)
+        {
+#ifndef CHAISCRIPT_NO_PROTECT_DIVIDEBYZERO
+          if (t_i == 0) {
+            throw chaiscript::exception::arithmetic_error("divide by zero");
+          }
+#else
+          (void)t_i;
+#endif
+        }
+
+        std::vector<Instruction> m_code;
+        std::vector<Register> m_constants;
+        std::vector<std::string> m_operators;
+        std::unique_ptr<std::atomic_uint_fast32_t[]> m_locs;
+        size_t m_num_registers;
+    };
+
+    /// The callable stored in the Compiled_AST_Node, its type lets enclosing expressions
+    /// recognise and inline an already compiled subexpression. Engines with the bytecode tier
+    /// switched off evaluate the original tree instead.
+    template<typename T>
+    struct Program_Runner
+    {
+      std::shared_ptr<const Program> program;
+      eval::AST_Node_Impl_Ptr<T> original;
+
+      Boxed_Value operator()(const std::vector<eval::AST_Node_Impl_Ptr<T>> &t_leaves, const chaiscript::detail::Dispatch_State &t_ss) const
+      {
+        if (!t_ss->bytecode_enabled()) {
+          return original->eval(t_ss);
+        }
+        return program->template run<T>(t_leaves, t_ss);
+      }
+    };
+
+    /// Flattens an operator tree into a Program, allocating registers in evaluation order
+    template<typename T>
+    class Compiler
+    {
+      public:
+        /// \returns the compiled program, or nullptr if the tree is too small to benefit or
+        ///          needs more registers than a Register_File provides
+        std::shared_ptr<const Program> compile(const eval::AST_Node_Impl_Ptr<T> &t_node)
+        {
+          if (count_operators(t_node) < 2) {
+            return nullptr;
+          }
+
+          emit(t_node, 0);
+
+          if (m_num_registers > Register_File::max_registers) {
+            return nullptr;
+          }
+
+          return std::make_shared<const Program>(std::move(m_code), std::move(m_constants), std::move(m_operators), m_num_registers);
+        }
+
+        /// The nodes evaluated by the program's eval instructions, in operand order
+        std::vector<eval::AST_Node_Impl_Ptr<T>> &leaves() noexcept
+        {
+          return m_leaves;
+        }
+
+        static bool is_compiled(const eval::AST_Node_Impl_Ptr<T> &t_node)
+        {
+          if (t_node->identifier != AST_Node_Type::Compiled) {
+            return false;
+          }
+          const auto &compiled = static_cast<const eval::Compiled_AST_Node<T> &>(*t_node);
+          return compiled.m_func.template target<Program_Runner<T>>() != nullptr;
+        }
+
+      private:
+        static const eval::AST_Node_Impl_Ptr<T> &unwrap(const eval::AST_Node_Impl_Ptr<T> &t_node)
+        {
+          if (is_compiled(t_node)) {
+            return static_cast<const eval::Compiled_AST_Node<T> &>(*t_node).m_original_node;
+          }
+          return t_node;
+        }
+
+        static bool is_binary(const eval::AST_Node_Impl_Ptr<T> &t_node)
+        {
+          if (t_node->identifier != AST_Node_Type::Binary || t_node->children.size() != 2) {
+            return false;
+          }
+
+          switch (Operators::to_operator(t_node->text)) {
+            case Operators::Opers::sum:
+            case Operators::Opers::difference:
+            case Operators::Opers::product:
+            case Operators::Opers::quotient:
+            case Operators::Opers::remainder:
+            case Operators::Opers::shift_left:
+            case Operators::Opers::shift_right:
+            case Operators::Opers::bitwise_and:
+            case Operators::Opers::bitwise_or:
+            case Operators::Opers::bitwise_xor:
+            case Operators::Opers::equals:
+            case Operators::Opers::not_equal:
+            case Operators::Opers::less_than:
+            case Operators::Opers::greater_than:
+            case Operators::Opers::less_than_equal:
+            case Operators::Opers::greater_than_equal:
+              return true;
+            default:
+              return false;
+          }
+        }
+
+        static bool is_negate(const eval::AST_Node_Impl_Ptr<T> &t_node)
+        {
+          return t_node->identifier == AST_Node_Type::Prefix && t_node->children.size() == 1 && t_node->text == "-";
+        }
+
+        static size_t count_operators(const eval::AST_Node_Impl_Ptr<T> &t_node)
+        {
+          const auto &node = unwrap(t_node);
+          if (is_binary(node)) {
+            return 1 + count_operators(node->children[0]) + count_operators(node->children[1]);
+          } else if (is_negate(node)) {
+            return 1 + count_operators(node->children[0]);
+          } else {
+            return 0;
+          }
+        }
+
+        std::uint32_t add_operator(const std::string &t_oper)
+        {
+          for (size_t i = 0; i < m_operators.size(); ++i) {
+            if (m_operators[i] == t_oper) {
+              return static_cast<std::uint32_t>(i);
+            }
+          }
+          m_operators.push_back(t_oper);
+          return static_cast<std::uint32_t>(m_operators.size() - 1);
+        }
+
+        void emit(const eval::AST_Node_Impl_Ptr<T> &t_node, const size_t t_dst)
+        {
+          if (t_dst + 1 > m_num_registers) {
+            m_num_registers = t_dst + 1;
+          }
+
+          const auto dst = static_cast<std::uint8_t>(t_dst);
+          const auto &node = unwrap(t_node);
+
+          if (is_binary(node)) {
+            emit(node->children[0], t_dst);
+            emit(node->children[1], t_dst + 1);
+            m_code.push_back(Instruction{Opcode::binary, Operators::to_operator(node->text), dst, dst, static_cast<std::uint8_t>(t_dst + 1), add_operator(node->text)});
+          } else if (is_negate(node)) {
+            emit(node->children[0], t_dst);
+            m_code.push_back(Instruction{Opcode::prefix, Operators::Opers::unary_minus, dst, dst, dst, add_operator(node->text)});
+          } else if (node->identifier == AST_Node_Type::Constant) {
+            Register constant;
+            constant.set_constant(static_cast<const eval::Constant_AST_Node<T> &>(*node).m_value);
+            m_constants.push_back(std::move(constant));
+            m_code.push_back(Instruction{Opcode::constant, Operators::Opers::invalid, dst, dst, dst, static_cast<std::uint32_t>(m_constants.size() - 1)});
+          } else {
+            m_leaves.push_back(t_node);
+            m_code.push_back(Instruction{Opcode::eval, Operators::Opers::invalid, dst, dst, dst, static_cast<std::uint32_t>(m_leaves.size() - 1)});
+          }
+        }
+
+        std::vector<Instruction> m_code;
+        std::vector<Register> m_constants;
+        std::vector<std::string> m_operators;
+        std::vector<eval::AST_Node_Impl_Ptr<T>> m_leaves;
+        size_t m_num_registers = 0;
+    };
+  }
+}
+
+#endif
@@ -92,6 +92,17 @@ namespace chaiscript
 
 
 
+    /// Evaluates an already parsed script
+    Boxed_Value do_eval(const AST_NodePtr &t_ast)
+    {
+      try {
+        return t_ast->eval(chaiscript::detail::Dispatch_State(m_engine));
+      }
+      catch (chaiscript::eval::detail::Return_Value &rv) {
+        return rv.retval;
+      }
+    }
+
     /// Evaluates the given file and looks in the 'use' paths
     const Boxed_Value internal_eval_file(const std::string &t_filename) {
       for (const auto &path : m_use_paths)
@@ -184,6 +195,8 @@ namespace chaiscript
         m_engine.add(fun([this](const std::string &t_file){ return internal_eval_file(t_file); }), "eval_file");
       }
 
+      m_engine.set_bytecode_enabled(std::find(t_opts.begin(), t_opts.end(), Options::No_Bytecode) == t_opts.end());
+
       m_engine.add(fun([this](const std::string &t_str){ return internal_eval(t_str); }), "eval");
       m_engine.add(fun([this](const AST_NodePtr &t_ast){ return eval(t_ast); }), "eval");
 
@@ -313,6 +326,14 @@ namespace chaiscript
       return *m_parser;
     }
 
+    /// \brief Runs compiled operator expressions on the bytecode VM (the default, unless
+    ///        Options::No_Bytecode was given) or on the tree walker. Results are the same either
+    ///        way, so this can be switched at any time, e.g. to compare the two.
+    void set_bytecode_enabled(const bool t_enabled)
+    {
+      m_engine.set_bytecode_enabled(t_enabled);
+    }
+
     const Boxed_Value eval(const AST_NodePtr &t_ast)
     {
       try {
@@ -471,6 +492,91 @@ namespace chaiscript
       m_engine.set_state(t_state.engine_state);
     }
 
+    /// \brief Start-up image of a bootstrapped engine that new engines can be constructed from
+    ///
+    /// Holds the native global state, the type conversions and the parsed start-up scripts (such
+    /// as the prelude). Functions defined by a script are bound to the engine that evaluated it,
+    /// so start-up scripts are kept as ASTs and evaluated again by every engine made from the
+    /// snapshot, which skips parsing them. A snapshot is immutable and may be shared between
+    /// threads.
+    /// \sa ChaiScript_Basic::make_snapshot
+    struct Snapshot
+    {
+      State state;
+      std::set<Type_Conversion> conversions;
+      std::vector<AST_NodePtr> scripts;
+      std::vector<Options> options;
+    };
+
+    /// \brief Bootstraps t_libs once and captures the result as a Snapshot
+    ///
+    /// Native bindings are applied to a bare dispatch engine whose global state becomes the
+    /// snapshot, so nothing in it refers back to an evaluator. Script text carried by the modules
+    /// (Module::eval) and t_scripts is only parsed here, and is evaluated by every engine
+    /// constructed from the snapshot, in the same order.
+    /// \param[in] t_libs Modules to apply, in order
+    /// \param[in] parser Parser used for the scripts
+    /// \param[in] t_scripts Additional script text to run after the modules
+    /// \param[in] t_opts Options for every engine made from the snapshot
+    static Snapshot make_snapshot(const std::vector<ModulePtr> &t_libs,
+                                  std::unique_ptr<parser::ChaiScript_Parser_Base> &&parser,
+                                  const std::vector<std::string> &t_scripts = {},
+                                  const std::vector<chaiscript::Options> &t_opts = chaiscript::default_options())
+    {
+      chaiscript::detail::Dispatch_Engine engine(*parser);
+      Snapshot s;
+
+      struct Script_Collector {
+        parser::ChaiScript_Parser_Base &parser;
+        std::vector<AST_NodePtr> &scripts;
+
+        void eval(const std::string &t_script) {
+          scripts.push_back(parser.parse(t_script, "__SNAPSHOT__"));
+        }
+      } collector{*parser, s.scripts};
+
+      for (const auto &lib : t_libs) {
+        if (lib) {
+          lib->apply(collector, engine);
+        }
+      }
+
+      for (const auto &script : t_scripts) {
+        collector.eval(script);
+      }
+
+      s.state.engine_state = engine.get_state();
+      s.conversions = engine.conversions().get_conversions();
+      s.options = t_opts;
+      return s;
+    }
+
+    /// \brief Constructs an engine from a Snapshot instead of bootstrapping a library
+    ///
+    /// The functions this engine binds to itself (eval, use, parse, ...) are added on top of the
+    /// snapshot's native state, then the snapshot's scripts are evaluated.
+    /// \param[in] t_snapshot Snapshot to start from, see ChaiScript_Basic::make_snapshot
+    /// \param[in] t_modulepaths Vector of paths to search when attempting to load a binary module
+    /// \param[in] t_usepaths Vector of paths to search when attempting to "use" an included ChaiScript file
+    ChaiScript_Basic(const Snapshot &t_snapshot,
+                     std::unique_ptr<parser::ChaiScript_Parser_Base> &&parser,
+                     std::vector<std::string> t_module_paths = {},
+                     std::vector<std::string> t_use_paths = {})
+      : ChaiScript_Basic(ModulePtr(), std::move(parser), std::move(t_module_paths), std::move(t_use_paths), t_snapshot.options)
+    {
+      m_used_files = t_snapshot.state.used_files;
+      m_active_loaded_modules = t_snapshot.state.active_loaded_modules;
+      m_engine.adopt_state(t_snapshot.state.engine_state);
+
+      for (const auto &conversion : t_snapshot.conversions) {
+        m_engine.add(conversion);
+      }
+
+      for (const auto &script : t_snapshot.scripts) {
+        do_eval(script);
+      }
+    }
+
     /// \returns All values in the local thread state, added through the add() function
     std::map<std::string, Boxed_Value> get_locals() const
     {
@@ -11,6 +11,8 @@
 #ifndef CHAISCRIPT_EVAL_HPP_
 #define CHAISCRIPT_EVAL_HPP_
 
+#include <array>
+#include <atomic>
 #include <exception>
 #include <functional>
 #include <limits>
@@ -88,6 +90,52 @@ namespace chaiscript
           return std::move(rv.retval);
         } 
       }
+
+      /// Applies a binary operator the way the evaluator does: arithmetic operands short circuit
+      /// to Boxed_Number, everything else is dispatched to the script level operator function
+      inline Boxed_Value binary_operator(const chaiscript::detail::Dispatch_State &t_ss, Operators::Opers t_oper, const std::string &t_oper_string,
+          const Boxed_Value &t_lhs, const Boxed_Value &t_rhs, std::atomic_uint_fast32_t &t_loc)
+      {
+        try {
+          if (t_oper != Operators::Opers::invalid && t_lhs.get_type_info().is_arithmetic() && t_rhs.get_type_info().is_arithmetic())
+          {
+            // If it's an arithmetic operation we want to short circuit dispatch
+            try{
+              return Boxed_Number::do_oper(t_oper, t_lhs, t_rhs);
+            } catch (const chaiscript::exception::arithmetic_error &) {
+              throw;
+            } catch (...) {
+              throw exception::eval_error("Error with numeric operator calling: " + t_oper_string);
+            }
+          } else {
+            chaiscript::eval::detail::Function_Push_Pop fpp(t_ss);
+            fpp.save_params({t_lhs, t_rhs});
+            return t_ss->call_function(t_oper_string, t_loc, {t_lhs, t_rhs}, t_ss.conversions());
+          }
+        }
+        catch(const exception::dispatch_error &e){
+          throw exception::eval_error("Can not find appropriate '" + t_oper_string + "' operator.", e.parameters, e.functions, false, *t_ss);
+        }
+      }
+
+      /// Applies a prefix operator the way the evaluator does, see binary_operator
+      inline Boxed_Value prefix_operator(const chaiscript::detail::Dispatch_State &t_ss, Operators::Opers t_oper, const std::string &t_oper_string,
+          Boxed_Value t_bv, std::atomic_uint_fast32_t &t_loc)
+      {
+        try {
+          // short circuit arithmetic operations
+          if (t_oper != Operators::Opers::invalid && t_oper != Operators::Opers::bitwise_and && t_bv.get_type_info().is_arithmetic())
+          {
+            return Boxed_Number::do_oper(t_oper, t_bv);
+          } else {
+            chaiscript::eval::detail::Function_Push_Pop fpp(t_ss);
+            fpp.save_params({t_bv});
+            return t_ss->call_function(t_oper_string, t_loc, {std::move(t_bv)}, t_ss.conversions());
+          }
+        } catch (const exception::dispatch_error &e) {
+          throw exception::eval_error("Error with prefix operator evaluation: '" + t_oper_string + "'", e.parameters, e.functions, false, *t_ss);
+        }
+      }
     }
 
     template<typename T>
@@ -211,26 +259,7 @@ namespace chaiscript
         Boxed_Value do_oper(const chaiscript::detail::Dispatch_State &t_ss, 
             Operators::Opers t_oper, const std::string &t_oper_string, const Boxed_Value &t_lhs, const Boxed_Value &t_rhs) const
         {
-          try {
-            if (t_oper != Operators::Opers::invalid && t_lhs.get_type_info().is_arithmetic() && t_rhs.get_type_info().is_arithmetic())
-            {
-              // If it's an arithmetic operation we want to short circuit dispatch
-              try{
-                return Boxed_Number::do_oper(t_oper, t_lhs, t_rhs);
-              } catch (const chaiscript::exception::arithmetic_error &) {
-                throw;
-              } catch (...) {
-                throw exception::eval_error("Error with numeric operator calling: " + t_oper_string);
-              }
-            } else {
-              chaiscript::eval::detail::Function_Push_Pop fpp(t_ss);
-              fpp.save_params({t_lhs, t_rhs});
-              return t_ss->call_function(t_oper_string, m_loc, {t_lhs, t_rhs}, t_ss.conversions());
-            }
-          }
-          catch(const exception::dispatch_error &e){
-            throw exception::eval_error("Can not find appropriate '" + t_oper_string + "' operator.", e.parameters, e.functions, false, *t_ss);
-          }
+          return detail::binary_operator(t_ss, t_oper, t_oper_string, t_lhs, t_rhs, m_loc);
         }
 
       private:
@@ -263,12 +292,13 @@ namespace chaiscript
     template<typename T>
     struct Id_AST_Node final : AST_Node_Impl<T> {
         Id_AST_Node(const std::string &t_ast_node_text, Parse_Location t_loc) :
-          AST_Node_Impl<T>(t_ast_node_text, AST_Node_Type::Id, std::move(t_loc))
+          AST_Node_Impl<T>(t_ast_node_text, AST_Node_Type::Id, std::move(t_loc)),
+          m_symbol(utility::Symbol_Table::global().intern(t_ast_node_text))
         { }
 
         Boxed_Value eval_internal(const chaiscript::detail::Dispatch_State &t_ss) const override {
           try {
-            return t_ss.get_object(this->text, m_loc);
+            return t_ss.get_object(this->text, m_symbol, m_loc);
           }
           catch (std::exception &) {
             throw exception::eval_error("Can not find object: " + this->text);
@@ -276,6 +306,7 @@ namespace chaiscript
         }
 
       private:
+        const utility::Symbol m_symbol;
         mutable std::atomic_uint_fast32_t m_loc = {0};
     };
 
@@ -565,13 +596,22 @@ namespace chaiscript
           AST_Node_Impl<T>(std::move(t_ast_node_text), AST_Node_Type::Dot_Access, std::move(t_loc), std::move(t_children)),
           m_fun_name(
               ((this->children[1]->identifier == AST_Node_Type::Fun_Call) || (this->children[1]->identifier == AST_Node_Type::Array_Call))?
-              this->children[1]->children[0]->text:this->children[1]->text) { }
+              this->children[1]->children[0]->text:this->children[1]->text),
+          m_is_attr_access(this->children[1]->identifier == AST_Node_Type::Id) { }
 
         Boxed_Value eval_internal(const chaiscript::detail::Dispatch_State &t_ss) const override {
           chaiscript::eval::detail::Function_Push_Pop fpp(t_ss);
 
 
           Boxed_Value retval = this->children[0]->eval(t_ss);
+
+          if (m_is_attr_access) {
+            if (const auto *slot = cached_attr(retval, t_ss)) {
+              return *slot;
+            }
+          }
+
+          const Boxed_Value object = retval;
           std::vector<Boxed_Value> params{retval};
 
           bool has_function_params = false;
@@ -584,6 +624,8 @@ namespace chaiscript
 
           fpp.save_params(params);
 
+          const auto generation = t_ss->function_generation();
+
           try {
             retval = t_ss->call_member(m_fun_name, m_loc, std::move(params), has_function_params, t_ss.conversions());
           }
@@ -599,6 +641,10 @@ namespace chaiscript
             retval = std::move(rv.retval);
           }
 
+          if (m_is_attr_access) {
+            update_attr_cache(object, generation, t_ss);
+          }
+
           if (this->children[1]->identifier == AST_Node_Type::Array_Call) {
             try {
               retval = t_ss->call_function("[]", m_array_loc, {retval, this->children[1]->children[1]->eval(t_ss)}, t_ss.conversions());
@@ -612,9 +658,109 @@ namespace chaiscript
         }
 
       private:
+        /// Inline cache entry for `obj.attr` reads: valid while the same engine's function
+        /// generation is unchanged and the object still has the cached shape. The engine's id
+        /// is part of the key because one AST may be evaluated by several engines (and outlive
+        /// them, so an address could be reused by a later engine).
+        ///
+        /// Entries are rewritten in place under a version counter (odd while a rewrite is in
+        /// progress), so readers never lock and treat a torn entry as a miss.
+        struct Attr_Cache {
+          std::atomic_uint_fast32_t version = {0};
+          std::atomic<uint_fast64_t> engine = {0};
+          std::atomic_uint_fast32_t generation = {0};
+          std::atomic<const dispatch::Dynamic_Object_Shape *> shape = {nullptr};
+          std::atomic<size_t> slot = {0};
+        };
+
+        /// Entries per node, all checked on every read and replaced oldest first, so a site
+        /// that sees several shapes (or outlives several generations) keeps caching.
+        static constexpr size_t attr_cache_entries = 4;
+
+        static dispatch::Dynamic_Object *as_dynamic_object(const Boxed_Value &t_bv) {
+          if (t_bv.is_const() || !t_bv.get_type_info().bare_equal(user_type<dispatch::Dynamic_Object>())) {
+            return nullptr;
+          }
+          return static_cast<dispatch::Dynamic_Object *>(t_bv.get_ptr());
+        }
+
+        const Boxed_Value *cached_attr(const Boxed_Value &t_obj, const chaiscript::detail::Dispatch_State &t_ss) const {
+          auto *obj = as_dynamic_object(t_obj);
+          if (obj == nullptr) {
+            return nullptr;
+          }
+
+          const auto engine = t_ss->id();
+          const auto generation = t_ss->function_generation();
+          const auto *shape = obj->get_shape().get();
+          for (const auto &cache : m_attr_caches) {
+            const auto version = cache.version.load(std::memory_order_acquire);
+            if ((version & 1) != 0) {
+              continue;
+            }
+            const bool hit = cache.engine.load(std::memory_order_relaxed) == engine
+                             && cache.generation.load(std::memory_order_relaxed) == generation
+                             && cache.shape.load(std::memory_order_relaxed) == shape;
+            const auto slot = cache.slot.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (hit && cache.version.load(std::memory_order_relaxed) == version) {
+              return &obj->get_slot(slot);
+            }
+          }
+
+          return nullptr;
+        }
+
+        /// Caches the slot for `obj.name` only when the name resolves to exactly one
+        /// function and that function is the `attr` accessor for the object's class,
+        /// which guarantees call_member would have returned that slot.
+        void update_attr_cache(const Boxed_Value &t_obj, const uint_fast32_t t_generation, const chaiscript::detail::Dispatch_State &t_ss) const {
+          auto *obj = as_dynamic_object(t_obj);
+          if (obj == nullptr) {
+            return;
+          }
+
+          const auto slot = obj->get_shape()->find(m_fun_name);
+          if (slot == dispatch::Dynamic_Object_Shape::npos) {
+            return;
+          }
+
+          const auto funs = t_ss->get_function(m_fun_name, m_loc).second;
+          if (funs->size() != 1
+              || !funs->front()->is_attribute_function()
+              || !funs->front()->compare_first_type(t_obj, t_ss.conversions())) {
+            return;
+          }
+
+          chaiscript::detail::threading::lock_guard<chaiscript::detail::threading::mutex> l(m_attr_cache_mutex);
+          const auto entry = m_attr_cache_next;
+          m_attr_cache_next = (entry + 1) % attr_cache_entries;
+
+          auto &cache = m_attr_caches[entry];
+          const auto version = cache.version.load(std::memory_order_relaxed);
+          cache.version.store(version + 1, std::memory_order_relaxed);
+          std::atomic_thread_fence(std::memory_order_release);
+
+          // The shape is kept alive while it is cached, so its address can't be reused by another.
+          // The old one is only released now that the entry reads as torn.
+          m_attr_cache_shapes[entry] = obj->get_shape();
+
+          cache.engine.store(t_ss->id(), std::memory_order_relaxed);
+          cache.generation.store(t_generation, std::memory_order_relaxed);
+          cache.shape.store(obj->get_shape().get(), std::memory_order_relaxed);
+          cache.slot.store(slot, std::memory_order_relaxed);
+          cache.version.store(version + 2, std::memory_order_release);
+        }
+
         mutable std::atomic_uint_fast32_t m_loc = {0};
         mutable std::atomic_uint_fast32_t m_array_loc = {0};
         const std::string m_fun_name;
+        const bool m_is_attr_access;
+
+        mutable std::array<Attr_Cache, attr_cache_entries> m_attr_caches;
+        mutable std::array<std::shared_ptr<const dispatch::Dynamic_Object_Shape>, attr_cache_entries> m_attr_cache_shapes;
+        mutable size_t m_attr_cache_next = 0;
+        mutable chaiscript::detail::threading::mutex m_attr_cache_mutex;
     };
 
 
@@ -1126,21 +1272,7 @@ namespace chaiscript
         { }
 
         Boxed_Value eval_internal(const chaiscript::detail::Dispatch_State &t_ss) const override{
-          Boxed_Value bv(this->children[0]->eval(t_ss));
-
-          try {
-            // short circuit arithmetic operations
-            if (m_oper != Operators::Opers::invalid && m_oper != Operators::Opers::bitwise_and && bv.get_type_info().is_arithmetic())
-            {
-              return Boxed_Number::do_oper(m_oper, bv);
-            } else {
-              chaiscript::eval::detail::Function_Push_Pop fpp(t_ss);
-              fpp.save_params({bv});
-              return t_ss->call_function(this->text, m_loc, {std::move(bv)}, t_ss.conversions());
-            }
-          } catch (const exception::dispatch_error &e) {
-            throw exception::eval_error("Error with prefix operator evaluation: '" + this->text + "'", e.parameters, e.functions, false, *t_ss);
-          }
+          return detail::prefix_operator(t_ss, m_oper, this->text, this->children[0]->eval(t_ss), m_loc);
         }
 
       private:
@@ -7,7 +7,9 @@
 #ifndef CHAISCRIPT_OPTIMIZER_HPP_
 #define CHAISCRIPT_OPTIMIZER_HPP_
 
+#include "chaiscript_bytecode.hpp"
 #include "chaiscript_eval.hpp"
+#include "../utility/arena.hpp"
 
 
 namespace chaiscript {
@@ -59,7 +61,7 @@ namespace chaiscript {
     template<typename T, typename Callable>
       auto make_compiled_node(const eval::AST_Node_Impl_Ptr<T> &original_node, std::vector<eval::AST_Node_Impl_Ptr<T>> children, Callable callable)
       {
-        return chaiscript::make_shared<eval::AST_Node_Impl<T>, eval::Compiled_AST_Node<T>>(original_node, std::move(children), std::move(callable));
+        return utility::make_arena_shared<eval::AST_Node_Impl<T>, eval::Compiled_AST_Node<T>>(original_node, std::move(children), std::move(callable));
       }
 
 
@@ -116,7 +118,7 @@ namespace chaiscript {
             if (node->children.size() == 1) {
               return node->children[0];
             } else {
-              return chaiscript::make_shared<eval::AST_Node_Impl<T>, eval::Scopeless_Block_AST_Node<T>>(node->text, node->location, node->children);
+              return utility::make_arena_shared<eval::AST_Node_Impl<T>, eval::Scopeless_Block_AST_Node<T>>(node->text, node->location, node->children);
             }
           }
         }
@@ -152,7 +154,7 @@ namespace chaiscript {
               {
                 new_children.push_back(node->children[x]);
               }
-              return chaiscript::make_shared<eval::AST_Node_Impl<T>, eval::Block_AST_Node<T>>(node->text, node->location, new_children);
+              return utility::make_arena_shared<eval::AST_Node_Impl<T>, eval::Block_AST_Node<T>>(node->text, node->location, new_children);
             }
           } else {
             return node;
@@ -170,7 +172,7 @@ namespace chaiscript {
             for (size_t i = 0; i < node->children.size()-1; ++i) {
               auto child = node->children[i];
               if (child->identifier == AST_Node_Type::Fun_Call) {
-                node->children[i] = chaiscript::make_shared<eval::AST_Node_Impl<T>, eval::Unused_Return_Fun_Call_AST_Node<T>>(child->text, child->location, std::move(child->children));
+                node->children[i] = utility::make_arena_shared<eval::AST_Node_Impl<T>, eval::Unused_Return_Fun_Call_AST_Node<T>>(child->text, child->location, std::move(child->children));
               }
             }
           } else if ((node->identifier == AST_Node_Type::For
@@ -184,7 +186,7 @@ namespace chaiscript {
               for (size_t i = 0; i < num_sub_children; ++i) {
                 auto sub_child = child_at(child, i);
                 if (sub_child->identifier == AST_Node_Type::Fun_Call) {
-                  child->children[i] = chaiscript::make_shared<eval::AST_Node_Impl<T>, eval::Unused_Return_Fun_Call_AST_Node<T>>(sub_child->text, sub_child->location, std::move(sub_child->children));
+                  child->children[i] = utility::make_arena_shared<eval::AST_Node_Impl<T>, eval::Unused_Return_Fun_Call_AST_Node<T>>(sub_child->text, sub_child->location, std::move(sub_child->children));
                 }
               }
             }
@@ -230,7 +232,7 @@ namespace chaiscript {
             if (parsed != Operators::Opers::invalid) {
               const auto rhs = std::dynamic_pointer_cast<eval::Constant_AST_Node<T>>(node->children[1])->m_value;
               if (rhs.get_type_info().is_arithmetic()) {
-                return chaiscript::make_shared<eval::AST_Node_Impl<T>, eval::Fold_Right_Binary_Operator_AST_Node<T>>(node->text, node->location, node->children, rhs);
+                return utility::make_arena_shared<eval::AST_Node_Impl<T>, eval::Fold_Right_Binary_Operator_AST_Node<T>>(node->text, node->location, node->children, rhs);
               }
             }
           } catch (const std::exception &) {
@@ -258,9 +260,9 @@ namespace chaiscript {
 
             if (parsed != Operators::Opers::invalid && parsed != Operators::Opers::bitwise_and && lhs.get_type_info().is_arithmetic()) {
               const auto val  = Boxed_Number::do_oper(parsed, lhs);
-              return chaiscript::make_shared<eval::AST_Node_Impl<T>, eval::Constant_AST_Node<T>>(std::move(match), node->location, std::move(val));
+              return utility::make_arena_shared<eval::AST_Node_Impl<T>, eval::Constant_AST_Node<T>>(std::move(match), node->location, std::move(val));
             } else if (lhs.get_type_info().bare_equal_type_info(typeid(bool)) && oper == "!") {
-              return chaiscript::make_shared<eval::AST_Node_Impl<T>, eval::Constant_AST_Node<T>>(std::move(match), node->location, Boxed_Value(!boxed_cast<bool>(lhs)));
+              return utility::make_arena_shared<eval::AST_Node_Impl<T>, eval::Constant_AST_Node<T>>(std::move(match), node->location, Boxed_Value(!boxed_cast<bool>(lhs)));
             }
           } catch (const std::exception &) {
             //failure to fold, that's OK
@@ -280,7 +282,7 @@ namespace chaiscript {
                 else { return Boxed_Value(lhs_val || rhs_val); }
               }();
 
-              return chaiscript::make_shared<eval::AST_Node_Impl<T>, eval::Constant_AST_Node<T>>(std::move(match), node->location, std::move(val));
+              return utility::make_arena_shared<eval::AST_Node_Impl<T>, eval::Constant_AST_Node<T>>(std::move(match), node->location, std::move(val));
             }
           } catch (const std::exception &) {
             //failure to fold, that's OK
@@ -299,7 +301,7 @@ namespace chaiscript {
               if (lhs.get_type_info().is_arithmetic() && rhs.get_type_info().is_arithmetic()) {
                 const auto val  = Boxed_Number::do_oper(parsed, lhs, rhs);
                 const auto match = node->children[0]->text + " " + oper + " " + node->children[1]->text;
-                return chaiscript::make_shared<eval::AST_Node_Impl<T>, eval::Constant_AST_Node<T>>(std::move(match), node->location, std::move(val));
+                return utility::make_arena_shared<eval::AST_Node_Impl<T>, eval::Constant_AST_Node<T>>(std::move(match), node->location, std::move(val));
               }
             }
           } catch (const std::exception &) {
@@ -318,7 +320,7 @@ namespace chaiscript {
 
             const auto make_constant = [&node, &fun_name](auto val){
               const auto match = fun_name + "(" + node->children[1]->children[0]->text + ")";
-              return chaiscript::make_shared<eval::AST_Node_Impl<T>, eval::Constant_AST_Node<T>>(std::move(match), node->location, Boxed_Value(val));
+              return utility::make_arena_shared<eval::AST_Node_Impl<T>, eval::Constant_AST_Node<T>>(std::move(match), node->location, Boxed_Value(val));
             };
 
             if (fun_name == "double") {
@@ -417,8 +419,30 @@ namespace chaiscript {
       }
     };
 
+    struct Bytecode {
+      template<typename T>
+      auto optimize(const eval::AST_Node_Impl_Ptr<T> &node) {
+        if (node->identifier != AST_Node_Type::Binary) {
+          return node;
+        }
+
+        bytecode::Compiler<T> compiler;
+        auto program = compiler.compile(node);
+        if (!program) {
+          return node;
+        }
+
+        return make_compiled_node(node, std::move(compiler.leaves()), bytecode::Program_Runner<T>{std::move(program), node});
+      }
+    };
+
+#ifdef CHAISCRIPT_NO_BYTECODE
     typedef Optimizer<optimizer::Partial_Fold, optimizer::Unused_Return, optimizer::Constant_Fold, 
       optimizer::If, optimizer::Return, optimizer::Dead_Code, optimizer::Block, optimizer::For_Loop> Optimizer_Default; 
+#else
+    typedef Optimizer<optimizer::Partial_Fold, optimizer::Unused_Return, optimizer::Constant_Fold, 
+      optimizer::If, optimizer::Return, optimizer::Dead_Code, optimizer::Block, optimizer::For_Loop, optimizer::Bytecode> Optimizer_Default; 
+#endif
 
   }
 }
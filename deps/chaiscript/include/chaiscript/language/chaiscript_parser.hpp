@@ -27,6 +27,7 @@
 #include "chaiscript_common.hpp"
 #include "chaiscript_optimizer.hpp"
 #include "chaiscript_tracer.hpp"
+#include "../utility/arena.hpp"
 #include "../utility/fnv1a.hpp"
 #include "../utility/static_string.hpp"
 
@@ -452,7 +453,7 @@ namespace chaiscript
         /// \todo fix the fact that a successful match that captured no ast_nodes doesn't have any real start position
         m_match_stack.push_back(
             m_optimizer.optimize(
-              chaiscript::make_shared<chaiscript::eval::AST_Node_Impl<Tracer>, NodeType>(
+              utility::make_arena_shared<chaiscript::eval::AST_Node_Impl<Tracer>, NodeType>(
                 std::move(t_text),
                 std::move(filepos),
                 std::move(new_children)))
@@ -781,7 +782,7 @@ namespace chaiscript
       template<typename T, typename ... Param>
       std::shared_ptr<eval::AST_Node_Impl<Tracer>> make_node(std::string t_match, const int t_prev_line, const int t_prev_col, Param && ...param)
       {
-        return chaiscript::make_shared<eval::AST_Node_Impl<Tracer>, T>(std::move(t_match), Parse_Location(m_filename, t_prev_line, t_prev_col, m_position.line, m_position.col), std::forward<Param>(param)...);
+        return utility::make_arena_shared<eval::AST_Node_Impl<Tracer>, T>(std::move(t_match), Parse_Location(m_filename, t_prev_line, t_prev_col, m_position.line, m_position.col), std::forward<Param>(param)...);
       }
 
       /// Reads a number from the input, detecting if it's an integer or floating point
@@ -1759,7 +1760,7 @@ namespace chaiscript
 
           if ((is_if_init && num_children == 3)
               || (!is_if_init && num_children == 2)) {
-            m_match_stack.push_back(chaiscript::make_shared<eval::AST_Node_Impl<Tracer>, eval::Noop_AST_Node<Tracer>>());
+            m_match_stack.push_back(utility::make_arena_shared<eval::AST_Node_Impl<Tracer>, eval::Noop_AST_Node<Tracer>>());
           }
 
           if (!is_if_init) {
@@ -1849,7 +1850,7 @@ namespace chaiscript
           {
             return false;
           } else {
-            m_match_stack.push_back(chaiscript::make_shared<eval::AST_Node_Impl<Tracer>, eval::Noop_AST_Node<Tracer>>());
+            m_match_stack.push_back(utility::make_arena_shared<eval::AST_Node_Impl<Tracer>, eval::Noop_AST_Node<Tracer>>());
           }
         }
 
@@ -1859,13 +1860,13 @@ namespace chaiscript
           {
             return false;
           } else {
-            m_match_stack.push_back(chaiscript::make_shared<eval::AST_Node_Impl<Tracer>, eval::Constant_AST_Node<Tracer>>(Boxed_Value(true)));
+            m_match_stack.push_back(utility::make_arena_shared<eval::AST_Node_Impl<Tracer>, eval::Constant_AST_Node<Tracer>>(Boxed_Value(true)));
           }
         }
 
         if (!Equation())
         {
-          m_match_stack.push_back(chaiscript::make_shared<eval::AST_Node_Impl<Tracer>, eval::Noop_AST_Node<Tracer>>());
+          m_match_stack.push_back(utility::make_arena_shared<eval::AST_Node_Impl<Tracer>, eval::Noop_AST_Node<Tracer>>());
         }
 
         return true; 
@@ -2005,7 +2006,7 @@ namespace chaiscript
           }
 
           if (m_match_stack.size() == prev_stack_top) {
-            m_match_stack.push_back(chaiscript::make_shared<eval::AST_Node_Impl<Tracer>, eval::Noop_AST_Node<Tracer>>());
+            m_match_stack.push_back(utility::make_arena_shared<eval::AST_Node_Impl<Tracer>, eval::Noop_AST_Node<Tracer>>());
           }
 
           build_match<eval::Block_AST_Node<Tracer>>(prev_stack_top);
@@ -2029,7 +2030,7 @@ namespace chaiscript
           }
 
           if (m_match_stack.size() == prev_stack_top) {
-            m_match_stack.push_back(chaiscript::make_shared<eval::AST_Node_Impl<Tracer>, eval::Noop_AST_Node<Tracer>>());
+            m_match_stack.push_back(utility::make_arena_shared<eval::AST_Node_Impl<Tracer>, eval::Noop_AST_Node<Tracer>>());
           }
 
           build_match<eval::Block_AST_Node<Tracer>>(prev_stack_top);
@@ -2539,6 +2540,9 @@ namespace chaiscript
 
       /// Parses the given input string, tagging parsed ast_nodes with the given m_filename.
       AST_NodePtr parse_internal(const std::string &t_input, std::string t_fname) {
+        // Every script gets an arena of its own for its nodes, the optimizer's included
+        utility::Arena_Scope arena_scope(std::make_shared<utility::Arena>());
+
         m_position = Position(t_input.begin(), t_input.end());
         m_filename = std::make_shared<std::string>(std::move(t_fname));
 
@@ -2556,7 +2560,7 @@ namespace chaiscript
             build_match<eval::File_AST_Node<Tracer>>(0);
           }
         } else {
-          m_match_stack.push_back(chaiscript::make_shared<eval::AST_Node_Impl<Tracer>, eval::Noop_AST_Node<Tracer>>());
+          m_match_stack.push_back(utility::make_arena_shared<eval::AST_Node_Impl<Tracer>, eval::Noop_AST_Node<Tracer>>());
         }
 
         return m_match_stack.front();
@@ -0,0 +1,215 @@
+// This file is distributed under the BSD License.
+// See "license.txt" for details.
+// Copyright 2009-2012, Jonathan Turner (jonathan@emptycrate.com)
+// Copyright 2009-2017, Jason Turner (jason@emptycrate.com)
+// http://www.chaiscript.com
+
+#ifndef CHAISCRIPT_UTILITY_ARENA_HPP_
+#define CHAISCRIPT_UTILITY_ARENA_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "../chaiscript_defines.hpp"
+
+namespace chaiscript
+{
+  namespace utility
+  {
+    class Arena;
+
+    namespace detail
+    {
+      /// The arena the calling thread is filling, if any (see Arena_Scope)
+      inline std::shared_ptr<Arena> &filling_arena() noexcept
+      {
+        thread_local std::shared_ptr<Arena> arena;
+        return arena;
+      }
+    }
+
+    /// Bump allocator for the AST nodes of one script.
+    ///
+    /// Objects allocated one after another end up next to each other in memory, so a tree built
+    /// bottom-up by the parser has each subtree in one contiguous run, children in source order
+    /// right before their parent. Memory freed by the thread that is filling the arena (nodes
+    /// the optimizer replaced) goes on a free list per size and is handed out to the next
+    /// allocation of that size; that slot was freed last, so it is right behind the nodes being
+    /// built. Memory freed after that is only returned when the arena goes away.
+    class Arena
+    {
+      public:
+        explicit Arena(const size_t t_first_block = 4096, const size_t t_max_block = 256 * 1024)
+          : m_next_block(t_first_block),
+            m_max_block(t_max_block)
+        {
+        }
+
+        Arena(const Arena &) = delete;
+        Arena &operator=(const Arena &) = delete;
+
+        void *allocate(const size_t t_bytes)
+        {
+          const auto size = rounded(t_bytes);
+          const auto size_class = size / granularity;
+          if (size_class < m_free.size() && m_free[size_class] != nullptr) {
+            auto *slot = m_free[size_class];
+            m_free[size_class] = slot->next;
+            return slot;
+          }
+
+          // Sized up front, so that deallocate never has to grow it
+          if (size_class >= m_free.size()) {
+            m_free.resize(size_class + 1, nullptr);
+          }
+          if (m_blocks.empty() || m_pos + size > m_block_size) {
+            new_block(size);
+          }
+
+          auto *p = m_blocks.back().get() + m_pos;
+          m_pos += size;
+          return p;
+        }
+
+        void deallocate(void *t_p, const size_t t_bytes) noexcept
+        {
+          if (detail::filling_arena().get() != this) {
+            return;
+          }
+
+          auto *slot = static_cast<Free_Slot *>(t_p);
+          const auto size_class = rounded(t_bytes) / granularity;
+          slot->next = m_free[size_class];
+          m_free[size_class] = slot;
+        }
+
+        /// \returns total number of bytes obtained from the system
+        size_t reserved() const noexcept
+        {
+          return m_reserved;
+        }
+
+      private:
+        struct Free_Slot
+        {
+          Free_Slot *next;
+        };
+
+        /// Every allocation is a multiple of this, which keeps all of them aligned for any type
+        static constexpr size_t granularity = alignof(std::max_align_t);
+
+        static size_t rounded(const size_t t_bytes) noexcept
+        {
+          return (std::max(t_bytes, sizeof(Free_Slot)) + granularity - 1) / granularity * granularity;
+        }
+
+        void new_block(const size_t t_min_bytes)
+        {
+          const auto size = std::max(m_next_block, t_min_bytes);
+          m_blocks.emplace_back(new unsigned char[size]);
+          m_block_size = size;
+          m_reserved += size;
+          m_pos = 0;
+          m_next_block = std::min(m_next_block * 2, m_max_block);
+        }
+
+        std::vector<std::unique_ptr<unsigned char[]>> m_blocks;
+        std::vector<Free_Slot *> m_free;
+        size_t m_block_size = 0;
+        size_t m_pos = 0;
+        size_t m_reserved = 0;
+        size_t m_next_block;
+        size_t m_max_block;
+    };
+
+    /// Standard allocator over a shared Arena. Every allocation keeps the arena alive, so
+    /// objects may outlive whoever created the arena.
+    template<typename T>
+    class Arena_Allocator
+    {
+      public:
+        using value_type = T;
+
+        static_assert(alignof(T) <= alignof(std::max_align_t), "Arena only provides fundamental alignment");
+
+        explicit Arena_Allocator(std::shared_ptr<Arena> t_arena) noexcept
+          : m_arena(std::move(t_arena))
+        {
+        }
+
+        template<typename U>
+        Arena_Allocator(const Arena_Allocator<U> &t_other) noexcept
+          : m_arena(t_other.arena())
+        {
+        }
+
+        T *allocate(const size_t t_n)
+        {
+          return static_cast<T *>(m_arena->allocate(t_n * sizeof(T)));
+        }
+
+        void deallocate(T *t_p, const size_t t_n) noexcept
+        {
+          m_arena->deallocate(t_p, t_n * sizeof(T));
+        }
+
+        const std::shared_ptr<Arena> &arena() const noexcept
+        {
+          return m_arena;
+        }
+
+        template<typename U>
+        bool operator==(const Arena_Allocator<U> &t_other) const noexcept
+        {
+          return m_arena == t_other.arena();
+        }
+
+        template<typename U>
+        bool operator!=(const Arena_Allocator<U> &t_other) const noexcept
+        {
+          return m_arena != t_other.arena();
+        }
+
+      private:
+        std::shared_ptr<Arena> m_arena;
+    };
+
+    /// Makes the calling thread fill t_arena (see make_arena_shared) until destroyed, then
+    /// goes back to the arena filled before, if any
+    class Arena_Scope
+    {
+      public:
+        explicit Arena_Scope(std::shared_ptr<Arena> t_arena) noexcept
+          : m_previous(std::exchange(detail::filling_arena(), std::move(t_arena)))
+        {
+        }
+
+        Arena_Scope(const Arena_Scope &) = delete;
+        Arena_Scope &operator=(const Arena_Scope &) = delete;
+
+        ~Arena_Scope()
+        {
+          detail::filling_arena() = std::move(m_previous);
+        }
+
+      private:
+        std::shared_ptr<Arena> m_previous;
+    };
+
+    /// Like chaiscript::make_shared, but from the arena the calling thread is filling, if any
+    template<typename B, typename D, typename ... Arg>
+      std::shared_ptr<B> make_arena_shared(Arg && ... arg)
+      {
+        const auto &arena = detail::filling_arena();
+        if (arena) {
+          return std::allocate_shared<D>(Arena_Allocator<D>(arena), std::forward<Arg>(arg)...);
+        }
+        return chaiscript::make_shared<B, D>(std::forward<Arg>(arg)...);
+      }
+  }
+}
+
+#endif
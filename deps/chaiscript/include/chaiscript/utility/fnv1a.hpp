@@ -8,7 +8,9 @@
 #define CHAISCRIPT_UTILITY_FNV1A_HPP_
 
 
+#include <cstddef>
 #include <cstdint>
+#include <string>
 #include "../chaiscript_defines.hpp"
 
 
@@ -41,6 +43,23 @@ namespace chaiscript
 
     }
 
+    /// Iterative form for runtime strings, which may be long or contain embedded nulls
+    static constexpr std::uint32_t fnv1a_32(const char *begin, const char *end, std::uint32_t h = 0x811c9dc5) {
+      while (begin != end) {
+        h = (h ^ static_cast<std::uint32_t>(static_cast<unsigned char>(*begin))) * 0x01000193;
+        ++begin;
+      }
+      return h;
+    }
+
+    /// Hash functor for unordered containers keyed by std::string
+    struct Fnv1a_Hash
+    {
+      std::size_t operator()(const std::string &t_str) const noexcept {
+        return fnv1a_32(t_str.data(), t_str.data() + t_str.size());
+      }
+    };
+
 
   }
 
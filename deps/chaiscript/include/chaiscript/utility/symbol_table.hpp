@@ -0,0 +1,198 @@
+// This file is distributed under the BSD License.
+// See "license.txt" for details.
+// Copyright 2009-2012, Jonathan Turner (jonathan@emptycrate.com)
+// Copyright 2009-2017, Jason Turner (jason@emptycrate.com)
+// http://www.chaiscript.com
+
+#ifndef CHAISCRIPT_UTILITY_SYMBOL_TABLE_HPP_
+#define CHAISCRIPT_UTILITY_SYMBOL_TABLE_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../chaiscript_defines.hpp"
+#include "../chaiscript_threading.hpp"
+#include "fnv1a.hpp"
+
+namespace chaiscript
+{
+  namespace utility
+  {
+    /// Integer identifier for an interned name
+    using Symbol = std::uint32_t;
+
+    /// Process wide table of interned identifiers.
+    ///
+    /// Every distinct name is given a dense, stable Symbol the first time it is
+    /// interned. AST nodes intern their identifier once at parse time so the
+    /// engine can index its global, function and type tables by integer instead
+    /// of comparing strings on every lookup.
+    ///
+    /// Only parsing and registration intern names. Runtime lookups by string go
+    /// through find(), which never adds to the table, so names that are looked up
+    /// but never defined don't accumulate. find() and name() take no lock: the
+    /// hash table is replaced rather than resized in place (old ones are kept for
+    /// readers still holding them) and names are stored in chunks that never move.
+    class Symbol_Table
+    {
+      public:
+        /// Returned by find() for names that were never interned; no engine table holds it
+        static constexpr Symbol npos = static_cast<Symbol>(-1);
+
+        static Symbol_Table &global()
+        {
+          static Symbol_Table s_table;
+          return s_table;
+        }
+
+        Symbol_Table()
+        {
+          for (auto &chunk : m_chunks) {
+            chunk.store(nullptr, std::memory_order_relaxed);
+          }
+          m_tables.push_back(std::make_unique<Table>(static_cast<size_t>(initial_table_size)));
+          m_table.store(m_tables.back().get(), std::memory_order_release);
+        }
+
+        Symbol_Table(const Symbol_Table &) = delete;
+        Symbol_Table &operator=(const Symbol_Table &) = delete;
+
+        /// \returns the symbol of t_name, or npos if it was never interned
+        Symbol find(const std::string &t_name) const noexcept
+        {
+          return find(t_name, hash(t_name));
+        }
+
+        /// \returns the symbol of t_name, interning it first if needed
+        Symbol intern(const std::string &t_name)
+        {
+          const auto name_hash = hash(t_name);
+          const auto found = find(t_name, name_hash);
+          if (found != npos) {
+            return found;
+          }
+
+          chaiscript::detail::threading::lock_guard<chaiscript::detail::threading::mutex> l(m_mutex);
+
+          // Another thread may have interned it in the meantime
+          const auto raced = find(t_name, name_hash);
+          if (raced != npos) {
+            return raced;
+          }
+
+          const auto symbol = static_cast<Symbol>(m_count);
+          if (symbol / chunk_size >= max_chunks) {
+            throw std::length_error("too many interned names");
+          }
+
+          if (symbol % chunk_size == 0) {
+            m_chunk_storage.push_back(std::make_unique<std::string[]>(chunk_size));
+            m_chunks[symbol / chunk_size].store(m_chunk_storage.back().get(), std::memory_order_release);
+          }
+          m_chunk_storage.back()[symbol % chunk_size] = t_name;
+          ++m_count;
+
+          auto *table = m_table.load(std::memory_order_relaxed);
+          if (m_count * 2 > table->mask + 1) {
+            table = grow(*table);
+          }
+          // Publishing the slot publishes the name stored above
+          insert(*table, symbol, name_hash, std::memory_order_release);
+
+          return symbol;
+        }
+
+        /// \returns the name of an interned symbol; the reference stays valid for the life of the table
+        const std::string &name(const Symbol t_symbol) const
+        {
+          const auto *chunk = t_symbol / chunk_size < max_chunks
+                              ? m_chunks[t_symbol / chunk_size].load(std::memory_order_acquire)
+                              : nullptr;
+          if (chunk == nullptr) {
+            throw std::out_of_range("unknown symbol");
+          }
+          return chunk[t_symbol % chunk_size];
+        }
+
+      private:
+        static constexpr size_t chunk_size = 1024;
+        static constexpr size_t max_chunks = 4096;
+        static constexpr size_t initial_table_size = 1024;
+
+        /// Open addressing, each slot is the name's hash << 32 | (symbol + 1), or 0 when empty
+        struct Table
+        {
+          explicit Table(const size_t t_size)
+            : mask(t_size - 1), slots(new std::atomic<std::uint64_t>[t_size])
+          {
+            for (size_t i = 0; i < t_size; ++i) {
+              slots[i].store(0, std::memory_order_relaxed);
+            }
+          }
+
+          const size_t mask;
+          std::unique_ptr<std::atomic<std::uint64_t>[]> slots;
+        };
+
+        static std::uint32_t hash(const std::string &t_name) noexcept
+        {
+          return fnv1a_32(t_name.data(), t_name.data() + t_name.size());
+        }
+
+        Symbol find(const std::string &t_name, const std::uint32_t t_hash) const noexcept
+        {
+          const auto *table = m_table.load(std::memory_order_acquire);
+          for (auto i = t_hash & table->mask; ; i = (i + 1) & table->mask) {
+            const auto slot = table->slots[i].load(std::memory_order_acquire);
+            if (slot == 0) {
+              return npos;
+            }
+            const auto symbol = static_cast<Symbol>((slot & 0xffffffff) - 1);
+            if ((slot >> 32) == t_hash && m_chunks[symbol / chunk_size].load(std::memory_order_relaxed)[symbol % chunk_size] == t_name) {
+              return symbol;
+            }
+          }
+        }
+
+        static void insert(Table &t_table, const Symbol t_symbol, const std::uint32_t t_hash, const std::memory_order t_order)
+        {
+          auto i = t_hash & t_table.mask;
+          while (t_table.slots[i].load(std::memory_order_relaxed) != 0) {
+            i = (i + 1) & t_table.mask;
+          }
+          t_table.slots[i].store((std::uint64_t(t_hash) << 32) | (std::uint64_t(t_symbol) + 1), t_order);
+        }
+
+        /// Called with m_mutex held, returns the new current table
+        Table *grow(const Table &t_table)
+        {
+          auto table = std::make_unique<Table>((t_table.mask + 1) * 2);
+          for (size_t i = 0; i <= t_table.mask; ++i) {
+            const auto slot = t_table.slots[i].load(std::memory_order_relaxed);
+            if (slot != 0) {
+              insert(*table, static_cast<Symbol>((slot & 0xffffffff) - 1), static_cast<std::uint32_t>(slot >> 32), std::memory_order_relaxed);
+            }
+          }
+          m_tables.push_back(std::move(table));
+          m_table.store(m_tables.back().get(), std::memory_order_release);
+          return m_tables.back().get();
+        }
+
+        // Guards the writers; everything below is only changed with it held
+        chaiscript::detail::threading::mutex m_mutex;
+        std::atomic<Table *> m_table = {nullptr};
+        std::vector<std::unique_ptr<Table>> m_tables;
+        std::array<std::atomic<const std::string *>, max_chunks> m_chunks;
+        std::vector<std::unique_ptr<std::string[]>> m_chunk_storage;
+        size_t m_count = 0;
+    };
+  }
+}
+
+#endif
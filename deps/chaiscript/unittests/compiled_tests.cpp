@@ -77,6 +77,37 @@ TEST_CASE("Dynamic_Object attributes can be shared with C++")
 }
 
 
+TEST_CASE("Runtime lookups by name don't intern the name")
+{
+  chaiscript::ChaiScript_Basic chai(create_chaiscript_stdlib(),create_chaiscript_parser());
+
+  CHECK(!chai.eval<bool>("function_exists(\"never_defined_\" + to_string(42))"));
+  CHECK_THROWS(chai.eval("type(\"never_defined_\" + to_string(43))"));
+
+  const auto &symbols = chaiscript::utility::Symbol_Table::global();
+  const chaiscript::utility::Symbol npos = chaiscript::utility::Symbol_Table::npos;
+  CHECK(symbols.find("never_defined_42") == npos);
+  CHECK(symbols.find("never_defined_43") == npos);
+  CHECK(symbols.name(symbols.find("function_exists")) == "function_exists");
+}
+
+
+TEST_CASE("Bytecode tier can be switched off at runtime with the same results")
+{
+  chaiscript::ChaiScript_Basic chai(create_chaiscript_stdlib(),create_chaiscript_parser());
+
+  chai.eval("def f(a, b) { return a * b + a / 2 - -b; }");
+  chai.eval("def g() { var y = 1; return y + (++y) * 1; }");
+
+  const auto on_f = chai.eval<double>("f(3.5, 2)");
+  const auto on_g = chai.eval<int>("g()");
+  chai.set_bytecode_enabled(false);
+  CHECK(chai.eval<double>("f(3.5, 2)") == on_f);
+  CHECK(chai.eval<int>("g()") == on_g);
+  CHECK(on_g == 4);
+}
+
+
 TEST_CASE("Function objects can be created from chaiscript functions")
 {
 
@@ -391,6 +422,50 @@ TEST_CASE("Set and restore chai state")
   CHECK_THROWS_AS(chai.eval<int>("i"), chaiscript::exception::eval_error &);
 }
 
+TEST_CASE("Engines constructed from a snapshot are independent")
+{
+  auto lib = std::make_shared<chaiscript::Module>();
+  lib->add(chaiscript::fun(&set_state_test_myfun), "myfun");
+  lib->eval("def bump(x) { return x + myfun(); }");
+
+  // the engine that bootstrapped the snapshot is gone, nothing may still refer to it
+  const auto snapshot = chaiscript::ChaiScript_Basic::make_snapshot({create_chaiscript_stdlib(), lib},
+      create_chaiscript_parser(), {"def twice(x) { return [x, x]; }"});
+  chaiscript::ChaiScript_Basic chai1(snapshot, create_chaiscript_parser());
+  chaiscript::ChaiScript_Basic chai2(snapshot, create_chaiscript_parser());
+
+  CHECK(chai1.eval<int>("bump(1)") == 3);
+  CHECK(chai2.eval<int>("eval(\"bump(5)\")") == 7);
+  CHECK(chai1.eval<bool>("var v = twice(3); v.push_back(4); v.size() == 3"));
+  CHECK(chai2.eval<bool>("[1, 2, 3].map(fun(x) { x * 2 }) == [2, 4, 6]"));
+
+  chai1.add_global(chaiscript::var(10), "g");
+  chai1.add(chaiscript::fun([](){ return 5; }), "myfun2");
+  CHECK(chai1.eval<int>("bump(g) + myfun2()") == 17);
+  CHECK_THROWS_AS(chai2.eval<int>("g"), chaiscript::exception::eval_error &);
+  CHECK_THROWS_AS(chai2.eval<int>("myfun2()"), chaiscript::exception::eval_error &);
+}
+
+TEST_CASE("Attribute caches in snapshot code don't carry over to a later engine at the same address")
+{
+  const auto snapshot = chaiscript::ChaiScript_Basic::make_snapshot({create_chaiscript_stdlib()},
+      create_chaiscript_parser(), {"def get_x(o) { return o.x; }"});
+
+  // both engines live at the same address and reach the same function generation, but only
+  // the first resolves o.x to the attribute
+  for (int i = 0; i < 2; ++i) {
+    chaiscript::ChaiScript_Basic chai(snapshot, create_chaiscript_parser());
+    if (i == 0) {
+      chai.eval("attr Foo::x; def Foo::Foo() { this.x = 1; } global f = Foo();");
+    } else {
+      chai.eval("def Foo::Foo() { this.x = 1; } global f = Foo(); def x(Foo f) { return 42; }");
+    }
+    const auto expected = i == 0 ? 1 : 42;
+    CHECK(chai.eval<int>("get_x(f)") == expected);
+    CHECK(chai.eval<int>("get_x(f)") == expected);
+  }
+}
+
 
 //// Short comparisons
 